@@ -5,6 +5,159 @@ uint8_t *BTOasPacket::tx()
     return (uint8_t *)&cmd;
 }
 
+static const BLELinkParams bleLinkParams[] = {
+    {6, 12, 0, 400},  // fast: 7.5-15ms, no latency, 4s timeout
+    {40, 80, 4, 600}, // relaxed: 50-100ms, can skip 4 events, 6s timeout (has to be more than 2 * (1 + latency) * interval)
+};
+const BLELinkParams *getBLELinkParams(BLELinkProfile profile)
+{
+    return &bleLinkParams[profile];
+}
+const char *getBLELinkProfileName(BLELinkProfile profile)
+{
+    return profile == BLE_LINK_FAST ? "fast" : "relaxed";
+}
+
+// The compact encoding is just the first txLength() bytes of the normal packet, so the receiver can tell how much it got from the
+// length of the write/notify and fills in the rest with 0's. A full BTOAS_PACKET_SIZE packet is exactly what old versions send so both decode the same way.
+// NOTE: if you add a packet type add its size here too, otherwise it gets sent full size
+uint16_t getBTOasPayloadSize(uint16_t cmd)
+{
+    switch (cmd)
+    {
+    case IDLE:
+    case AIRUP:
+    case AIROUT:
+    case REBOOT:
+    case CALIBRATE:
+    case TURNOFF:
+    case DETECTPRESSURESENSORS:
+    case RESETAIPKT:
+        return 0;
+    case AIRSM:
+    case SAVETOPROFILE:
+    case READPROFILE:
+    case AIRUPQUICK:
+    case BASEPROFILE:
+    case RISEONSTART:
+    case RAISEONPRESSURESET:
+    case ASSIGNRECEPIENT:
+    case SAVECURRENTPRESSURESTOPROFILE:
+    case MAINTAINPRESSURE:
+    case FALLONSHUTDOWN:
+    case HEIGHTSENSORMODE:
+    case COMPRESSORSTATUS:
+    case SAFETYMODE:
+    case AISTATUSENABLED:
+    case BP32PKT:
+        return 4;
+    case SETAIRHEIGHT:
+        return 8;
+    case STATUSRATE:
+    case PACKETTOOLARGE:
+        return 6;
+    case VALVEPULSE:
+        return 20;
+    case PRESETREPORT:
+        return 10;
+    case GETCONFIGVALUES:
+        return 12;
+    case BULKPKT:
+        return 14;
+    case AUTHPACKET:
+    case STATUSREPORT:
+        return 16;
+    case BOOTTIMINGS:
+        return 4 + 4 * BOOT_PHASE_COUNT;
+    case STARTWEB:
+    case MESSAGE:
+    case BROADCASTNAME:
+    case UPDATESTATUSREQUEST:
+    case TELEMETRYPKT:
+    case STATUSDELTA:
+    case BATCH:
+    case STATESYNC:
+    case PINGPKT:
+        return BTOAS_PAYLOAD_VARIABLE;
+    default:
+        return sizeof(BTOasPacket::args);
+    }
+}
+
+uint16_t BTOasPacket::payloadSize()
+{
+    uint16_t size = getBTOasPayloadSize(this->cmd);
+    if (size == BTOAS_PAYLOAD_VARIABLE)
+    {
+        size = sizeof(this->args);
+        while (size > 0 && this->args[size - 1] == 0)
+        {
+            size--;
+        }
+    }
+    return size;
+}
+
+bool BTOasPacket::expectsReply()
+{
+    switch (this->cmd)
+    {
+    case PRESETREPORT:
+    case GETCONFIGVALUES:
+    case UPDATESTATUSREQUEST:
+    case BOOTTIMINGS:
+    case STATESYNC:
+    case BATCH:
+    case JOYSTICKCONFIG:
+    case GAMEPADMAP:
+        return true;
+    case PINGPKT:
+        return ((PingPacket *)this)->getCommand() == PINGCMD_PING; // throughput answers with done once it's over, that can take longer than the timeout
+    case TELEMETRYPKT:
+        return ((TelemetryPacket *)this)->getCommand() == TelemetryCMD::TELEMETRYCMD_EXPORT;
+    case BULKPKT:
+        return ((BulkPacket *)this)->getCommand() == BULKCMD_OPEN;
+    default:
+        return false; // auth too, it never goes through the queue
+    }
+}
+
+uint16_t BTOasPacket::txLength(bool compact)
+{
+    return compact ? BTOAS_HEADER_SIZE + this->payloadSize() : BTOAS_PACKET_SIZE;
+}
+
+uint16_t BTOasPacket::trimmedLength(uint16_t length)
+{
+    const uint8_t *data = this->tx();
+    while (length > BTOAS_HEADER_SIZE && data[length - 1] == 0)
+    {
+        length--;
+    }
+    return length;
+}
+
+bool BTOasPacket::rx(const uint8_t *data, size_t length)
+{
+    memset(this->tx(), 0, BTOAS_PACKET_SIZE);
+    if (length < BTOAS_HEADER_SIZE || length > BTOAS_PACKET_SIZE)
+    {
+        return false;
+    }
+    memcpy(this->tx(), data, length);
+    return true;
+}
+
+// strings in args don't have to be 0 terminated when they fill their whole field, so never let String() read past it
+static String argsString(const uint8_t *field, size_t fieldSize)
+{
+    char str[sizeof(((BTOasPacket *)0)->args) + 1];
+    size_t length = strnlen((const char *)field, fieldSize);
+    memcpy(str, field, length);
+    str[length] = 0;
+    return String(str);
+}
+
 BTOasValue8 *BTOasPacket::args8()
 {
     return (BTOasValue8 *)this->args;
@@ -22,8 +175,7 @@ BTOasPacket::BTOasPacket()
 {
     // blank packet
     this->cmd = IDLE;
-    this->sender = 0;
-    this->recipient = 0;
+    this->requestId = 0;
     memset(this->args, 0, sizeof(this->args));
 }
 
@@ -50,10 +202,95 @@ StatusPacket::StatusPacket(float WHEEL_FRONT_PASSENGER_PRESSURE, float WHEEL_REA
     this->args8()[10].i = AIPercentage;
     this->args8()[11].i = AIReadyBittset;
     this->args32()[3].i = bittset;
+}
+
+StatusFields *StatusPacket::fields()
+{
+    return (StatusFields *)this->args;
+}
+
+StatusDeltaPacket::StatusDeltaPacket()
+{
+    this->cmd = STATUSDELTA;
+}
+
+StatusDeltaPacket::StatusDeltaPacket(StatusFields *current, StatusFields *previous, uint8_t sequence)
+{
+    this->cmd = STATUSDELTA;
+    uint8_t mask = 0;
+    uint8_t pos = STATUSDELTA_FIELDS_START;
+    for (int i = 0; i < 5; i++)
+    {
+        if (previous == nullptr || current->pressures[i] != previous->pressures[i])
+        {
+            mask |= 1 << (STATUSDELTA_PRESSURE + i);
+            memcpy(&this->args[pos], &current->pressures[i], sizeof(uint16_t));
+            pos += sizeof(uint16_t);
+        }
+    }
+    if (previous == nullptr || current->aiPercentage != previous->aiPercentage)
+    {
+        mask |= 1 << STATUSDELTA_AI_PERCENTAGE;
+        this->args[pos++] = current->aiPercentage;
+    }
+    if (previous == nullptr || current->aiReadyBittset != previous->aiReadyBittset)
+    {
+        mask |= 1 << STATUSDELTA_AI_READY;
+        this->args[pos++] = current->aiReadyBittset;
+    }
+    // clock bit flips every 250ms, not worth sending 4 bytes for
+    uint32_t clockMask = ~(uint32_t)(1 << StatusPacketBittset::CLOCK);
+    if (previous == nullptr || (current->bittset & clockMask) != (previous->bittset & clockMask))
+    {
+        mask |= 1 << STATUSDELTA_BITTSET;
+        memcpy(&this->args[pos], &current->bittset, sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+    }
+    this->args[0] = mask;
+    this->args[1] = sequence;
+    this->args[2] = previous == nullptr;
+}
+
+uint8_t StatusDeltaPacket::getMask()
+{
+    return this->args[0];
+}
 
-    // doesn't matter for this because it is generic broadcasted for everyone
-    this->sender = 0;
-    this->recipient = 0;
+uint8_t StatusDeltaPacket::getSequence()
+{
+    return this->args[1];
+}
+
+bool StatusDeltaPacket::isKeyframe()
+{
+    return this->args[2] != 0;
+}
+
+void StatusDeltaPacket::apply(StatusFields *target)
+{
+    uint8_t mask = this->getMask();
+    uint8_t pos = STATUSDELTA_FIELDS_START;
+    for (int i = 0; i < 5; i++)
+    {
+        if (mask & (1 << (STATUSDELTA_PRESSURE + i)))
+        {
+            memcpy(&target->pressures[i], &this->args[pos], sizeof(uint16_t));
+            pos += sizeof(uint16_t);
+        }
+    }
+    if (mask & (1 << STATUSDELTA_AI_PERCENTAGE))
+    {
+        target->aiPercentage = this->args[pos++];
+    }
+    if (mask & (1 << STATUSDELTA_AI_READY))
+    {
+        target->aiReadyBittset = this->args[pos++];
+    }
+    if (mask & (1 << STATUSDELTA_BITTSET))
+    {
+        memcpy(&target->bittset, &this->args[pos], sizeof(uint32_t));
+        pos += sizeof(uint32_t);
+    }
 }
 
 PresetPacket::PresetPacket(int profileIndex, float WHEEL_FRONT_PASSENGER_PRESSURE, float WHEEL_REAR_PASSENGER_PRESSURE, float WHEEL_FRONT_DRIVER_PRESSURE, float WHEEL_REAR_DRIVER_PRESSURE)
@@ -65,10 +302,6 @@ PresetPacket::PresetPacket(int profileIndex, float WHEEL_FRONT_PASSENGER_PRESSUR
     this->args16()[WHEEL_FRONT_DRIVER].i = WHEEL_FRONT_DRIVER_PRESSURE;       // getWheel(WHEEL_FRONT_DRIVER)->getPressure();
     this->args16()[WHEEL_REAR_DRIVER].i = WHEEL_REAR_DRIVER_PRESSURE;         // getWheel(WHEEL_REAR_DRIVER)->getPressure();
     this->args16()[4].i = profileIndex;                                       // profile index
-
-    // doesn't matter for this because it is generic broadcasted for everyone
-    this->sender = 0;
-    this->recipient = 0;
 }
 
 int PresetPacket::getProfile()
@@ -83,17 +316,13 @@ IdlePacket::IdlePacket()
 
 AssignRecipientPacket::AssignRecipientPacket(int assignmentNumber)
 {
-    this->cmd = ASSIGNRECEPIENT;
-    this->sender = 0;
-    this->recipient = 0; // client should assume if they haven't been assigned yet then they are being assigned this
+    this->cmd = ASSIGNRECEPIENT; // client should assume if they haven't been assigned yet then they are being assigned this
     this->args32()[0].i = assignmentNumber;
 }
 
-MessagePacket::MessagePacket(short recipient, std::string message)
+MessagePacket::MessagePacket(std::string message)
 {
     this->cmd = MESSAGE;
-    this->sender = 0;
-    this->recipient = recipient;
     memcpy(this->args, (uint8_t *)message.data(), message.length());
 }
 
@@ -205,16 +434,16 @@ ResetAIPacket::ResetAIPacket()
 StartwebPacket::StartwebPacket(String ssid, String password)
 {
     this->cmd = STARTWEB;
-    strcpy((char *)&this->args[0], ssid.c_str());
-    strcpy((char *)&this->args[50], password.c_str());
+    strncpy((char *)&this->args[0], ssid.c_str(), STARTWEB_FIELD_SIZE - 1);
+    strncpy((char *)&this->args[STARTWEB_FIELD_SIZE], password.c_str(), STARTWEB_FIELD_SIZE - 1);
 }
 String StartwebPacket::getSSID()
 {
-    return String((char *)&this->args[0]);
+    return argsString(&this->args[0], STARTWEB_FIELD_SIZE);
 }
 String StartwebPacket::getPassword()
 {
-    return String((char *)&this->args[50]);
+    return argsString(&this->args[STARTWEB_FIELD_SIZE], STARTWEB_FIELD_SIZE);
 }
 int AirsmPacket::getRelativeValue()
 {
@@ -297,6 +526,22 @@ void AuthPacket::setBleAuthResult(AuthResult ar)
 {
     this->args32()[1].i = (uint32_t)ar;
 }
+uint32_t AuthPacket::getCapabilities()
+{
+    return this->args32()[2].i;
+}
+void AuthPacket::setCapabilities(uint32_t capabilities)
+{
+    this->args32()[2].i = capabilities;
+}
+uint32_t AuthPacket::getManifoldCapabilities()
+{
+    return this->args32()[3].i;
+}
+void AuthPacket::setManifoldCapabilities(uint32_t capabilities)
+{
+    this->args32()[3].i = capabilities;
+}
 BroadcastNamePacket::BroadcastNamePacket(String broadcastName)
 {
     this->cmd = BROADCASTNAME;
@@ -307,7 +552,7 @@ BroadcastNamePacket::BroadcastNamePacket(String broadcastName)
 }
 String BroadcastNamePacket::getBroadcastName()
 {
-    return String((char *)&this->args[0]);
+    return argsString(&this->args[0], sizeof(this->args));
 }
 BP32Packet::BP32Packet(BP32CMD bp32Cmd, bool value)
 {
@@ -330,7 +575,7 @@ UpdateStatusRequestPacket::UpdateStatusRequestPacket(String status)
 }
 String UpdateStatusRequestPacket::getStatus()
 {
-    return String((char *)&this->args[0]);
+    return argsString(&this->args[0], sizeof(this->args));
 }
 void UpdateStatusRequestPacket::setStatus(String status)
 {
@@ -338,4 +583,481 @@ void UpdateStatusRequestPacket::setStatus(String status)
     if (len > sizeof(this->args))
         len = sizeof(this->args);
     strncpy((char *)&this->args[0], status.c_str(), len);
-}
\ No newline at end of file
+}
+BootTimingsPacket::BootTimingsPacket()
+{
+    this->cmd = BOOTTIMINGS;
+}
+BootTimingsPacket::BootTimingsPacket(bool fastBoot, const uint32_t *phaseTimesMS)
+{
+    this->cmd = BOOTTIMINGS;
+    this->args32()[0].i = fastBoot;
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        this->args32()[1 + i].i = phaseTimesMS[i];
+    }
+}
+bool BootTimingsPacket::getFastBoot()
+{
+    return this->args32()[0].i != 0;
+}
+uint32_t BootTimingsPacket::getPhaseTime(BootPhase phase)
+{
+    return this->args32()[1 + phase].i;
+}
+
+TelemetryPacket::TelemetryPacket(TelemetryCMD telemetryCmd, uint32_t value)
+{
+    this->cmd = TELEMETRYPKT;
+    this->args16()[0].i = telemetryCmd;
+    this->args32()[1].i = value;
+}
+TelemetryCMD TelemetryPacket::getCommand()
+{
+    return (TelemetryCMD)this->args16()[0].i;
+}
+uint32_t TelemetryPacket::getValue()
+{
+    return this->args32()[1].i;
+}
+uint32_t TelemetryPacket::getTotalSize()
+{
+    return this->args32()[2].i;
+}
+void TelemetryPacket::setTotalSize(uint32_t size)
+{
+    this->args32()[2].i = size;
+}
+uint16_t TelemetryPacket::getDataLength()
+{
+    return this->args16()[6].i;
+}
+void TelemetryPacket::setDataLength(uint16_t length)
+{
+    this->args16()[6].i = length;
+}
+uint8_t *TelemetryPacket::data()
+{
+    return &this->args[TELEMETRY_PACKET_DATA_START];
+}
+
+StatusRatePacket::StatusRatePacket(uint16_t maxRateHz, uint16_t deltaPSI, uint16_t heartbeatMS)
+{
+    this->cmd = STATUSRATE;
+    this->args16()[0].i = maxRateHz;
+    this->args16()[1].i = deltaPSI;
+    this->args16()[2].i = heartbeatMS;
+}
+uint16_t StatusRatePacket::getMaxRateHz()
+{
+    return this->args16()[0].i;
+}
+uint16_t StatusRatePacket::getDeltaPSI()
+{
+    return this->args16()[1].i;
+}
+uint16_t StatusRatePacket::getHeartbeatMS()
+{
+    return this->args16()[2].i;
+}
+
+ValvePulsePacket::ValvePulsePacket()
+{
+    this->cmd = VALVEPULSE;
+}
+ValvePulsePacket::ValvePulsePacket(const uint16_t durationsMS[8], uint16_t repeatIntervalMS, uint16_t repeatCount)
+{
+    this->cmd = VALVEPULSE;
+    for (int i = 0; i < 8; i++)
+    {
+        this->args16()[i].i = durationsMS[i];
+    }
+    this->args16()[8].i = repeatIntervalMS;
+    this->args16()[9].i = repeatCount;
+}
+uint16_t ValvePulsePacket::getDuration(int valve)
+{
+    return this->args16()[valve].i;
+}
+uint16_t ValvePulsePacket::getRepeatInterval()
+{
+    return this->args16()[8].i;
+}
+uint16_t ValvePulsePacket::getRepeatCount()
+{
+    return this->args16()[9].i;
+}
+
+BatchPacket::BatchPacket()
+{
+    this->cmd = BATCH;
+}
+bool BatchPacket::add(BTOasPacket *packet)
+{
+    uint8_t count = this->getCount();
+    if (count >= BATCH_MAX_PACKETS)
+    {
+        return false;
+    }
+    // walk past what's already in here
+    int offset = BATCH_FIRST_OFFSET;
+    for (int i = 0; i < count; i++)
+    {
+        offset += 3 + this->args[offset + 2];
+    }
+    uint16_t payloadSize = packet->payloadSize();
+    if (payloadSize > 0xFF || offset + 3 + payloadSize > sizeof(this->args))
+    {
+        return false;
+    }
+    this->args[offset] = packet->cmd & 0xFF;
+    this->args[offset + 1] = packet->cmd >> 8;
+    this->args[offset + 2] = payloadSize;
+    memcpy(&this->args[offset + 3], packet->args, payloadSize);
+    this->setCount(count + 1);
+    return true;
+}
+uint8_t BatchPacket::getCount()
+{
+    return this->args[0];
+}
+void BatchPacket::setCount(uint8_t count)
+{
+    this->args[0] = count;
+}
+int BatchPacket::readPacket(int offset, BTOasPacket *copyTo, uint16_t *length)
+{
+    memset(copyTo->tx(), 0, BTOAS_PACKET_SIZE);
+    if (offset < BATCH_FIRST_OFFSET || offset + 3 > (int)sizeof(this->args))
+    {
+        return -1;
+    }
+    uint8_t payloadSize = this->args[offset + 2];
+    if (offset + 3 + payloadSize > (int)sizeof(this->args))
+    {
+        return -1;
+    }
+    copyTo->cmd = this->args[offset] | (this->args[offset + 1] << 8);
+    copyTo->requestId = this->requestId; // the batch adds the index on, see BatchPacket
+    memcpy(copyTo->args, &this->args[offset + 3], payloadSize);
+    *length = BTOAS_HEADER_SIZE + payloadSize;
+    return offset + 3 + payloadSize;
+}
+BatchStatus BatchPacket::getStatus(int index)
+{
+    if (index < 0 || index >= BATCH_MAX_PACKETS)
+    {
+        return BATCH_STATUS_SKIPPED;
+    }
+    return (BatchStatus)this->args[1 + index];
+}
+void BatchPacket::setStatus(int index, BatchStatus status)
+{
+    if (index >= 0 && index < BATCH_MAX_PACKETS)
+    {
+        this->args[1 + index] = status;
+    }
+}
+
+BulkPacket::BulkPacket(BulkCMD bulkCmd, uint16_t transferId, uint32_t offset)
+{
+    this->cmd = BULKPKT;
+    this->args8()[0].i = bulkCmd;
+    this->args16()[1].i = transferId;
+    this->args32()[1].i = offset;
+}
+BulkCMD BulkPacket::getCommand()
+{
+    return (BulkCMD)this->args8()[0].i;
+}
+uint16_t BulkPacket::getTransferId()
+{
+    return this->args16()[1].i;
+}
+uint32_t BulkPacket::getOffset()
+{
+    return this->args32()[1].i;
+}
+BulkResource BulkPacket::getResource()
+{
+    return (BulkResource)this->args8()[1].i;
+}
+void BulkPacket::setResource(BulkResource resource)
+{
+    this->args8()[1].i = resource;
+}
+uint8_t BulkPacket::getWindow()
+{
+    return this->args8()[12].i;
+}
+void BulkPacket::setWindow(uint8_t window)
+{
+    this->args8()[12].i = window;
+}
+uint32_t BulkPacket::getSize()
+{
+    return this->args32()[2].i;
+}
+void BulkPacket::setSize(uint32_t size)
+{
+    this->args32()[2].i = size;
+}
+BulkStatus BulkPacket::getStatus()
+{
+    return (BulkStatus)this->args8()[13].i;
+}
+void BulkPacket::setStatus(BulkStatus status)
+{
+    this->args8()[13].i = status;
+}
+
+// nibble at a time so the table is 64 bytes instead of 1k, chunks are only a few hundred bytes anyway
+uint32_t bulkCrc32(const uint8_t *data, size_t length, uint32_t crc)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// boot id, version, flags, status frame, config, presets, firmware version
+#define STATESYNC_STATUS_OFFSET 12
+#define STATESYNC_CONFIG_OFFSET (STATESYNC_STATUS_OFFSET + STATESYNC_STATUS_SIZE)
+#define STATESYNC_PRESETS_OFFSET (STATESYNC_CONFIG_OFFSET + STATESYNC_CONFIG_SIZE)
+#define STATESYNC_VERSION_OFFSET (STATESYNC_PRESETS_OFFSET + MAX_PROFILE_COUNT * 4)
+static_assert(STATESYNC_VERSION_OFFSET + STATESYNC_VERSION_SIZE <= sizeof(BTOasPacket::args), "state sync has to fit in one packet");
+StateSyncPacket::StateSyncPacket(uint32_t bootId, uint32_t stateVersion)
+{
+    this->cmd = STATESYNC;
+    this->args32()[0].i = bootId;
+    this->args32()[1].i = stateVersion;
+}
+uint32_t StateSyncPacket::getBootId()
+{
+    return this->args32()[0].i;
+}
+uint32_t StateSyncPacket::getStateVersion()
+{
+    return this->args32()[1].i;
+}
+bool StateSyncPacket::isFull()
+{
+    return this->args8()[8].i & 1;
+}
+void StateSyncPacket::setFull(bool full)
+{
+    this->args8()[8].i = full;
+}
+uint8_t *StateSyncPacket::status()
+{
+    return &this->args[STATESYNC_STATUS_OFFSET];
+}
+uint8_t *StateSyncPacket::config()
+{
+    return &this->args[STATESYNC_CONFIG_OFFSET];
+}
+uint8_t StateSyncPacket::getPresetPressure(int profileIndex, int wheel)
+{
+    return this->args[STATESYNC_PRESETS_OFFSET + profileIndex * 4 + wheel];
+}
+void StateSyncPacket::setPresetPressure(int profileIndex, int wheel, uint8_t pressure)
+{
+    this->args[STATESYNC_PRESETS_OFFSET + profileIndex * 4 + wheel] = pressure;
+}
+String StateSyncPacket::getFirmwareVersion()
+{
+    return argsString(&this->args[STATESYNC_VERSION_OFFSET], STATESYNC_VERSION_SIZE);
+}
+void StateSyncPacket::setFirmwareVersion(String version)
+{
+    memset(&this->args[STATESYNC_VERSION_OFFSET], 0, STATESYNC_VERSION_SIZE);
+    strncpy((char *)&this->args[STATESYNC_VERSION_OFFSET], version.c_str(), STATESYNC_VERSION_SIZE - 1);
+}
+
+PingPacket::PingPacket(PingCMD pingCmd, uint16_t sequence, uint32_t value)
+{
+    this->cmd = PINGPKT;
+    this->args8()[0].i = pingCmd;
+    this->args16()[1].i = sequence;
+    this->args32()[3].i = value;
+}
+PingCMD PingPacket::getCommand()
+{
+    return (PingCMD)this->args8()[0].i;
+}
+void PingPacket::setCommand(PingCMD pingCmd)
+{
+    this->args8()[0].i = pingCmd;
+}
+uint16_t PingPacket::getSequence()
+{
+    return this->args16()[1].i;
+}
+uint32_t PingPacket::getSenderTime()
+{
+    return this->args32()[1].i;
+}
+void PingPacket::setSenderTime(uint32_t us)
+{
+    this->args32()[1].i = us;
+}
+uint32_t PingPacket::getEchoTime()
+{
+    return this->args32()[2].i;
+}
+void PingPacket::setEchoTime(uint32_t us)
+{
+    this->args32()[2].i = us;
+}
+uint32_t PingPacket::getValue()
+{
+    return this->args32()[3].i;
+}
+uint32_t PingPacket::getBytes()
+{
+    return this->args32()[4].i;
+}
+void PingPacket::setBytes(uint32_t bytes)
+{
+    this->args32()[4].i = bytes;
+}
+void PingPacket::fill()
+{
+    for (size_t i = 20; i < sizeof(this->args); i++)
+    {
+        this->args[i] = 0xA5;
+    }
+}
+
+JoystickConfigPacket::JoystickConfigPacket(bool setValues, JoystickMode mode, uint8_t deadzonePercent, uint8_t curveTenths, uint16_t periodMS)
+{
+    this->cmd = JOYSTICKCONFIG;
+    this->args8()[0].i = setValues;
+    this->args8()[1].i = mode;
+    this->args8()[2].i = deadzonePercent;
+    this->args8()[3].i = curveTenths;
+    this->args16()[2].i = periodMS;
+}
+bool JoystickConfigPacket::getSetValues()
+{
+    return this->args8()[0].i != 0;
+}
+void JoystickConfigPacket::setSetValues(bool setValues)
+{
+    this->args8()[0].i = setValues;
+}
+JoystickMode JoystickConfigPacket::getMode()
+{
+    return (JoystickMode)this->args8()[1].i;
+}
+uint8_t JoystickConfigPacket::getDeadzone()
+{
+    return this->args8()[2].i;
+}
+uint8_t JoystickConfigPacket::getCurve()
+{
+    return this->args8()[3].i;
+}
+uint16_t JoystickConfigPacket::getPeriod()
+{
+    return this->args16()[2].i;
+}
+
+static_assert(GAMEPADMAP_BINDING_OFFSET + sizeof(GamepadBinding) <= sizeof(BTOasPacket::args), "a gamepad binding has to fit in one packet");
+GamepadMapPacket::GamepadMapPacket(GamepadMapCMD mapCmd, uint8_t index)
+{
+    this->cmd = GAMEPADMAP;
+    this->args8()[0].i = mapCmd;
+    this->args8()[1].i = index;
+}
+GamepadMapCMD GamepadMapPacket::getCommand()
+{
+    return (GamepadMapCMD)this->args8()[0].i;
+}
+uint8_t GamepadMapPacket::getIndex()
+{
+    return this->args8()[1].i;
+}
+uint8_t GamepadMapPacket::getCount()
+{
+    return this->args8()[2].i;
+}
+void GamepadMapPacket::setCount(uint8_t count)
+{
+    this->args8()[2].i = count;
+}
+GamepadMapStatus GamepadMapPacket::getStatus()
+{
+    return (GamepadMapStatus)this->args8()[3].i;
+}
+void GamepadMapPacket::setStatus(GamepadMapStatus status)
+{
+    this->args8()[3].i = status;
+}
+void GamepadMapPacket::getBinding(GamepadBinding *binding)
+{
+    memcpy(binding, &this->args[GAMEPADMAP_BINDING_OFFSET], sizeof(GamepadBinding));
+}
+void GamepadMapPacket::setBinding(const GamepadBinding *binding)
+{
+    memcpy(&this->args[GAMEPADMAP_BINDING_OFFSET], binding, sizeof(GamepadBinding));
+}
+
+TooLargePacket::TooLargePacket(uint16_t packetCmd, uint16_t length, uint16_t mtu)
+{
+    this->cmd = PACKETTOOLARGE;
+    this->args16()[0].i = packetCmd;
+    this->args16()[1].i = length;
+    this->args16()[2].i = mtu;
+}
+uint16_t TooLargePacket::getPacketCmd()
+{
+    return this->args16()[0].i;
+}
+uint16_t TooLargePacket::getLength()
+{
+    return this->args16()[1].i;
+}
+uint16_t TooLargePacket::getMTU()
+{
+    return this->args16()[2].i;
+}
+
+void rawStreamPack12(uint8_t *out, const int16_t values[4])
+{
+    for (int i = 0; i < 4; i += 2)
+    {
+        uint16_t a = values[i] & 0xFFF;
+        uint16_t b = values[i + 1] & 0xFFF;
+        out[0] = a & 0xFF;
+        out[1] = (a >> 8) | ((b & 0xF) << 4);
+        out[2] = b >> 4;
+        out += 3;
+    }
+}
+
+void rawStreamUnpack12(const uint8_t *in, int16_t values[4], bool isSigned)
+{
+    for (int i = 0; i < 4; i += 2)
+    {
+        values[i] = in[0] | ((in[1] & 0xF) << 8);
+        values[i + 1] = (in[1] >> 4) | (in[2] << 4);
+        in += 3;
+    }
+    if (isSigned)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (values[i] & 0x800)
+            {
+                values[i] -= 0x1000;
+            }
+        }
+    }
+}
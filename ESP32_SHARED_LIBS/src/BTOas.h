@@ -44,6 +44,18 @@ enum BTOasIdentifier
     BP32PKT = 30,
     BROADCASTNAME = 35,
     UPDATESTATUSREQUEST = 36,
+    BOOTTIMINGS = 37,
+    TELEMETRYPKT = 38,
+    STATUSRATE = 39,
+    STATUSDELTA = 40,
+    VALVEPULSE = 41,
+    BATCH = 42,
+    BULKPKT = 43,
+    STATESYNC = 44,
+    PINGPKT = 45,
+    JOYSTICKCONFIG = 46,
+    GAMEPADMAP = 47,
+    PACKETTOOLARGE = 48,
 };
 
 enum StatusPacketBittset
@@ -70,6 +82,47 @@ enum AuthResult
     AUTHRESULT_UPDATEKEY
 };
 
+// sent in the AuthPacket by each side, only things both sides have get used
+enum BTOasCapability
+{
+    BTOAS_CAP_COMPACT = 1 << 0,      // packets are sent with only the header and the used part of args instead of the full BTOAS_PACKET_SIZE
+    BTOAS_CAP_STATUS_DELTA = 1 << 1, // status comes as StatusDeltaPacket instead of StatusPacket. Only used together with BTOAS_CAP_COMPACT
+    BTOAS_CAP_VALVE_PULSE = 1 << 2,  // manifold understands ValvePulsePacket
+    BTOAS_CAP_BATCH = 1 << 3,        // manifold understands BatchPacket
+    BTOAS_CAP_BULK = 1 << 4,         // manifold has the bulk characteristic and understands BulkPacket
+    BTOAS_CAP_STATE_SYNC = 1 << 5,   // manifold understands StateSyncPacket
+    BTOAS_CAP_REQUEST_ID = 1 << 6,   // manifold copies requestId into its replies
+    BTOAS_CAP_JOYSTICK_CONFIG = 1 << 7, // manifold understands JoystickConfigPacket
+    BTOAS_CAP_GAMEPAD_MAP = 1 << 8,     // manifold understands GamepadMapPacket
+};
+
+// BLE connection parameter profiles, shared so the manifold and the controller ask for the same thing.
+// Fast is used while someone is actually driving the valves, relaxed saves power when nothing is happening
+enum BLELinkProfile
+{
+    BLE_LINK_FAST,
+    BLE_LINK_RELAXED,
+};
+struct BLELinkParams
+{
+    uint16_t minInterval; // 1.25ms units
+    uint16_t maxInterval; // 1.25ms units
+    uint16_t latency;     // connection events the peripheral is allowed to skip
+    uint16_t timeout;     // supervision timeout, 10ms units
+};
+#define BLE_LINK_IDLE_MS 10000 // drop to the relaxed profile after this long with no activity
+const BLELinkParams *getBLELinkParams(BLELinkProfile profile);
+const char *getBLELinkProfileName(BLELinkProfile profile);
+
+// which fields are in a StatusDeltaPacket
+enum StatusDeltaField
+{
+    STATUSDELTA_PRESSURE = 0, // bits 0 through 4, one per pressure (same order as StatusPacket)
+    STATUSDELTA_AI_PERCENTAGE = 5,
+    STATUSDELTA_AI_READY = 6,
+    STATUSDELTA_BITTSET = 7,
+};
+
 enum AuxillaryOutputMode
 {
     AUX_MODE_MANUAL_SWITCHED,
@@ -92,6 +145,22 @@ struct AuxillaryOutputModePayload
     uint32_t time;
 };
 
+// boot phases the manifold timestamps during setup, in the order they happen
+enum BootPhase
+{
+    BOOT_PHASE_SETUP_START,
+    BOOT_PHASE_SPIFFS,
+    BOOT_PHASE_SAVEDATA,
+    BOOT_PHASE_MANIFOLD,
+    BOOT_PHASE_WHEELS,
+    BOOT_PHASE_ACCESSORY,
+    BOOT_PHASE_TASKS,
+    BOOT_PHASE_SETUP_DONE,
+    BOOT_PHASE_BLE_READY,
+    BOOT_PHASE_FIRST_VALVE,
+    BOOT_PHASE_COUNT
+};
+
 enum BP32CMD
 {
     BP32CMD_ENABLE_NEW_CONN,
@@ -99,6 +168,29 @@ enum BP32CMD
     BP32CMD_DISCONNECT_DEVICES
 };
 
+enum TelemetryCMD
+{
+    TELEMETRYCMD_SET_RATE, // value is the sample rate in ms, 0 turns off pressure samples
+    TELEMETRYCMD_EXPORT    // value is the offset to read from, reply has the data
+};
+
+// Raw pressure stream characteristic. Not a BTOasPacket, each notify is one batch:
+// uint16 sequence, uint32 millis of the first record, then records of uint8 RawStreamRecordType, uint8 ms since the previous record (or the batch time) and the payload.
+// Records are whole so a batch that got cut off by a small mtu still decodes up to where it was cut
+enum RawStreamRecordType
+{
+    RAWSTREAM_SAMPLE = 1,       // 4 x 12 bit raw pressure sensor values (0-4095, fp rp fd rd), packed into 6 bytes
+    RAWSTREAM_SAMPLE_DELTA = 2, // 4 x signed 12 bit differences from the previous sample, packed the same way
+    RAWSTREAM_VALVES = 3,       // uint8 valve mask, bit = SOLENOID_INDEX
+};
+#define RAWSTREAM_HEADER_SIZE 6
+#define RAWSTREAM_RECORD_HEADER_SIZE 2
+#define RAWSTREAM_SAMPLE_PAYLOAD_SIZE 6
+#define RAWSTREAM_VALVES_PAYLOAD_SIZE 1
+#define RAWSTREAM_MAX_BATCH_SIZE 160
+void rawStreamPack12(uint8_t *out, const int16_t values[4]); // low 12 bits of each
+void rawStreamUnpack12(const uint8_t *in, int16_t values[4], bool isSigned);
+
 union BTOasValue32
 {
     uint32_t i;
@@ -119,12 +211,16 @@ union BTOasValue8
 // I have set it to max, 517, but not guaranteed all devices will negotiate that mutex fully.
 struct BTOasPacket
 {
-    uint16_t cmd; // BTOasIdentifier
-    uint8_t sender;
-    uint8_t recipient;
+    uint16_t cmd;       // BTOasIdentifier
+    uint16_t requestId; // set by the client, the manifold copies it into the reply so it can be matched up. 0 = not tracked (this used to be sender and recipient, which nothing ever read)
     uint8_t args[100]; // 6/22/2025 - originally 16. Currently the code base only supports 1 defualt args size. Right now StartwebPacket uses 100 bytes, all the rest fit into the default MTU but not guaranteeing it will stay that way in the future. MTU set to 517 if negotiated properly from both sides.
 
     uint8_t *tx();
+    uint16_t payloadSize();          // how much of args is actually used by this packet type
+    bool expectsReply();             // manifold answers this one with a rest packet
+    uint16_t txLength(bool compact); // how many bytes of tx() to send. Full BTOAS_PACKET_SIZE unless the other side supports BTOAS_CAP_COMPACT
+    uint16_t trimmedLength(uint16_t length); // length with the trailing 0's cut, the other side fills them back in. Never shorter than the header
+    bool rx(const uint8_t *data, size_t length); // copy in a received packet of either length, anything not sent is 0. False if it's shorter than the header or longer than BTOAS_PACKET_SIZE
     BTOasValue8 *args8();
     BTOasValue16 *args16();
     BTOasValue32 *args32();
@@ -135,11 +231,38 @@ struct BTOasPacket
 };
 
 #define BTOAS_PACKET_SIZE sizeof(BTOasPacket)
+#define BTOAS_HEADER_SIZE (sizeof(BTOasPacket) - sizeof(BTOasPacket::args))
+#define BTOAS_PAYLOAD_VARIABLE 0xFFFF // payload size for packets with strings or data in them, trailing 0's get trimmed off instead
+uint16_t getBTOasPayloadSize(uint16_t cmd);
+
+// layout of the StatusPacket args
+struct __attribute__((packed)) StatusFields
+{
+    uint16_t pressures[5];
+    uint8_t aiPercentage;
+    uint8_t aiReadyBittset;
+    uint32_t bittset;
+};
 
 // Outgoing packets
 struct StatusPacket : BTOasPacket
 {
     StatusPacket(float WHEEL_FRONT_PASSENGER_PRESSURE, float WHEEL_REAR_PASSENGER_PRESSURE, float WHEEL_FRONT_DRIVER_PRESSURE, float WHEEL_REAR_DRIVER_PRESSURE, float TANK_PRESSURE, uint32_t bittset, uint8_t AIPercentage, uint8_t AIReadyBittset);
+    StatusFields *fields();
+};
+
+// Status with only the fields that changed since the last one that was sent to that client.
+// args[0] is a StatusDeltaField mask, args[1] a sequence number, args[2] 1 if it's a keyframe (everything is there), then the fields in mask order.
+// The client should ask for a keyframe (send a blank one) if the sequence skips, the manifold also sends one every so often anyways
+#define STATUSDELTA_FIELDS_START 3
+struct StatusDeltaPacket : BTOasPacket
+{
+    StatusDeltaPacket(); // blank one is the keyframe request
+    StatusDeltaPacket(StatusFields *current, StatusFields *previous, uint8_t sequence); // previous nullptr makes a keyframe
+    uint8_t getMask();
+    uint8_t getSequence();
+    bool isKeyframe();
+    void apply(StatusFields *target); // copy the fields that are in here over target
 };
 
 struct PresetPacket : BTOasPacket
@@ -160,7 +283,7 @@ struct IdlePacket : BTOasPacket
 
 struct MessagePacket : BTOasPacket
 {
-    MessagePacket(short recipient, std::string message);
+    MessagePacket(std::string message);
 };
 
 // Incoming packets
@@ -263,6 +386,7 @@ struct ResetAIPacket : BTOasPacket
 {
     ResetAIPacket();
 };
+#define STARTWEB_FIELD_SIZE 50 // ssid at args[0], password at args[50]. Each one gets cut to 49 chars so there's always a 0 after it
 struct StartwebPacket : BTOasPacket
 {
     StartwebPacket(String ssid, String password);
@@ -287,6 +411,10 @@ struct AuthPacket : BTOasPacket
     uint32_t getBlePasskey();
     AuthResult getBleAuthResult();
     void setBleAuthResult(AuthResult ar);
+    uint32_t getCapabilities(); // BTOasCapability bits the app/controller supports, old apps leave this 0
+    void setCapabilities(uint32_t capabilities);
+    uint32_t getManifoldCapabilities(); // set by the manifold in the reply. Separate from the above because old manifolds just send the request back
+    void setManifoldCapabilities(uint32_t capabilities);
 };
 
 struct BP32Packet : BTOasPacket
@@ -308,6 +436,302 @@ struct UpdateStatusRequestPacket : BTOasPacket
     void setStatus(String status);
 };
 
+struct BootTimingsPacket : BTOasPacket
+{
+    BootTimingsPacket(); // blank one is the request
+    BootTimingsPacket(bool fastBoot, const uint32_t *phaseTimesMS);
+    bool getFastBoot();
+    uint32_t getPhaseTime(BootPhase phase); // ms since power on, 0 means it hasn't happened yet
+};
+
+// Export replies: args32[1] offset, args32[2] total size, args16[6] length of data, data starts at args[TELEMETRY_PACKET_DATA_START]
+#define TELEMETRY_PACKET_DATA_START 16
+#define TELEMETRY_PACKET_DATA_SIZE (sizeof(BTOasPacket::args) - TELEMETRY_PACKET_DATA_START)
+struct TelemetryPacket : BTOasPacket
+{
+    TelemetryPacket(TelemetryCMD telemetryCmd, uint32_t value);
+    TelemetryCMD getCommand();
+    uint32_t getValue();
+    uint32_t getTotalSize();
+    void setTotalSize(uint32_t size);
+    uint16_t getDataLength();
+    void setDataLength(uint16_t length);
+    uint8_t *data();
+};
+
+// Sent by a client to change how it gets status packets. Clients that never send this get the old fixed 4 per second
+struct StatusRatePacket : BTOasPacket
+{
+    StatusRatePacket(uint16_t maxRateHz, uint16_t deltaPSI, uint16_t heartbeatMS);
+    uint16_t getMaxRateHz();   // never sent faster than this
+    uint16_t getDeltaPSI();    // sent right away (up to the max rate) when a pressure moves at least this much. Status bits changing always counts
+    uint16_t getHeartbeatMS(); // sent at least this often even if nothing changed
+};
+
+// Opens valves for a set time using the manifold's own timers so a slow or lost close write can't leave air flowing.
+// With a repeat interval the pulse runs again every intervalMS, repeatCount more times.
+// Each one replaces the client's last one: valves it was pulsing that have a duration of 0 now get closed, so the blank one cancels everything.
+// Sending it again before the duration runs out keeps the valve open, which is how the controller holds a valve open while a button is held.
+// Everything pulsing gets closed when the client that started it disconnects
+#define VALVE_PULSE_MAX_MS 5000
+struct ValvePulsePacket : BTOasPacket
+{
+    ValvePulsePacket(); // cancel
+    ValvePulsePacket(const uint16_t durationsMS[8], uint16_t repeatIntervalMS = 0, uint16_t repeatCount = 0);
+    uint16_t getDuration(int valve); // index is SOLENOID_INDEX
+    uint16_t getRepeatInterval();
+    uint16_t getRepeatCount();
+};
+
+// Several packets in one write. The manifold runs them in order under the one auth check and replies with a BatchPacket holding
+// a BatchStatus for each one. Once one fails the rest are skipped, so a read profile that fails never gets followed by the air up.
+// args[0] is the count, then each packet is cmd (2 bytes), payload length (1 byte), payload. The reply is the count then one status byte each.
+// Auth packets and batches can't go in a batch. Packet i in the batch gets the batch's request id + 1 + i, so the client hands out a block of ids for one
+#define BATCH_MAX_PACKETS 16
+#define BATCH_FIRST_OFFSET 1 // where the first packet starts in args
+enum BatchStatus
+{
+    BATCH_STATUS_OK,
+    BATCH_STATUS_UNKNOWN,     // manifold doesn't know the command
+    BATCH_STATUS_TOO_SHORT,   // less payload than the command needs, or the batch ran out partway through it
+    BATCH_STATUS_NOT_ALLOWED, // can't be sent in a batch
+    BATCH_STATUS_SKIPPED,     // an earlier one failed so this one never ran
+};
+struct BatchPacket : BTOasPacket
+{
+    BatchPacket();
+    bool add(BTOasPacket *packet); // false if it won't fit, packet goes in with its compact payload
+    uint8_t getCount();
+    void setCount(uint8_t count);
+    int readPacket(int offset, BTOasPacket *copyTo, uint16_t *length); // copies out the packet at offset, length is header + payload like it was written on its own. Returns the next offset, or -1 if it runs past args
+    BatchStatus getStatus(int index); // reply only
+    void setStatus(int index, BatchStatus status);
+};
+
+// Bulk transfers move whole files off the manifold over the bulk characteristic instead of one rest packet at a time.
+// The client sends BULKCMD_OPEN with the resource, the offset to start at and a window. The manifold replies with the total size and
+// then notifies chunks of as much as the MTU fits, each one a BulkChunkHeader followed by the data.
+// The client acks the offset it has everything up to and the manifold never gets more than window chunks past the last ack.
+// A chunk with a bad CRC or a gap gets a BULKCMD_RESEND from that offset, and if the acks stop the manifold goes back to the last acked offset on its own.
+// Resuming after a reconnect is just opening again at the last acked offset
+enum BulkCMD
+{
+    BULKCMD_OPEN,   // resource, transferId, offset, window. Reply has the size and status
+    BULKCMD_ACK,    // offset = everything before this arrived fine
+    BULKCMD_RESEND, // offset = start again from here
+    BULKCMD_CANCEL,
+};
+enum BulkResource
+{
+    BULK_LEARN_UP_FRONT, // ai learn data files, same order as SOLENOID_AI_INDEX
+    BULK_LEARN_UP_REAR,
+    BULK_LEARN_DOWN_FRONT,
+    BULK_LEARN_DOWN_REAR,
+    BULK_TELEMETRY,           // telemetry partition, decode with tools/telemetry_decode.py
+    BULK_ALLOWED_CONTROLLERS, // the bp32 allowed gamepads file
+    BULK_SETTINGS,            // key=value lines of every setting except the wifi password
+    BULK_GAMEPAD_MAP,         // the bp32 gamepad bindings file, see GamepadMapPacket
+    BULK_RESOURCE_COUNT
+};
+enum BulkStatus
+{
+    BULK_STATUS_OK,
+    BULK_STATUS_NOT_FOUND,  // no such resource, or the file isn't there
+    BULK_STATUS_BUSY,       // too many transfers going already
+    BULK_STATUS_BAD_OFFSET, // past the end, size is still filled in so the client can start over
+};
+struct __attribute__((packed)) BulkChunkHeader
+{
+    uint16_t transferId;
+    uint32_t offset;
+    uint32_t crc; // bulkCrc32 of just the data in this chunk
+};
+#define BULK_MAX_NOTIFY_SIZE 512 // biggest chunk notify we'll ever build, mtu 517 minus the att header and a bit
+#define BULK_MAX_CHUNK_SIZE (BULK_MAX_NOTIFY_SIZE - sizeof(BulkChunkHeader))
+struct BulkPacket : BTOasPacket
+{
+    BulkPacket(BulkCMD bulkCmd, uint16_t transferId, uint32_t offset);
+    BulkCMD getCommand();
+    uint16_t getTransferId();
+    uint32_t getOffset();
+    BulkResource getResource();
+    void setResource(BulkResource resource);
+    uint8_t getWindow(); // chunks
+    void setWindow(uint8_t window);
+    uint32_t getSize(); // open reply only
+    void setSize(uint32_t size);
+    BulkStatus getStatus(); // open reply only
+    void setStatus(BulkStatus status);
+};
+uint32_t bulkCrc32(const uint8_t *data, size_t length, uint32_t crc = 0); // standard crc32 (same as zlib), pass the last result back in to keep going
+
+// Everything the controller shows on connect in one reply: config, every preset, the firmware/update status and the current status frame.
+// The client sends the boot id and state version from the last full reply it got (0 for none). If they still match, the manifold only sends
+// the status frame back. The version goes up every time a saved setting changes, and the boot id is new every boot so an old version never matches
+#define STATESYNC_STATUS_SIZE 16  // StatusPacket payload
+#define STATESYNC_CONFIG_SIZE 12  // ConfigValuesPacket payload
+#define STATESYNC_VERSION_SIZE 20 // same text as UpdateStatusRequestPacket
+struct StateSyncPacket : BTOasPacket
+{
+    StateSyncPacket(uint32_t bootId = 0, uint32_t stateVersion = 0);
+    uint32_t getBootId();
+    uint32_t getStateVersion();
+    bool isFull(); // reply has config, presets and version in it. If not nothing changed since what the client sent
+    void setFull(bool full);
+    uint8_t *status();
+    uint8_t *config();
+    uint8_t getPresetPressure(int profileIndex, int wheel);
+    void setPresetPressure(int profileIndex, int wheel, uint8_t pressure);
+    String getFirmwareVersion();
+    void setFirmwareVersion(String version);
+};
+
+// Link benchmark. Either side can send a PING and the other side sends it straight back as an ECHO with the same sequence and sender time,
+// so the round trip is measured on one clock. THROUGHPUT asks the manifold to stream FILLER packets (full size) for value ms as fast as
+// the link takes them, then it sends THROUGHPUT_DONE with how many went out
+enum PingCMD
+{
+    PINGCMD_PING,
+    PINGCMD_ECHO,
+    PINGCMD_THROUGHPUT,
+    PINGCMD_FILLER,
+    PINGCMD_THROUGHPUT_DONE,
+};
+#define PING_THROUGHPUT_MAX_MS 30000
+struct PingPacket : BTOasPacket
+{
+    PingPacket(PingCMD pingCmd, uint16_t sequence, uint32_t value = 0);
+    PingCMD getCommand();
+    void setCommand(PingCMD pingCmd);
+    uint16_t getSequence();
+    uint32_t getSenderTime(); // micros() on the side that sent the ping
+    void setSenderTime(uint32_t us);
+    uint32_t getEchoTime(); // micros() on the side that echoed it, only good for comparing echoes from the same side
+    void setEchoTime(uint32_t us);
+    uint32_t getValue(); // throughput: duration ms, done: filler packets sent
+    uint32_t getBytes(); // done: filler bytes sent
+    void setBytes(uint32_t bytes);
+    void fill(); // pads out the rest of args so the packet goes out full size
+};
+
+// How a bluepad32 gamepad's sticks drive the valves. On/off opens them fully past a fixed threshold. Proportional runs the valves
+// at a duty cycle that follows how far the stick is pushed, past the dead zone and through the curve
+// Sent with setValues false it's just a request, either way the reply has what the manifold is using now
+enum JoystickMode
+{
+    JOYSTICK_MODE_ON_OFF,
+    JOYSTICK_MODE_PROPORTIONAL,
+};
+#define JOYSTICK_DEADZONE_MAX 90 // percent of full stick
+#define JOYSTICK_CURVE_MIN 5     // tenths, 10 is linear and 20 is squared (finer control near the middle)
+#define JOYSTICK_CURVE_MAX 40
+#define JOYSTICK_PERIOD_MIN_MS 100
+#define JOYSTICK_PERIOD_MAX_MS 1000
+struct JoystickConfigPacket : BTOasPacket
+{
+    JoystickConfigPacket(bool setValues, JoystickMode mode, uint8_t deadzonePercent, uint8_t curveTenths, uint16_t periodMS);
+    bool getSetValues();
+    void setSetValues(bool setValues);
+    JoystickMode getMode();
+    uint8_t getDeadzone();
+    uint8_t getCurve();
+    uint16_t getPeriod(); // ms for one open/close cycle in proportional mode
+};
+
+// Gamepad bindings. Each one is a trigger on some gamepad inputs and the action it runs. Inputs are one 32 bit word per gamepad:
+// buttons in the low 16 bits, dpad from bit 16 and the misc buttons from bit 20, the same bits bluepad32 uses for each of them
+#define GAMEPAD_INPUT_A (1 << 0)
+#define GAMEPAD_INPUT_B (1 << 1)
+#define GAMEPAD_INPUT_X (1 << 2)
+#define GAMEPAD_INPUT_Y (1 << 3)
+#define GAMEPAD_INPUT_L1 (1 << 4)
+#define GAMEPAD_INPUT_R1 (1 << 5)
+#define GAMEPAD_INPUT_L2 (1 << 6)
+#define GAMEPAD_INPUT_R2 (1 << 7)
+#define GAMEPAD_INPUT_L3 (1 << 8)
+#define GAMEPAD_INPUT_R3 (1 << 9)
+#define GAMEPAD_INPUT_DPAD_SHIFT 16
+#define GAMEPAD_INPUT_UP (1 << 16)
+#define GAMEPAD_INPUT_DOWN (1 << 17)
+#define GAMEPAD_INPUT_RIGHT (1 << 18)
+#define GAMEPAD_INPUT_LEFT (1 << 19)
+#define GAMEPAD_INPUT_MISC_SHIFT 20
+#define GAMEPAD_INPUT_SYSTEM (1 << 20)
+#define GAMEPAD_INPUT_SELECT (1 << 21)
+#define GAMEPAD_INPUT_START (1 << 22)
+#define GAMEPAD_INPUT_CAPTURE (1 << 23)
+
+enum GamepadTrigger
+{
+    GAMEPAD_TRIGGER_PRESS,      // inputs[0] becomes exactly what's held. Several bits is a combo
+    GAMEPAD_TRIGGER_LONG_PRESS, // inputs[0] held for holdMS. A press on the same inputs then only runs if it's let go before that
+    GAMEPAD_TRIGGER_SEQUENCE,   // each of inputs[0..steps) pressed in order, no more than GAMEPAD_SEQUENCE_TIMEOUT_MS apart
+};
+enum GamepadAction
+{
+    GAMEPAD_ACTION_NONE,
+    GAMEPAD_ACTION_PRESET,     // arg is the preset index, loads it and airs up to it
+    GAMEPAD_ACTION_AIR_UP,     // base profile
+    GAMEPAD_ACTION_AIR_OUT,
+    GAMEPAD_ACTION_RAISE,      // arg is psi, negative lowers. All 4 relative to the average
+    GAMEPAD_ACTION_VALVES,     // arg is a mask of SOLENOID_INDEX bits, open while the inputs stay held
+    GAMEPAD_ACTION_ARM_TOGGLE, // everything else is ignored while disarmed
+    GAMEPAD_ACTION_DISCONNECT,
+    GAMEPAD_ACTION_KONAMI,
+};
+#define GAMEPAD_SEQUENCE_MAX 10
+#define GAMEPAD_SEQUENCE_TIMEOUT_MS 1500
+#define GAMEPAD_LONG_PRESS_DEFAULT_MS 800 // when holdMS is 0
+struct GamepadBinding
+{
+    uint8_t trigger; // GamepadTrigger
+    uint8_t action;  // GamepadAction
+    int16_t arg;
+    uint16_t holdMS;
+    uint8_t steps; // how many of inputs are used, 1 unless it's a sequence
+    uint8_t reserved;
+    uint32_t inputs[GAMEPAD_SEQUENCE_MAX];
+};
+
+// Reads and edits the manifold's gamepad bindings one at a time. Every command replies with the same command, the index, how many
+// bindings there are now and a GamepadMapStatus. GET also sends back the binding at index. SET at index count adds one to the end
+enum GamepadMapCMD
+{
+    GAMEPADMAPCMD_GET,
+    GAMEPADMAPCMD_SET,
+    GAMEPADMAPCMD_REMOVE,
+    GAMEPADMAPCMD_RESET, // back to the built in defaults
+};
+enum GamepadMapStatus
+{
+    GAMEPADMAP_STATUS_OK,
+    GAMEPADMAP_STATUS_BAD_INDEX,
+    GAMEPADMAP_STATUS_INVALID, // binding doesn't make sense or doesn't fit in the lookup table, nothing changed
+};
+#define GAMEPADMAP_BINDING_OFFSET 4
+struct GamepadMapPacket : BTOasPacket
+{
+    GamepadMapPacket(GamepadMapCMD mapCmd, uint8_t index);
+    GamepadMapCMD getCommand();
+    uint8_t getIndex();
+    uint8_t getCount();
+    void setCount(uint8_t count);
+    GamepadMapStatus getStatus();
+    void setStatus(GamepadMapStatus status);
+    void getBinding(GamepadBinding *binding);
+    void setBinding(const GamepadBinding *binding);
+};
+
+// Sent on the rest characteristic in place of a reply that doesn't fit in the mtu, even with the trailing 0's left off.
+// Carries the requestId of the packet it replaces so the client can stop waiting on it
+struct TooLargePacket : BTOasPacket
+{
+    TooLargePacket(uint16_t packetCmd, uint16_t length, uint16_t mtu);
+    uint16_t getPacketCmd(); // cmd of the packet that didn't go out
+    uint16_t getLength();    // how many bytes it needed
+    uint16_t getMTU();
+};
+
 struct AuxillaryOutputModePacket : BTOasPacket
 {
     AuxillaryOutputModePacket();
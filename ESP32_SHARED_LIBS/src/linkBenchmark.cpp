@@ -0,0 +1,138 @@
+#include "linkBenchmark.h"
+
+void LinkBenchmark::reset()
+{
+    memset(this, 0, sizeof(LinkBenchmark));
+}
+
+void LinkBenchmark::addRtt(uint32_t us)
+{
+    if (this->rttCount < LINK_BENCH_MAX_SAMPLES)
+    {
+        this->rttUS[this->rttCount] = us;
+    }
+    this->rttCount++;
+}
+
+void LinkBenchmark::addFiller(uint16_t sequence, uint16_t bytes, uint32_t nowUS)
+{
+    if (this->fillerCount == 0)
+    {
+        this->firstFillerUS = nowUS;
+    }
+    else
+    {
+        this->fillerLost += (uint16_t)(sequence - this->nextFillerSequence);
+        uint32_t interval = nowUS - this->lastFillerUS;
+        if (this->fillerCount > 1)
+        {
+            this->jitterSumUS += interval > this->lastIntervalUS ? interval - this->lastIntervalUS : this->lastIntervalUS - interval;
+        }
+        this->lastIntervalUS = interval;
+    }
+    this->nextFillerSequence = sequence + 1;
+    this->lastFillerUS = nowUS;
+    this->fillerCount++;
+    this->fillerBytes += bytes;
+}
+
+uint32_t LinkBenchmark::rttPercentileUS(int percent)
+{
+    int count = this->rttCount < LINK_BENCH_MAX_SAMPLES ? this->rttCount : LINK_BENCH_MAX_SAMPLES;
+    if (count == 0)
+    {
+        return 0;
+    }
+    // small enough that sorting a copy every time is fine
+    uint32_t sorted[LINK_BENCH_MAX_SAMPLES];
+    memcpy(sorted, this->rttUS, count * sizeof(uint32_t));
+    for (int i = 1; i < count; i++)
+    {
+        uint32_t value = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > value)
+        {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+    int index = (count * percent + 99) / 100 - 1; // nearest rank
+    return sorted[index < 0 ? 0 : index];
+}
+
+uint32_t LinkBenchmark::jitterUS()
+{
+    return this->fillerCount > 2 ? this->jitterSumUS / (this->fillerCount - 2) : 0;
+}
+
+uint32_t LinkBenchmark::bytesPerSecond()
+{
+    uint32_t elapsed = this->lastFillerUS - this->firstFillerUS;
+    return elapsed == 0 ? 0 : (uint64_t)this->fillerBytes * 1000000 / elapsed;
+}
+
+void LinkBenchmark::formatRtt(char *buf, size_t len)
+{
+    snprintf(buf, len, "p50 %.1f p90 %.1f p99 %.1fms (%u/%u)", this->rttPercentileUS(50) / 1000.0f, this->rttPercentileUS(90) / 1000.0f, this->rttPercentileUS(99) / 1000.0f, this->rttCount, this->pingsSent);
+}
+
+void LinkBenchmark::formatThroughput(char *buf, size_t len)
+{
+    snprintf(buf, len, "%u B/s jitter %.1fms lost %u", this->bytesPerSecond(), this->jitterUS() / 1000.0f, this->fillerLost);
+}
+
+LinkBenchCommand readLinkBenchCommand(uint32_t *arg, char *other, size_t otherSize)
+{
+    static char line[32];
+    static size_t length = 0;
+    while (Serial.available() > 0)
+    {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r')
+        {
+            if (length < sizeof(line) - 1)
+            {
+                line[length++] = c;
+            }
+            continue;
+        }
+        line[length] = 0;
+        length = 0;
+
+        LinkBenchCommand command = LINK_BENCH_NONE;
+        const char *rest = "";
+        if (strncmp(line, "ping", 4) == 0)
+        {
+            command = LINK_BENCH_PING;
+            rest = line + 4;
+            *arg = 100;
+        }
+        else if (strncmp(line, "throughput", 10) == 0)
+        {
+            command = LINK_BENCH_THROUGHPUT;
+            rest = line + 10;
+            *arg = 5;
+        }
+        else if (strcmp(line, "bench") == 0)
+        {
+            command = LINK_BENCH_PRINT;
+        }
+        int value = atoi(rest);
+        if (value > 0)
+        {
+            *arg = value;
+        }
+        if (command != LINK_BENCH_NONE)
+        {
+            return command;
+        }
+        if (other != nullptr && otherSize > 0 && line[0] != 0)
+        {
+            strncpy(other, line, otherSize - 1);
+            other[otherSize - 1] = 0;
+            return LINK_BENCH_OTHER;
+        }
+    }
+    return LINK_BENCH_NONE;
+}
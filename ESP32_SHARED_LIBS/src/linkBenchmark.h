@@ -0,0 +1,56 @@
+// Round trip and throughput numbers for the bluetooth link, filled in by whichever side is running the test (see PingPacket).
+// Not thread safe, the side running the test adds samples from its bluetooth callbacks and only reads them once the test is done.
+
+// NOTICE: This file is used by both the manifold and the Wireless_Controller project
+
+#ifndef linkBenchmark_h
+#define linkBenchmark_h
+
+#include <Arduino.h>
+
+#define LINK_BENCH_MAX_SAMPLES 128 // round trips kept, anything past this is counted but not used for the percentiles
+
+struct LinkBenchmark
+{
+    // ping
+    uint32_t rttUS[LINK_BENCH_MAX_SAMPLES];
+    uint16_t rttCount;
+    uint16_t pingsSent;
+
+    // throughput, the other side streams filler packets at us
+    uint32_t fillerCount;
+    uint32_t fillerBytes;
+    uint32_t fillerLost; // gaps in the sequence
+    uint16_t nextFillerSequence;
+    uint32_t firstFillerUS;
+    uint32_t lastFillerUS;
+    uint32_t lastIntervalUS;
+    uint64_t jitterSumUS; // sum of how much each gap between packets differed from the one before it
+
+    void reset();
+    void addRtt(uint32_t us);
+    void addFiller(uint16_t sequence, uint16_t bytes, uint32_t nowUS);
+    uint32_t rttPercentileUS(int percent); // 0 if there's nothing yet
+    uint32_t jitterUS();
+    uint32_t bytesPerSecond();
+    void formatRtt(char *buf, size_t len);        // "p50 12.1 p90 15.0 p99 30.2ms (100/100)"
+    void formatThroughput(char *buf, size_t len); // "8123 B/s jitter 1.2ms lost 0"
+};
+
+// Both sides take the same commands over usb serial so a test can be scripted from either end:
+//   ping [count]          round trips, 100 if no count
+//   throughput [seconds]  manifold streams filler at us, 5 if no seconds
+//   bench                 print the last results again
+// Results get printed as lines starting with BENCH. Any other line comes back as LINK_BENCH_OTHER with the text copied into
+// other, so a side can take its own commands over the same serial without two readers fighting over it
+enum LinkBenchCommand
+{
+    LINK_BENCH_NONE,
+    LINK_BENCH_PING,
+    LINK_BENCH_THROUGHPUT,
+    LINK_BENCH_PRINT,
+    LINK_BENCH_OTHER,
+};
+LinkBenchCommand readLinkBenchCommand(uint32_t *arg, char *other = nullptr, size_t otherSize = 0); // doesn't block, only returns a command once a whole line came in
+
+#endif
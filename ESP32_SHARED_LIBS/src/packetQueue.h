@@ -0,0 +1,166 @@
+// Bounded FIFO ring buffer for queueing packets between tasks.
+// Any number of tasks can push (including the bluetooth stack callbacks) and pop, though normally one task does the popping.
+// Lock free: every slot has a sequence number that says whose turn it is. Push and pop claim a position with a compare and swap
+// and only touch that slot after, so nothing ever sleeps, spins on delay() or waits on the other core holding a lock.
+// Same layout as Dmitry Vyukov's bounded queue.
+
+// NOTICE: This file is used by both the manifold and the Wireless_Controller project
+
+#ifndef packetQueue_h
+#define packetQueue_h
+
+#include <Arduino.h>
+#include <atomic>
+
+template <typename T, uint16_t CAPACITY>
+class PacketQueue
+{
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "PacketQueue capacity has to be a power of 2");
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence; // == position when it's free to push into, position + 1 once it holds an entry
+        T entry;
+    };
+
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> tail;  // next position to push
+    std::atomic<uint32_t> head;  // next position to pop
+    std::atomic<uint32_t> overflowCount;
+    std::atomic<uint16_t> highWater;
+
+    // slot that's next to pop, or nullptr if there isn't one
+    Slot *headSlot(uint32_t *position)
+    {
+        *position = head.load(std::memory_order_relaxed);
+        Slot *slot = &slots[*position & (CAPACITY - 1)];
+        return slot->sequence.load(std::memory_order_acquire) == *position + 1 ? slot : nullptr;
+    }
+
+public:
+    PacketQueue()
+    {
+        for (uint32_t i = 0; i < CAPACITY; i++)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        tail.store(0, std::memory_order_relaxed);
+        head.store(0, std::memory_order_relaxed);
+        overflowCount.store(0, std::memory_order_relaxed);
+        highWater.store(0, std::memory_order_relaxed);
+    }
+
+    // returns false and counts it as an overflow if the queue is full
+    bool push(const T &entry)
+    {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;)
+        {
+            slot = &slots[position & (CAPACITY - 1)];
+            int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - position);
+            if (diff == 0)
+            {
+                // free, try to claim it. On failure position gets the tail someone else moved it to
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // hasn't been popped since last time round, full
+                overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = tail.load(std::memory_order_relaxed); // another push got it first
+            }
+        }
+        memcpy(&slot->entry, &entry, sizeof(T));
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        // only a statistic, a push racing with this one can make it a little low
+        uint16_t queued = (uint16_t)(position + 1 - head.load(std::memory_order_relaxed));
+        if (queued > highWater.load(std::memory_order_relaxed))
+        {
+            highWater.store(queued, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    bool pop(T *copyTo)
+    {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;)
+        {
+            slot = &slots[position & (CAPACITY - 1)];
+            int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - (position + 1));
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // nothing pushed there yet
+            }
+            else
+            {
+                position = head.load(std::memory_order_relaxed); // another pop got it first
+            }
+        }
+        memcpy(copyTo, &slot->entry, sizeof(T));
+        slot->sequence.store(position + CAPACITY, std::memory_order_release); // free for the push one lap later
+        return true;
+    }
+
+    // look at the next one without taking it. Only safe from the one task that pops
+    bool peek(T *copyTo)
+    {
+        uint32_t position;
+        Slot *slot = headSlot(&position);
+        if (slot == nullptr)
+        {
+            return false;
+        }
+        memcpy(copyTo, &slot->entry, sizeof(T));
+        return true;
+    }
+
+    void clear()
+    {
+        T discard;
+        while (pop(&discard))
+        {
+        }
+    }
+
+    uint16_t size()
+    {
+        return (uint16_t)(tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed));
+    }
+
+    bool isEmpty()
+    {
+        uint32_t position;
+        return headSlot(&position) == nullptr;
+    }
+
+    uint32_t getOverflowCount()
+    {
+        return overflowCount.load(std::memory_order_relaxed);
+    }
+
+    uint16_t getHighWater()
+    {
+        return highWater.load(std::memory_order_relaxed);
+    }
+};
+
+#endif
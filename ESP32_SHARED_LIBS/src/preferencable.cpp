@@ -5,6 +5,12 @@
 #define SAVEDATA_NAMESPACE "savedata"
 
 Preferences preferences;
+static volatile uint32_t changeCount = 0;
+
+uint32_t getPreferencableChangeCount()
+{
+    return changeCount;
+}
 
 void openNamespace(const char *ns, bool ro)
 {
@@ -60,10 +66,41 @@ void deleteFile(const char *name) {
     SPIFFS.remove(name);
 }
 
+void loadPreferencableSchema(const PreferencableSchemaEntry *schema, size_t count)
+{
+    openNamespace(SAVEDATA_NAMESPACE, true); // fails on a fresh chip since the namespace doesn't exist yet, the gets below will just return the defaults then
+    for (size_t i = 0; i < count; i++)
+    {
+        const PreferencableSchemaEntry *entry = &schema[i];
+        Preferencable *pref = entry->pref;
+        memset(pref->name, 0, sizeof(pref->name));
+        strncpy(pref->name, entry->key, sizeof(pref->name) - 1);
+        pref->defaultString = entry->defaultString;
+        switch (entry->type)
+        {
+        case PREFERENCABLE_INT:
+            pref->value.i = preferences.getULong64(pref->name, (uint64_t)entry->defaultValue);
+            if (entry->minValue < entry->maxValue && (pref->value.i < entry->minValue || pref->value.i > entry->maxValue))
+            {
+                log_i("%s out of range (%llu), using default", pref->name, pref->value.i);
+                pref->value.i = (uint64_t)entry->defaultValue;
+            }
+            break;
+        case PREFERENCABLE_DOUBLE:
+            pref->value.d = preferences.getDouble(pref->name, entry->defaultValue);
+            break;
+        case PREFERENCABLE_STRING:
+            // strings aren't cached, getString reads them and falls back to defaultString
+            break;
+        }
+    }
+    endNamespace();
+}
+
 void Preferencable::load(const char *name, uint64_t defaultValue)
 {
-    memset(this->name, 0, sizeof(this->name));     // make sure it's 0 terminated
-    strncpy(this->name, name, sizeof(this->name)); // cap it to 14 with 0 termination at end
+    memset(this->name, 0, sizeof(this->name));         // make sure it's 0 terminated
+    strncpy(this->name, name, sizeof(this->name) - 1); // cap it to 15 with 0 termination at end
     openNamespace(SAVEDATA_NAMESPACE, true);
     if (preferences.isKey(this->name) == false)
     {
@@ -74,7 +111,7 @@ void Preferencable::load(const char *name, uint64_t defaultValue)
     }
     else
     {
-        this->value.i = preferences.getULong64(name, defaultValue);
+        this->value.i = preferences.getULong64(this->name, defaultValue);
     }
     endNamespace();
 }
@@ -84,6 +121,7 @@ void Preferencable::set(uint64_t val)
     if (this->value.i != val)
     {
         this->value.i = val;
+        changeCount++;
         openNamespace(SAVEDATA_NAMESPACE, false);
         preferences.putULong64(this->name, val);
         endNamespace();
@@ -92,9 +130,10 @@ void Preferencable::set(uint64_t val)
 
 void Preferencable::loadDouble(const char *name, double defaultValue)
 {
-    strncpy(this->name, name, sizeof(this->name));
+    memset(this->name, 0, sizeof(this->name));
+    strncpy(this->name, name, sizeof(this->name) - 1);
     openNamespace(SAVEDATA_NAMESPACE, true);
-    if (preferences.isKey(name) == false)
+    if (preferences.isKey(this->name) == false)
     {
         endNamespace();
         openNamespace(SAVEDATA_NAMESPACE, false); // reopen as read write
@@ -103,7 +142,7 @@ void Preferencable::loadDouble(const char *name, double defaultValue)
     }
     else
     {
-        this->value.d = preferences.getDouble(name, defaultValue);
+        this->value.d = preferences.getDouble(this->name, defaultValue);
     }
     endNamespace();
 }
@@ -113,6 +152,7 @@ void Preferencable::setDouble(double val)
     if (this->value.d != val)
     {
         this->value.d = val;
+        changeCount++;
         openNamespace(SAVEDATA_NAMESPACE, false);
         preferences.putDouble(this->name, val);
         endNamespace();
@@ -120,9 +160,11 @@ void Preferencable::setDouble(double val)
 }
 
 void Preferencable::loadString(const char *name, String defaultValue) {
-    strncpy(this->name, name, sizeof(this->name));
+    memset(this->name, 0, sizeof(this->name));
+    strncpy(this->name, name, sizeof(this->name) - 1);
+    this->defaultString = nullptr; // default gets written below so no need to keep it
     openNamespace(SAVEDATA_NAMESPACE, true);
-    if (preferences.isKey(name) == false)
+    if (preferences.isKey(this->name) == false)
     {
         endNamespace();
         openNamespace(SAVEDATA_NAMESPACE, false); // reopen as read write
@@ -131,19 +173,21 @@ void Preferencable::loadString(const char *name, String defaultValue) {
     endNamespace();
 }
 void Preferencable::setString(String val) {
+    changeCount++;
     openNamespace(SAVEDATA_NAMESPACE, false);
     preferences.putString(this->name, val);
     endNamespace();
 }
 String Preferencable::getString() {
     openNamespace(SAVEDATA_NAMESPACE, true);
-    String str = preferences.getString(this->name,"");
+    String str = preferences.getString(this->name, this->defaultString ? this->defaultString : "");
     endNamespace();
     return str;
 }
 
 void Preferencable::deletePreference()
 {
+    changeCount++;
     ::deletePreference(this->name);
 }
 
@@ -15,9 +15,10 @@ class Preferencable
 {
 
 public:
-    char name[15]; // 15 is max len. Note for future devs: I didn't add any code to make sure it is 0 terminated so be careful how you choose a name i guess
+    char name[16]; // 15 is max len for nvs keys, the extra byte is so it is always 0 terminated
     // char buffer[4];
     PreferencableValue value;
+    const char *defaultString; // only used for strings loaded from a schema, since their default is never written to flash
     void load(const char *name, uint64_t defaultValue);
     void set(uint64_t val);
     void loadDouble(const char *name, double defaultValue);
@@ -35,6 +36,42 @@ public:
     }
 };
 
+enum PreferencableType
+{
+    PREFERENCABLE_INT,
+    PREFERENCABLE_DOUBLE,
+    PREFERENCABLE_STRING,
+};
+
+// One row of a settings schema. The whole schema is a const table so the keys, defaults and the pointers to the values all get baked in at compile time
+// and boot only has to open the namespace once and read them in a row. Nothing gets written at load, missing keys just keep the default in ram
+// and only get written the first time the value is actually changed.
+struct PreferencableSchemaEntry
+{
+    Preferencable *pref;
+    const char *key;
+    PreferencableType type;
+    double defaultValue; // used by ints too, every default we have fits in a double fine
+    double minValue;     // if min >= max there is no range check
+    double maxValue;
+    const char *defaultString;
+};
+
+// makes sure the key fits in nvs (15 chars max) at compile time
+template <size_t N>
+constexpr const char *nvsKey(const char (&key)[N])
+{
+    static_assert(N <= 16, "nvs keys can only be 15 characters long");
+    return key;
+}
+
+#define schemaInt(VARNAME, KEY, DEFAULT, MIN, MAX) {&_SaveData.VARNAME, nvsKey(KEY), PREFERENCABLE_INT, (double)(DEFAULT), (double)(MIN), (double)(MAX), nullptr}
+#define schemaDouble(VARNAME, KEY, DEFAULT) {&_SaveData.VARNAME, nvsKey(KEY), PREFERENCABLE_DOUBLE, (double)(DEFAULT), 0, 0, nullptr}
+#define schemaString(VARNAME, KEY, DEFAULT) {&_SaveData.VARNAME, nvsKey(KEY), PREFERENCABLE_STRING, 0, 0, 0, DEFAULT}
+
+// loads every entry in the schema with a single read only namespace open
+void loadPreferencableSchema(const PreferencableSchemaEntry *schema, size_t count);
+
 size_t readBytes(const char *name, void *buf, size_t maxLen);
 
 void writeBytes(const char *name, const void *bytes, size_t len, const char *mode = "w");
@@ -42,6 +79,8 @@ void deleteFile(const char *name);
 
 void deletePreference(const char *name);
 
+uint32_t getPreferencableChangeCount(); // goes up every time a saved value actually changes, so anyone caching settings can tell theirs are stale
+
 #define createSaveFuncInt(VARNAME, _TYPE) \
     _TYPE get##VARNAME()                  \
     {                                     \
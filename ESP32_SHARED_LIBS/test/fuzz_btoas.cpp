@@ -0,0 +1,244 @@
+// Feeds arbitrary bytes through the same decoding a received rest packet goes through on the manifold and the controller:
+// BTOasPacket::rx, the payload size check the manifold does before a handler runs, every getter that reads strings or
+// offsets out of args, and the packets inside a BatchPacket. Run under the sanitizers so any read past args gets caught.
+//
+// Builds two ways (see CMakeLists.txt). With clang and -DBTOAS_LIBFUZZER=ON it's a normal libFuzzer target. Otherwise it's a
+// plain program that runs the files it's given, or a fixed number of random packets if there aren't any (that's what ctest runs)
+
+#include "BTOas.h"
+
+static uint32_t sink; // everything the getters return goes in here so none of it gets optimized away
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "fuzz_btoas: %s\n", what);
+        abort();
+    }
+}
+
+static void decodeString(String str, size_t fieldSize)
+{
+    check(str.length() < fieldSize + 1, "string read past its field");
+    sink += str.length();
+}
+
+static void decodePacket(BTOasPacket *packet, uint16_t length, int depth)
+{
+    // same check runReceivedPacket makes. The handler table asks for at most the payload size, so this is the strictest it gets
+    uint16_t payloadSize = getBTOasPayloadSize(packet->cmd);
+    if (payloadSize != BTOAS_PAYLOAD_VARIABLE && length < BTOAS_HEADER_SIZE + payloadSize)
+    {
+        return;
+    }
+
+    // the compact encoding of whatever came in has to decode back to the same packet, trimmed or not
+    check(packet->payloadSize() <= sizeof(packet->args), "payload size past args");
+    uint16_t compactLength = packet->txLength(true);
+    check(compactLength >= BTOAS_HEADER_SIZE && compactLength <= BTOAS_PACKET_SIZE, "compact length out of range");
+    BTOasPacket copy;
+    check(copy.rx(packet->tx(), compactLength), "compact packet doesn't decode");
+    check(memcmp(copy.tx(), packet->tx(), compactLength) == 0, "compact packet decodes different");
+    uint16_t trimmed = packet->trimmedLength(BTOAS_PACKET_SIZE);
+    check(copy.rx(packet->tx(), trimmed), "trimmed packet doesn't decode");
+    check(memcmp(copy.tx(), packet->tx(), BTOAS_PACKET_SIZE) == 0, "trimmed packet decodes different");
+
+    switch (packet->cmd)
+    {
+    case STARTWEB:
+        decodeString(((StartwebPacket *)packet)->getSSID(), STARTWEB_FIELD_SIZE);
+        decodeString(((StartwebPacket *)packet)->getPassword(), STARTWEB_FIELD_SIZE);
+        break;
+    case BROADCASTNAME:
+        decodeString(((BroadcastNamePacket *)packet)->getBroadcastName(), sizeof(packet->args));
+        break;
+    case UPDATESTATUSREQUEST:
+        decodeString(((UpdateStatusRequestPacket *)packet)->getStatus(), sizeof(packet->args));
+        break;
+    case STATESYNC:
+    {
+        StateSyncPacket *sync = (StateSyncPacket *)packet;
+        decodeString(sync->getFirmwareVersion(), STATESYNC_VERSION_SIZE);
+        for (int profile = 0; profile < MAX_PROFILE_COUNT; profile++)
+        {
+            for (int wheel = 0; wheel < 4; wheel++)
+            {
+                sink += sync->getPresetPressure(profile, wheel);
+            }
+        }
+        sink += sync->isFull() + sync->getBootId() + sync->getStateVersion();
+        break;
+    }
+    case STATUSDELTA:
+    {
+        StatusFields target;
+        memset(&target, 0, sizeof(target));
+        ((StatusDeltaPacket *)packet)->apply(&target);
+        sink += target.bittset + target.pressures[4];
+        break;
+    }
+    case VALVEPULSE:
+    {
+        ValvePulsePacket *pulse = (ValvePulsePacket *)packet;
+        for (int i = 0; i < SOLENOID_COUNT; i++)
+        {
+            sink += pulse->getDuration(i);
+        }
+        sink += pulse->getRepeatInterval() + pulse->getRepeatCount();
+        break;
+    }
+    case BOOTTIMINGS:
+        for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+        {
+            sink += ((BootTimingsPacket *)packet)->getPhaseTime((BootPhase)i);
+        }
+        break;
+    case TELEMETRYPKT:
+    {
+        TelemetryPacket *telemetry = (TelemetryPacket *)packet;
+        // the controller copies this much out of data(), so the length it's given can't be trusted
+        uint16_t dataLength = telemetry->getDataLength();
+        if (dataLength <= TELEMETRY_PACKET_DATA_SIZE)
+        {
+            for (uint16_t i = 0; i < dataLength; i++)
+            {
+                sink += telemetry->data()[i];
+            }
+        }
+        break;
+    }
+    case BULKPKT:
+    {
+        BulkPacket *bulk = (BulkPacket *)packet;
+        sink += bulk->getCommand() + bulk->getTransferId() + bulk->getOffset() + bulk->getResource() + bulk->getWindow() + bulk->getSize() + bulk->getStatus();
+        break;
+    }
+    case GAMEPADMAP:
+    {
+        GamepadBinding binding;
+        ((GamepadMapPacket *)packet)->getBinding(&binding);
+        sink += binding.inputs[GAMEPAD_SEQUENCE_MAX - 1] + ((GamepadMapPacket *)packet)->getIndex();
+        break;
+    }
+    case BATCH:
+    {
+        // walked the same way handleBatch does. A batch inside a batch gets turned away there, but decode it anyways
+        BatchPacket *batch = (BatchPacket *)packet;
+        uint8_t count = batch->getCount();
+        if (count > BATCH_MAX_PACKETS)
+        {
+            count = BATCH_MAX_PACKETS;
+        }
+        int offset = BATCH_FIRST_OFFSET;
+        for (int i = 0; i < count && offset >= 0; i++)
+        {
+            BTOasPacket sub;
+            uint16_t subLength = 0;
+            offset = batch->readPacket(offset, &sub, &subLength);
+            if (offset >= 0)
+            {
+                check(offset <= (int)sizeof(packet->args), "batch offset past args");
+                check(subLength >= BTOAS_HEADER_SIZE && subLength <= BTOAS_PACKET_SIZE, "batch packet length out of range");
+                if (depth < 2)
+                {
+                    decodePacket(&sub, subLength, depth + 1);
+                }
+            }
+            sink += batch->getStatus(i);
+        }
+        break;
+    }
+    default:
+        sink += packet->expectsReply();
+        break;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    BTOasPacket packet;
+    if (!packet.rx(data, size))
+    {
+        check(size < BTOAS_HEADER_SIZE || size > BTOAS_PACKET_SIZE, "rx turned away a packet that fits");
+        return 0;
+    }
+    decodePacket(&packet, size, 0);
+    return 0;
+}
+
+#ifndef BTOAS_LIBFUZZER
+
+static uint32_t rngState = 0x4F415331; // fixed so a failure shows up the same way every run
+
+static uint32_t rng()
+{
+    // xorshift32
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// random bytes, but mostly with a real cmd in front so they make it past the switch, and sometimes a batch made of real looking packets
+static size_t randomPacket(uint8_t *buffer, size_t bufferSize)
+{
+    size_t size = rng() % bufferSize;
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer[i] = rng();
+    }
+    if (size >= 2 && rng() % 8 != 0)
+    {
+        uint16_t cmd = rng() % (PACKETTOOLARGE + 2);
+        memcpy(buffer, &cmd, sizeof(cmd));
+    }
+    if (size > BTOAS_HEADER_SIZE + BATCH_FIRST_OFFSET && rng() % 4 == 0)
+    {
+        uint16_t cmd = BATCH;
+        memcpy(buffer, &cmd, sizeof(cmd));
+        uint8_t *args = &buffer[BTOAS_HEADER_SIZE];
+        size_t argsSize = size - BTOAS_HEADER_SIZE;
+        args[0] = rng() % (BATCH_MAX_PACKETS + 4);
+        size_t offset = BATCH_FIRST_OFFSET;
+        while (offset + 3 <= argsSize)
+        {
+            args[offset] = rng() % (PACKETTOOLARGE + 2);
+            args[offset + 1] = 0;
+            args[offset + 2] = rng() % 24;
+            offset += 3 + args[offset + 2];
+        }
+    }
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && atoi(argv[1]) == 0)
+    {
+        // a corpus, one packet per file
+        for (int i = 1; i < argc; i++)
+        {
+            uint8_t buffer[BTOAS_PACKET_SIZE * 2];
+            FILE *file = fopen(argv[i], "rb");
+            check(file != nullptr, "can't open input file");
+            size_t size = fread(buffer, 1, sizeof(buffer), file);
+            fclose(file);
+            LLVMFuzzerTestOneInput(buffer, size);
+        }
+        printf("fuzz_btoas: %i inputs ok\n", argc - 1);
+        return 0;
+    }
+
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    for (int i = 0; i < iterations; i++)
+    {
+        uint8_t buffer[BTOAS_PACKET_SIZE + 8];
+        size_t size = randomPacket(buffer, sizeof(buffer));
+        LLVMFuzzerTestOneInput(buffer, size);
+    }
+    printf("fuzz_btoas: %i random packets ok (%u)\n", iterations, sink);
+    return 0;
+}
+
+#endif
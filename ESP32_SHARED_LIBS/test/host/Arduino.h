@@ -0,0 +1,40 @@
+// Just enough of Arduino.h for the shared packet code to build on a pc, see ../CMakeLists.txt
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+
+#define HEX 16
+#define F(x) x
+#define log_i(...)
+
+class String
+{
+private:
+    std::string str;
+
+public:
+    String() {}
+    String(const char *cstr) : str(cstr) {}
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.length(); }
+};
+
+// output goes nowhere, the fuzzer would drown in it
+struct HostSerial
+{
+    template <typename... Args>
+    void print(Args...) {}
+    template <typename... Args>
+    void println(Args...) {}
+    template <typename... Args>
+    void printf(Args...) {}
+};
+static HostSerial Serial;
+
+#endif
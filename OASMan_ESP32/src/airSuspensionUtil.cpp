@@ -1,5 +1,6 @@
 #include "airSuspensionUtil.h"
 #include "manifoldSaveData.h"
+#include "i2cBus.h"
 
 #pragma region variables
 
@@ -72,6 +73,7 @@ void setRideHeightRearDriver(byte value)
 #if USE_ADS == true
 void initializeADS()
 {
+    i2cBusAcquire(I2C_PRIORITY_ADC);
     if (!ADS1115A.begin(ADS_A_ADDRESS))
     {
         Serial.println(F("Failed to initialize ADS A"));
@@ -88,6 +90,7 @@ void initializeADS()
 #endif
     }
 #endif
+    i2cBusRelease();
 }
 #endif
 
@@ -0,0 +1,332 @@
+#include "allowedDevices.h"
+#include "preferencable.h"
+#include <SPIFFS.h>
+
+#define ALLOWED_DEVICES_VERSION 1
+#define ALLOWED_DEVICES_OLD_FILE "/allowed_bt_devices.dat" // 20 macs and nothing else
+#define ALLOWED_DEVICES_OLD_COUNT 20
+#define ALLOWED_DEVICES_MAX_REMOVED (ALLOWED_DEVICES_SLOTS / 4) // past this the table gets rebuilt so missing macs don't probe forever
+
+enum AllowedSlotState
+{
+    ALLOWED_SLOT_EMPTY,
+    ALLOWED_SLOT_USED,
+    ALLOWED_SLOT_REMOVED, // lookups have to keep going past it
+};
+
+struct AllowedDevice
+{
+    uint8_t addr[6];
+    uint8_t state;      // AllowedSlotState
+    uint8_t mapProfile; // which set of gamepad bindings it gets, there's only the one for now
+    uint32_t lastSeen;  // seenCounter when it last connected
+    char name[ALLOWED_DEVICE_NAME_SIZE];
+};
+
+struct AllowedDevicesHeader
+{
+    uint8_t version;
+    uint8_t slots;
+    uint16_t reserved;
+};
+
+static AllowedDevice devices[ALLOWED_DEVICES_SLOTS];
+static int deviceCount = 0;
+static int removedCount = 0;
+static uint32_t seenCounter = 0; // goes up every connect, carries on from the highest saved one after a reboot
+static SemaphoreHandle_t allowedDevicesMutex;
+
+static uint32_t hashAddr(const uint8_t *addr)
+{
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++)
+    {
+        hash = (hash ^ addr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// slot with addr in it or -1. free gets the first slot it could go in
+static int findSlot(const uint8_t *addr, int *free)
+{
+    uint32_t slot = hashAddr(addr) & (ALLOWED_DEVICES_SLOTS - 1);
+    *free = -1;
+    for (int probe = 0; probe < ALLOWED_DEVICES_SLOTS; probe++)
+    {
+        AllowedDevice *device = &devices[slot];
+        if (device->state == ALLOWED_SLOT_EMPTY)
+        {
+            *free = *free < 0 ? slot : *free;
+            return -1;
+        }
+        if (device->state == ALLOWED_SLOT_REMOVED)
+        {
+            *free = *free < 0 ? slot : *free;
+        }
+        else if (memcmp(device->addr, addr, 6) == 0)
+        {
+            return slot;
+        }
+        slot = (slot + 1) & (ALLOWED_DEVICES_SLOTS - 1);
+    }
+    return -1;
+}
+
+#pragma region file
+
+static void writeAllowedDevicesFile()
+{
+    AllowedDevicesHeader header = {ALLOWED_DEVICES_VERSION, ALLOWED_DEVICES_SLOTS, 0};
+    File file = SPIFFS.open(ALLOWED_DEVICES_FILE, "w", true);
+    if (!file)
+    {
+        Serial.println("BP32: Failed to save allowed devices");
+        return;
+    }
+    file.write((const uint8_t *)&header, sizeof(header));
+    file.write((const uint8_t *)devices, sizeof(devices));
+    file.close();
+}
+
+// just the one slot, the rest of the file is already right
+static void writeAllowedDeviceSlot(int slot, const AllowedDevice *device)
+{
+    File file = SPIFFS.open(ALLOWED_DEVICES_FILE, "r+");
+    if (!file || file.size() != sizeof(AllowedDevicesHeader) + sizeof(devices))
+    {
+        if (file)
+        {
+            file.close();
+        }
+        writeAllowedDevicesFile(); // missing or cleared under us, start it over
+        return;
+    }
+    file.seek(sizeof(AllowedDevicesHeader) + slot * sizeof(AllowedDevice));
+    file.write((const uint8_t *)device, sizeof(AllowedDevice));
+    file.close();
+}
+
+static bool readAllowedDevicesFile()
+{
+    File file = SPIFFS.open(ALLOWED_DEVICES_FILE, "r");
+    if (!file)
+    {
+        return false;
+    }
+    AllowedDevicesHeader header;
+    bool valid = file.size() == sizeof(header) + sizeof(devices) &&
+                 file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                 header.version == ALLOWED_DEVICES_VERSION && header.slots == ALLOWED_DEVICES_SLOTS &&
+                 file.read((uint8_t *)devices, sizeof(devices)) == sizeof(devices);
+    file.close();
+    return valid;
+}
+
+#pragma endregion
+
+// puts everything back where it hashes to, with nothing removed in the way. Caller holds the mutex.
+// Returns true if anything moved, the file has to be rewritten then or single slot writes land in the wrong place
+static bool rebuildAllowedDevices()
+{
+    static AllowedDevice old[ALLOWED_DEVICES_SLOTS];
+    memcpy(old, devices, sizeof(devices));
+    memset(devices, 0, sizeof(devices));
+    deviceCount = 0;
+    removedCount = 0;
+    for (int i = 0; i < ALLOWED_DEVICES_SLOTS; i++)
+    {
+        int free;
+        if (old[i].state != ALLOWED_SLOT_USED || findSlot(old[i].addr, &free) >= 0 || free < 0 || deviceCount >= ALLOWED_DEVICES_MAX)
+        {
+            continue;
+        }
+        devices[free] = old[i];
+        deviceCount++;
+        seenCounter = old[i].lastSeen > seenCounter ? old[i].lastSeen : seenCounter;
+    }
+    return memcmp(old, devices, sizeof(devices)) != 0;
+}
+
+// the 20 mac list from before there was a table
+static void importOldAllowedDevices()
+{
+    uint8_t old[ALLOWED_DEVICES_OLD_COUNT][6];
+    memset(old, 0, sizeof(old));
+    size_t size = readBytes(ALLOWED_DEVICES_OLD_FILE, old, sizeof(old));
+    if (size == 0 || size > sizeof(old))
+    {
+        return;
+    }
+    const uint8_t none[6] = {0};
+    for (int i = 0; i < ALLOWED_DEVICES_OLD_COUNT; i++)
+    {
+        int free;
+        if (memcmp(old[i], none, 6) == 0 || findSlot(old[i], &free) >= 0 || free < 0)
+        {
+            continue;
+        }
+        memcpy(devices[free].addr, old[i], 6);
+        devices[free].state = ALLOWED_SLOT_USED;
+        devices[free].lastSeen = ++seenCounter; // same order they were added in
+        deviceCount++;
+    }
+    Serial.printf("BP32: Brought over %i allowed devices from the old list\n", deviceCount);
+    writeAllowedDevicesFile();
+    deleteFile(ALLOWED_DEVICES_OLD_FILE);
+}
+
+void loadAllowedDevices()
+{
+    if (allowedDevicesMutex == nullptr)
+    {
+        allowedDevicesMutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(allowedDevicesMutex, portMAX_DELAY);
+    seenCounter = 0;
+    if (readAllowedDevicesFile())
+    {
+        // cheap, and clears out whatever got removed last time
+        if (rebuildAllowedDevices())
+        {
+            writeAllowedDevicesFile(); // otherwise a removed device could still be allowed in the old layout after the next reboot
+        }
+    }
+    else
+    {
+        memset(devices, 0, sizeof(devices));
+        deviceCount = 0;
+        removedCount = 0;
+        importOldAllowedDevices();
+    }
+    Serial.printf("BP32: %i allowed devices\n", deviceCount);
+    xSemaphoreGive(allowedDevicesMutex);
+}
+
+bool allowedDeviceFind(const uint8_t *addr)
+{
+    if (allowedDevicesMutex == nullptr)
+    {
+        return false; // not loaded yet
+    }
+    int free;
+    xSemaphoreTake(allowedDevicesMutex, portMAX_DELAY);
+    bool found = findSlot(addr, &free) >= 0;
+    xSemaphoreGive(allowedDevicesMutex);
+    return found;
+}
+
+void allowedDeviceAdd(const uint8_t *addr)
+{
+    if (allowedDevicesMutex == nullptr)
+    {
+        return;
+    }
+    int free;
+    int evicted = -1;
+    AllowedDevice evictedDevice;
+    AllowedDevice added;
+    xSemaphoreTake(allowedDevicesMutex, portMAX_DELAY);
+    if (findSlot(addr, &free) >= 0)
+    {
+        xSemaphoreGive(allowedDevicesMutex);
+        return;
+    }
+    if (deviceCount >= ALLOWED_DEVICES_MAX)
+    {
+        // full, whichever connected longest ago goes. Only happens on a new pairing so going through them all is fine
+        for (int i = 0; i < ALLOWED_DEVICES_SLOTS; i++)
+        {
+            if (devices[i].state == ALLOWED_SLOT_USED && (evicted < 0 || devices[i].lastSeen < devices[evicted].lastSeen))
+            {
+                evicted = i;
+            }
+        }
+        Serial.printf("BP32: Allowed devices full, dropping %02x:%02x:%02x:%02x:%02x:%02x\n", devices[evicted].addr[0], devices[evicted].addr[1],
+                      devices[evicted].addr[2], devices[evicted].addr[3], devices[evicted].addr[4], devices[evicted].addr[5]);
+        devices[evicted].state = ALLOWED_SLOT_REMOVED;
+        evictedDevice = devices[evicted];
+        deviceCount--;
+        removedCount++;
+        findSlot(addr, &free);
+    }
+    if (free < 0)
+    {
+        xSemaphoreGive(allowedDevicesMutex);
+        return; // can't happen with removed ones capped below the spare slots, but don't write off the end if it does
+    }
+
+    bool rebuilt = false;
+    if (devices[free].state == ALLOWED_SLOT_REMOVED)
+    {
+        removedCount--;
+    }
+    memset(&devices[free], 0, sizeof(AllowedDevice));
+    memcpy(devices[free].addr, addr, 6);
+    devices[free].state = ALLOWED_SLOT_USED;
+    devices[free].lastSeen = ++seenCounter;
+    deviceCount++;
+    added = devices[free];
+    if (removedCount > ALLOWED_DEVICES_MAX_REMOVED)
+    {
+        rebuildAllowedDevices();
+        rebuilt = true;
+    }
+    xSemaphoreGive(allowedDevicesMutex);
+
+    // spiffs is slow, nobody waits on the lock for it. Only this task adds, so the slots can't move in the meantime
+    if (rebuilt)
+    {
+        writeAllowedDevicesFile();
+        return;
+    }
+    if (evicted >= 0 && evicted != free)
+    {
+        writeAllowedDeviceSlot(evicted, &evictedDevice);
+    }
+    writeAllowedDeviceSlot(free, &added);
+}
+
+void allowedDeviceSeen(const uint8_t *addr, const char *name)
+{
+    if (allowedDevicesMutex == nullptr)
+    {
+        return;
+    }
+    int free;
+    AllowedDevice device;
+    xSemaphoreTake(allowedDevicesMutex, portMAX_DELAY);
+    int slot = findSlot(addr, &free);
+    if (slot >= 0)
+    {
+        devices[slot].lastSeen = ++seenCounter;
+        strncpy(devices[slot].name, name, ALLOWED_DEVICE_NAME_SIZE - 1);
+        devices[slot].name[ALLOWED_DEVICE_NAME_SIZE - 1] = 0;
+        device = devices[slot];
+    }
+    xSemaphoreGive(allowedDevicesMutex);
+    if (slot >= 0)
+    {
+        writeAllowedDeviceSlot(slot, &device);
+    }
+}
+
+void clearAllowedDevices()
+{
+    if (allowedDevicesMutex == nullptr)
+    {
+        return;
+    }
+    xSemaphoreTake(allowedDevicesMutex, portMAX_DELAY);
+    memset(devices, 0, sizeof(devices));
+    deviceCount = 0;
+    removedCount = 0;
+    seenCounter = 0;
+    xSemaphoreGive(allowedDevicesMutex);
+    deleteFile(ALLOWED_DEVICES_FILE);
+}
+
+int allowedDeviceCount()
+{
+    return deviceCount;
+}
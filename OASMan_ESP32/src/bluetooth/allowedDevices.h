@@ -0,0 +1,22 @@
+#ifndef allowedDevices_h
+#define allowedDevices_h
+
+#include <Arduino.h>
+
+// Gamepads that have been paired and are allowed back in. Kept as an open addressed hash table on the mac so every check
+// in the connection path is a lookup or two, and the file is that same table so a change only rewrites the one slot.
+// When it's full the one that connected longest ago gets dropped to make room.
+
+#define ALLOWED_DEVICES_FILE "/allowed_gamepads.dat"
+#define ALLOWED_DEVICES_MAX 40    // devices
+#define ALLOWED_DEVICES_SLOTS 64  // power of 2, has to stay well above max or the probes get long
+#define ALLOWED_DEVICE_NAME_SIZE 24
+
+void loadAllowedDevices(); // also brings over the old list of 20 macs if that's all there is
+bool allowedDeviceFind(const uint8_t *addr);
+void allowedDeviceAdd(const uint8_t *addr);                     // makes room if it has to
+void allowedDeviceSeen(const uint8_t *addr, const char *name);  // connected just now, for picking what to drop
+void clearAllowedDevices();
+int allowedDeviceCount();
+
+#endif
@@ -1,81 +1,156 @@
 #include "ble.h"
+#include "bootProfiler.h"
+#include "telemetry.h"
+#include "rawStream.h"
+#include "valvePulse.h"
+#include "bulkTransfer.h"
+#include "linkBenchmark.h"
+#include "gamepadMap.h"
 
 #define ble2_new
 #ifdef ble2_new
 
+// Connection tracking
+const int MAX_CONNECTIONS = 5;
+
 #pragma region bluetooth packet mover util
 
+void kickNotifyScheduler();
+
+// each connection gets its own queue so one client asking for a bunch of stuff can't push out the replies for another client,
+// and so the notify scheduler can pull the next packet for whichever connection just got buffer space
+#define REST_QUEUE_SIZE 16
+
 namespace packetMover
 {
-
-#define BTOASPACKETCOUNT 10
     struct PacketEntry
     {
-        bool taken;
         hci_con_handle_t con_handle;
         BTOasPacket packet;
     };
-    PacketEntry packets[BTOASPACKETCOUNT];
-    static SemaphoreHandle_t restMutex;
-    void setupRestSemaphore()
+
+    PacketQueue<PacketEntry, REST_QUEUE_SIZE> queues[MAX_CONNECTIONS];
+    hci_con_handle_t queueOwners[MAX_CONNECTIONS];
+    uint32_t noQueueDrops = 0; // packets dropped because the connection didn't have a queue (gone, or there wasn't one free)
+    static portMUX_TYPE ownerMux = portMUX_INITIALIZER_UNLOCKED;
+
+    void setupRestQueues()
     {
-        restMutex = xSemaphoreCreateMutex();
-        memset(packets, 0, sizeof(packets));
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            queueOwners[i] = HCI_CON_HANDLE_INVALID;
+            queues[i].clear();
+        }
+    }
+
+    // finds the queue for this connection, nullptr if it doesn't have one
+    PacketQueue<PacketEntry, REST_QUEUE_SIZE> *getQueue(hci_con_handle_t con_handle)
+    {
+        int found = -1;
+        portENTER_CRITICAL_SAFE(&ownerMux);
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            if (queueOwners[i] == con_handle)
+            {
+                found = i;
+                break;
+            }
+        }
+        portEXIT_CRITICAL_SAFE(&ownerMux);
+        return found == -1 ? nullptr : &queues[found];
     }
-    void waitRestSemaphore()
+
+    // call on connect, from the btstack thread. Only connect and disconnect change owners, so a send to a handle that
+    // just went away can't take a queue nobody will ever give back
+    bool claimQueue(hci_con_handle_t con_handle)
     {
-        while (xSemaphoreTake(restMutex, 1) != pdTRUE)
+        bool claimed = false;
+        portENTER_CRITICAL_SAFE(&ownerMux);
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
         {
-            delay(1);
+            if (queueOwners[i] == HCI_CON_HANDLE_INVALID)
+            {
+                queues[i].clear();
+                queueOwners[i] = con_handle;
+                claimed = true;
+                break;
+            }
         }
+        portEXIT_CRITICAL_SAFE(&ownerMux);
+        return claimed;
     }
-    void giveRestSemaphore()
+
+    // call on disconnect, from the btstack thread, so the queue can be used by the next connection
+    void releaseQueue(hci_con_handle_t con_handle)
     {
-        xSemaphoreGive(restMutex);
+        portENTER_CRITICAL_SAFE(&ownerMux);
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            if (queueOwners[i] == con_handle)
+            {
+                queues[i].clear();
+                queueOwners[i] = HCI_CON_HANDLE_INVALID;
+            }
+        }
+        portEXIT_CRITICAL_SAFE(&ownerMux);
     }
 
     void clearPackets()
     {
-        waitRestSemaphore();
-        for (int i = 0; i < BTOASPACKETCOUNT; i++)
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
         {
-            packets[i].taken = false;
+            queues[i].clear();
         }
-        giveRestSemaphore();
     }
 
-    bool getBTRestPacketToSend(BTOasPacket *copyTo, hci_con_handle_t &con_handle)
+    bool hasPacketFor(hci_con_handle_t con_handle)
+    {
+        PacketQueue<PacketEntry, REST_QUEUE_SIZE> *queue = getQueue(con_handle);
+        return queue != nullptr && !queue->isEmpty();
+    }
+
+    bool getBTRestPacketToSend(BTOasPacket *copyTo, hci_con_handle_t con_handle)
     {
-        bool ret = false;
-        waitRestSemaphore();
-        for (int i = 0; i < BTOASPACKETCOUNT; i++)
+        PacketQueue<PacketEntry, REST_QUEUE_SIZE> *queue = getQueue(con_handle);
+        PacketEntry entry;
+        while (queue != nullptr && queue->pop(&entry))
         {
-            if (packets[i].taken)
+            // a send that raced the last owner's disconnect can leave one of theirs behind, that's not for this client
+            if (entry.con_handle == con_handle)
             {
-                packets[i].taken = false;
-                con_handle = packets[i].con_handle;
-                memcpy(copyTo, &packets[i].packet, BTOAS_PACKET_SIZE);
-                ret = true;
-                break;
+                memcpy(copyTo, &entry.packet, BTOAS_PACKET_SIZE);
+                return true;
             }
         }
-        giveRestSemaphore();
-        return ret;
+        return false;
     }
+
+    // safe to call from the att callbacks, never blocks
     void sendRestPacket(BTOasPacket *packet, hci_con_handle_t con_handle)
     {
-        waitRestSemaphore();
-        for (int i = 0; i < BTOASPACKETCOUNT; i++)
+        PacketQueue<PacketEntry, REST_QUEUE_SIZE> *queue = getQueue(con_handle);
+        if (queue == nullptr)
         {
-            if (!packets[i].taken)
-            {
-                packets[i].taken = true;
-                memcpy(&packets[i].packet, packet, BTOAS_PACKET_SIZE);
-                packets[i].con_handle = con_handle;
-                break;
-            }
+            noQueueDrops++;
+            return;
+        }
+        PacketEntry entry;
+        entry.con_handle = con_handle;
+        memcpy(&entry.packet, packet, BTOAS_PACKET_SIZE);
+        if (queue->push(entry))
+        {
+            kickNotifyScheduler();
+        }
+    }
+
+    uint32_t getOverflowCount()
+    {
+        uint32_t total = noQueueDrops;
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            total += queues[i].getOverflowCount();
         }
-        giveRestSemaphore();
+        return total;
     }
 
 };
@@ -84,8 +159,6 @@ namespace packetMover
 
 // Based on this file: https://github.com/mo-thunderz/Esp32BlePart2/blob/main/Arduino/BLE_server_2characteristics/BLE_server_2characteristics.ino
 
-void ble_notify();
-
 // Service and characteristic handles
 const static uint16_t status_characteristic_value_handle = ATT_CHARACTERISTIC_66fda100_8972_4ec7_971c_3fd30b3072ac_01_VALUE_HANDLE;
 const static uint16_t status_characteristic_client_configuration_handle = ATT_CHARACTERISTIC_66fda100_8972_4ec7_971c_3fd30b3072ac_01_CLIENT_CONFIGURATION_HANDLE;
@@ -96,240 +169,810 @@ const static uint16_t rest_characteristic_client_configuration_handle = ATT_CHAR
 const static uint16_t valve_control_characteristic_value_handle = ATT_CHARACTERISTIC_e225a15a_e816_4e9d_99b7_c384f91f273b_01_VALUE_HANDLE;
 const static uint16_t valve_control_characteristic_client_configuration_handle = ATT_CHARACTERISTIC_e225a15a_e816_4e9d_99b7_c384f91f273b_01_CLIENT_CONFIGURATION_HANDLE;
 
+const static uint16_t raw_stream_characteristic_value_handle = ATT_CHARACTERISTIC_4d8b3e6a_52c1_4f0e_a7d9_1c6b2e8f9a34_01_VALUE_HANDLE;
+const static uint16_t raw_stream_characteristic_client_configuration_handle = ATT_CHARACTERISTIC_4d8b3e6a_52c1_4f0e_a7d9_1c6b2e8f9a34_01_CLIENT_CONFIGURATION_HANDLE;
+
+const static uint16_t bulk_characteristic_value_handle = ATT_CHARACTERISTIC_9c3e5b71_2d4a_4f86_b0e3_7a1f6c2d8e45_01_VALUE_HANDLE;
+const static uint16_t bulk_characteristic_client_configuration_handle = ATT_CHARACTERISTIC_9c3e5b71_2d4a_4f86_b0e3_7a1f6c2d8e45_01_CLIENT_CONFIGURATION_HANDLE;
+
 // General Discoverable = 0x02
 // BR/EDR Not supported = 0x04
 #define APP_AD_FLAGS 0x06
 
-// Connection tracking
-const int MAX_CONNECTIONS = 5;
-
 uint64_t currentUserNum = 1;
 
 // Characteristic data buffers
 static uint8_t status_characteristic_data[BTOAS_PACKET_SIZE];
+static uint16_t status_characteristic_length = BTOAS_PACKET_SIZE; // compact length of the current status packet
 static uint8_t rest_characteristic_data[BTOAS_PACKET_SIZE];
 static uint8_t valve_control_characteristic_data[4]; // 32-bit value
+static uint8_t raw_stream_characteristic_data[RAWSTREAM_MAX_BATCH_SIZE]; // last batch sent out
+static uint16_t raw_stream_characteristic_length = 0;
+static uint8_t bulk_characteristic_data[BULK_MAX_NOTIFY_SIZE]; // last chunk sent out
+static uint16_t bulk_characteristic_length = 0;
 
-std::set<hci_con_handle_t> authedClients;
-bool isAuthed(hci_con_handle_t conn_id)
+#pragma region connection table
+// Everything we keep per connection lives in one fixed table indexed by slot, so nothing gets allocated in the btstack callbacks.
+// Slots are claimed on connect and released on disconnect, all on the btstack thread. Other tasks only ever read it.
+
+#define AUTH_TIMEOUT 5000
+
+// what clients get until they send a StatusRatePacket, same as it always was: every 250ms no matter what
+#define STATUS_DEFAULT_INTERVAL_MS 250
+#define STATUS_DEFAULT_DELTA_PSI 0
+#define STATUS_DEFAULT_HEARTBEAT_MS 250
+
+struct Connection
+{
+    hci_con_handle_t handle; // HCI_CON_HANDLE_INVALID when the slot is free
+    bd_addr_t addr;
+    unsigned long connectTime;
+    bool authed;
+    bool authTimeoutChecked;
+    uint16_t mtu;
+
+    // stats, logged when it disconnects
+    uint32_t packetsReceived;
+    uint32_t packetsSent;
+    uint32_t bytesSent;
+
+    bool waitingForCanSend; // already asked btstack, don't ask again until the event comes
+    bool statusPending;
+    bool compact; // client said it supports BTOAS_CAP_COMPACT
+    uint16_t statusIntervalMS;
+    uint16_t statusDeltaPSI;
+    uint16_t statusHeartbeatMS;
+    unsigned long lastStatusTime;
+    StatusFields lastStatus; // what it looked like when we decided to send the last one, for the delta check
+
+    // BTOAS_CAP_STATUS_DELTA clients
+    bool statusDelta;
+    bool keyframeNeeded;
+    unsigned long lastKeyframeTime;
+    uint8_t deltaSequence;
+    StatusFields deltaBase; // what the client has, deltas are against this
+
+    // subscribed to the raw stream characteristic
+    bool rawStream;
+    uint16_t rawStreamSequence; // next batch this client gets
+
+    // connection parameters
+    BLELinkProfile linkProfile; // what we last asked for
+    uint16_t connInterval;      // what we actually got, 1.25ms units
+    uint16_t connLatency;
+    uint16_t supervisionTimeout; // 10ms units
+
+    // link benchmark, streaming filler until throughputEndTime
+    bool throughputActive;
+    unsigned long throughputEndTime;
+    uint16_t throughputSequence;
+    uint32_t throughputBytes;
+};
+static Connection connections[MAX_CONNECTIONS];
+
+void setupConnections()
 {
-    return std::find(authedClients.begin(), authedClients.end(), conn_id) != authedClients.end();
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        connections[i].handle = HCI_CON_HANDLE_INVALID;
+    }
 }
-void addAuthed(hci_con_handle_t conn_id)
+
+Connection *getConnection(hci_con_handle_t handle, bool claim)
 {
-    authedClients.insert(conn_id);
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        if (connections[i].handle == handle)
+        {
+            return &connections[i];
+        }
+    }
+    if (claim)
+    {
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            if (connections[i].handle == HCI_CON_HANDLE_INVALID)
+            {
+                Connection *conn = &connections[i];
+                memset(conn, 0, sizeof(Connection));
+                conn->handle = handle;
+                conn->connectTime = millis();
+                conn->mtu = ATT_DEFAULT_MTU;
+                conn->statusIntervalMS = STATUS_DEFAULT_INTERVAL_MS;
+                conn->statusDeltaPSI = STATUS_DEFAULT_DELTA_PSI;
+                conn->statusHeartbeatMS = STATUS_DEFAULT_HEARTBEAT_MS;
+                conn->keyframeNeeded = true;
+                conn->linkProfile = BLE_LINK_FAST;
+                return conn;
+            }
+        }
+    }
+    return nullptr;
 }
 
-// code for checking if a client auth times out
-struct ClientTime
+bool isAuthed(hci_con_handle_t conn_id)
 {
-    uint16_t conn_id;
-    bd_addr_t addr;
-    unsigned long connectTime;
-};
-std::vector<ClientTime> connectedClientTimer;
-void addConnectedClient(ClientTime cl)
+    Connection *conn = getConnection(conn_id, false);
+    return conn != nullptr && conn->authed;
+}
+void addAuthed(hci_con_handle_t conn_id)
+{
+    Connection *conn = getConnection(conn_id, false);
+    if (conn != nullptr)
+    {
+        conn->authed = true;
+    }
+}
+int getAuthedCount()
 {
-    connectedClientTimer.push_back(cl);
+    int count = 0;
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        if (connections[i].handle != HCI_CON_HANDLE_INVALID && connections[i].authed)
+        {
+            count++;
+        }
+    }
+    return count;
 }
 
-#define AUTH_TIMEOUT 5000
+// code for checking if a client auth times out
 void checkConnectedClients()
 {
     unsigned long curtime = millis();
-
-    std::vector<ClientTime>::iterator iter;
-    for (iter = connectedClientTimer.begin(); iter != connectedClientTimer.end();)
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
     {
-        if ((*iter).connectTime + AUTH_TIMEOUT < curtime)
+        Connection *conn = &connections[i];
+        if (conn->handle == HCI_CON_HANDLE_INVALID || conn->authed || conn->authTimeoutChecked || curtime - conn->connectTime < AUTH_TIMEOUT)
         {
-            // check for authed
-            if (!isAuthed((*iter).conn_id))
-            {
-                // not authed, go ahead and disconnect
-                log_i("Client auth timed out... disconnecting: %i", (*iter).conn_id);
-
-                if (!isBTDeviceARegisteredController((*iter).addr))
-                {
-                    gap_disconnect((*iter).conn_id);
-                }
-                else
-                {
-                    log_i("Client is a registered controller, not disconnecting: %s", bd_addr_to_str((*iter).addr));
-                }
-            }
-            // remove
-            iter = connectedClientTimer.erase(iter);
+            continue;
+        }
+        conn->authTimeoutChecked = true;
+        // not authed, go ahead and disconnect
+        log_i("Client auth timed out... disconnecting: %i", conn->handle);
+        if (!isBTDeviceARegisteredController(conn->addr))
+        {
+            gap_disconnect(conn->handle);
         }
         else
         {
-            ++iter;
+            log_i("Client is a registered controller, not disconnecting: %s", bd_addr_to_str(conn->addr));
+        }
+    }
+}
+
+// the sampler only runs while somebody is listening
+void updateRawStreamSubscribers()
+{
+    int count = 0;
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        if (connections[i].handle != HCI_CON_HANDLE_INVALID && connections[i].rawStream)
+        {
+            count++;
         }
     }
+    rawStreamSetSubscribers(count);
 }
 
-void removeAuthed(hci_con_handle_t conn_id)
+void releaseConnection(hci_con_handle_t handle)
 {
-    auto index = std::find(authedClients.begin(), authedClients.end(), conn_id);
-    while (index != authedClients.end())
+    Connection *conn = getConnection(handle, false);
+    if (conn != nullptr)
     {
-        log_i("Removing auth from client: %i", conn_id);
-        authedClients.erase(index);
-        index = std::find(authedClients.begin(), authedClients.end(), conn_id);
+        log_i("Client %i was connected for %lus, %u packets in, %u packets (%u bytes) out", handle, (millis() - conn->connectTime) / 1000, conn->packetsReceived, conn->packetsSent, conn->bytesSent);
+        conn->handle = HCI_CON_HANDLE_INVALID;
+        updateRawStreamSubscribers();
     }
+}
+#pragma endregion
+
+extern uint8_t AIReadyBittset; // 4
+extern uint8_t AIPercentage;   // 7
+
+#pragma region notify scheduler
 
-    // now remove it from the security check part
-    std::vector<ClientTime>::iterator iter;
-    for (iter = connectedClientTimer.begin(); iter != connectedClientTimer.end();)
+// Everything that gets sent out goes through here. Instead of sleeping until btstack has room, we ask it for a ATT_EVENT_CAN_SEND_NOW
+// for each connection that has something waiting and send exactly one packet per event. Each connection gets its own events so clients take turns.
+// All of this runs on the btstack thread, other tasks just call kickNotifyScheduler().
+
+#define NOTIFY_TICK_MS 25
+#define STATUS_MAX_RATE_HZ 20
+
+#define STATUS_KEYFRAME_MS 5000 // delta clients get a full one this often in case they missed something
+
+static btstack_timer_source_t notifyTimer;
+static btstack_context_callback_registration_t notifyKick;
+static std::atomic<bool> notifyKickPending(false);
+
+void setRawStreamSubscribed(hci_con_handle_t handle, bool subscribed)
+{
+    Connection *conn = getConnection(handle, true);
+    if (conn == nullptr)
     {
+        return;
+    }
+    conn->rawStream = subscribed;
+    conn->rawStreamSequence = rawStreamNextSequence(); // start with the next one, nothing old
+    updateRawStreamSubscribers();
+    log_i("Client %i raw stream %s", handle, subscribed ? "on" : "off");
+}
+
+bool hasRawStreamBatch(Connection *conn)
+{
+    return conn->rawStream && conn->authed && conn->rawStreamSequence != rawStreamNextSequence();
+}
+
+// chunks are as big as the mtu lets them be
+uint16_t bulkNotifySize(Connection *conn)
+{
+    uint16_t maxLength = conn->mtu - 3;
+    return maxLength > BULK_MAX_NOTIFY_SIZE ? BULK_MAX_NOTIFY_SIZE : maxLength;
+}
+
+bool hasBulkChunk(Connection *conn)
+{
+    return conn->authed && bulkHasChunk(conn->handle, bulkNotifySize(conn));
+}
 
-        if ((*iter).conn_id == conn_id)
+// ask btstack for a can send now event for every connection that has something to send
+void runNotifyScheduler()
+{
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        Connection *conn = &connections[i];
+        if (conn->handle == HCI_CON_HANDLE_INVALID || conn->waitingForCanSend)
         {
-            iter = connectedClientTimer.erase(iter);
+            continue;
         }
-        else
+        if (conn->statusPending || packetMover::hasPacketFor(conn->handle) || hasRawStreamBatch(conn) || hasBulkChunk(conn) || conn->throughputActive)
         {
-            ++iter;
+            conn->waitingForCanSend = true;
+            att_server_request_can_send_now_event(conn->handle);
         }
     }
 }
 
-// ATT read callback
-static uint16_t att_read_callback(hci_con_handle_t con_handle, uint16_t att_handle, uint16_t offset, uint8_t *buffer, uint16_t buffer_size)
+// every notify goes through here so the stats add up
+bool sendNotify(Connection *conn, uint16_t attribute_handle, const uint8_t *value, uint16_t length)
 {
-    if (att_handle == status_characteristic_value_handle)
+    if (att_server_notify(conn->handle, attribute_handle, value, length) != ERROR_CODE_SUCCESS)
     {
-        return att_read_callback_handle_blob(status_characteristic_data, sizeof(status_characteristic_data), offset, buffer, buffer_size);
+        return false;
     }
-    if (att_handle == rest_characteristic_value_handle)
+    conn->packetsSent++;
+    conn->bytesSent += length < conn->mtu - 3 ? length : conn->mtu - 3;
+    return true;
+}
+
+// if the mtu never got raised from 23 only 20 bytes fit. Trailing 0's can always be left off since the other side fills them back in,
+// which covers status and the short replies. Anything still too big is never sent cut off, it would decode as the wrong values.
+// A rest reply gets swapped for a TooLargePacket so the client stops waiting on it
+void notifyPacket(Connection *conn, uint16_t attribute_handle, const uint8_t *value, uint16_t length)
+{
+    uint16_t maxLength = conn->mtu - 3;
+    if (length <= maxLength)
     {
-        return att_read_callback_handle_blob(rest_characteristic_data, sizeof(rest_characteristic_data), offset, buffer, buffer_size);
+        sendNotify(conn, attribute_handle, value, length);
+        return;
     }
-    if (att_handle == valve_control_characteristic_value_handle)
+    BTOasPacket packet;
+    packet.rx(value, length);
+    length = packet.trimmedLength(length);
+    if (length <= maxLength)
     {
-        return att_read_callback_handle_blob(valve_control_characteristic_data, sizeof(valve_control_characteristic_data), offset, buffer, buffer_size);
+        sendNotify(conn, attribute_handle, packet.tx(), length);
+        return;
     }
-    if (att_handle == status_characteristic_client_configuration_handle)
+    log_i("Packet %i is %i bytes but mtu only allows %i, not sending it", packet.cmd, length, maxLength);
+    if (attribute_handle == rest_characteristic_value_handle)
     {
-        return 1; // att_read_callback_handle_little_endian_16(status_characteristic_client_configuration[con_handle], offset, buffer, buffer_size);
+        TooLargePacket tooLarge(packet.cmd, length, conn->mtu);
+        tooLarge.requestId = packet.requestId;
+        sendNotify(conn, attribute_handle, tooLarge.tx(), tooLarge.txLength(true));
     }
-    if (att_handle == rest_characteristic_client_configuration_handle)
+}
+
+// Only the fields that changed since the last one this client got. The link layer retransmits until the other side has it,
+// so once btstack takes the notify we count it as received. If the link drops the client starts over with a keyframe anyways
+void sendStatusDelta(Connection *conn)
+{
+    unsigned long now = millis();
+    bool keyframe = conn->keyframeNeeded || now - conn->lastKeyframeTime >= STATUS_KEYFRAME_MS;
+    StatusFields current;
+    memcpy(&current, &status_characteristic_data[BTOAS_HEADER_SIZE], sizeof(StatusFields));
+
+    StatusDeltaPacket pkt(&current, keyframe ? nullptr : &conn->deltaBase, conn->deltaSequence);
+    if (sendNotify(conn, status_characteristic_value_handle, pkt.tx(), pkt.txLength(true)))
     {
-        return 1; // att_read_callback_handle_little_endian_16(rest_characteristic_client_configuration[con_handle], offset, buffer, buffer_size);
+        conn->deltaBase = current;
+        conn->deltaSequence++;
+        if (keyframe)
+        {
+            conn->keyframeNeeded = false;
+            conn->lastKeyframeTime = now;
+        }
     }
-    if (att_handle == valve_control_characteristic_client_configuration_handle)
+}
+
+void startThroughput(Connection *conn, uint32_t durationMS)
+{
+    if (durationMS > PING_THROUGHPUT_MAX_MS)
     {
-        return 1; // att_read_callback_handle_little_endian_16(valve_control_characteristic_client_configuration[con_handle], offset, buffer, buffer_size);
+        durationMS = PING_THROUGHPUT_MAX_MS;
     }
-    return 0;
+    conn->throughputActive = true;
+    conn->throughputEndTime = millis() + durationMS;
+    conn->throughputSequence = 0;
+    conn->throughputBytes = 0;
+    log_i("Throughput test to %i for %ums", conn->handle, durationMS);
+    runNotifyScheduler();
 }
 
-void runReceivedPacket(hci_con_handle_t con_handle, BTOasPacket *packet);
-
-// ATT write callback
-static int att_write_callback(hci_con_handle_t con_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size)
+// one full size filler packet, or the done packet once the time is up. Goes out on the rest characteristic so it's
+// measuring the same path as everything else
+void sendThroughputFiller(Connection *conn)
 {
-    static unsigned int valveTableValues = 0;
+    if ((long)(millis() - conn->throughputEndTime) >= 0)
+    {
+        conn->throughputActive = false;
+        PingPacket done(PINGCMD_THROUGHPUT_DONE, conn->throughputSequence, conn->throughputSequence);
+        done.setBytes(conn->throughputBytes);
+        packetMover::sendRestPacket(&done, conn->handle);
+        Serial.printf("BENCH SENT %u packets %u bytes to %i\n", conn->throughputSequence, conn->throughputBytes, conn->handle);
+        return;
+    }
+    PingPacket filler(PINGCMD_FILLER, conn->throughputSequence);
+    filler.setSenderTime(micros());
+    filler.fill();
+    memcpy(rest_characteristic_data, filler.tx(), BTOAS_PACKET_SIZE);
+    uint16_t length = filler.txLength(conn->compact);
+    if (sendNotify(conn, rest_characteristic_value_handle, rest_characteristic_data, length))
+    {
+        conn->throughputSequence++;
+        conn->throughputBytes += length < conn->mtu - 3 ? length : conn->mtu - 3;
+    }
+}
 
-    if (att_handle == rest_characteristic_value_handle)
+// ATT_EVENT_CAN_SEND_NOW for one connection. Rest replies go first since somebody is waiting on them, then status, then the raw stream, then bulk transfers with whatever is left
+void handleCanSendNow(hci_con_handle_t handle)
+{
+    Connection *conn = getConnection(handle, false);
+    if (conn == nullptr)
     {
+        return;
+    }
+    conn->waitingForCanSend = false;
 
-        Serial.println("Received rest command");
-        BTOasPacket *packet = (BTOasPacket *)buffer;
-        packet->dump();
-        if (isAuthed(con_handle))
+    BTOasPacket packet;
+    if (packetMover::getBTRestPacketToSend(&packet, handle))
+    {
+        if (packet.cmd == PINGPKT && ((PingPacket *)&packet)->getCommand() == PINGCMD_PING)
         {
-            runReceivedPacket(con_handle, packet);
+            ((PingPacket *)&packet)->setSenderTime(micros()); // stamped as late as possible so time sitting in the queue doesn't count
         }
-
-        // Authed thing on connect
-        if (packet->cmd == BTOasIdentifier::AUTHPACKET)
+        memcpy(rest_characteristic_data, packet.tx(), BTOAS_PACKET_SIZE);
+        notifyPacket(conn, rest_characteristic_value_handle, rest_characteristic_data, packet.txLength(conn->compact));
+    }
+    else if (conn->statusPending)
+    {
+        conn->statusPending = false;
+        // a keyframe is 3 bytes bigger than a plain status, past what a 23 byte mtu holds. The client takes plain status either way
+        if (conn->statusDelta && conn->mtu - 3 >= BTOAS_HEADER_SIZE + STATUSDELTA_FIELDS_START + sizeof(StatusFields))
         {
-            AuthPacket *ap = ((AuthPacket *)packet);
-            if (ap->getBleAuthResult() == AuthResult::AUTHRESULT_WAITING)
-            {
-                // AUTH REQUEST
-                if (ap->getBlePasskey() == getblePasskey())
-                {
-                    ap->setBleAuthResult(AuthResult::AUTHRESULT_SUCCESS);
-                    addAuthed(con_handle);
-                }
-                else
-                {
-                    ap->setBleAuthResult(AuthResult::AUTHRESULT_FAIL);
-                }
-                packetMover::sendRestPacket(ap, con_handle);
-                //  memcpy(rest_characteristic_data, ap->tx(), BTOAS_PACKET_SIZE);
-                //  att_server_notify_SAFE(con_handle, rest_characteristic_value_handle, rest_characteristic_data, BTOAS_PACKET_SIZE);
-            }
+            sendStatusDelta(conn);
+        }
+        else
+        {
+            notifyPacket(conn, status_characteristic_value_handle, status_characteristic_data, conn->compact ? status_characteristic_length : BTOAS_PACKET_SIZE);
         }
-        return 0;
     }
-
-    if (att_handle == valve_control_characteristic_value_handle)
+    else if (hasRawStreamBatch(conn))
     {
-
-        // for some reason some devices send less than the 4 bytes required for this (notably, only 1 byte gets sent from the mobile app). So this little trick gets us into a 4 byte buffer safely
-        uint8_t valveControlBittsetArr[4] = {0};
-        memcpy(valveControlBittsetArr, buffer, buffer_size > 3 ? 4 : buffer_size);
-
-        if (isAuthed(con_handle))
+        uint16_t length = rawStreamRead(conn->rawStreamSequence, raw_stream_characteristic_data);
+        if (length > 0)
         {
-            unsigned int valveControlBittset = *(unsigned int *)&valveControlBittsetArr; // little_endian_read_32(buffer, 0);
-            Serial.printf("Value received for valve: %i\n", valveControlBittset);
-
-            for (int i = 0; i < 8; i++)
-            {
-                bool prevVal = (valveTableValues >> i) & 1;
-                bool curVal = (valveControlBittset >> i) & 1;
-                if (prevVal != curVal)
-                {
-                    if (curVal)
-                    {
-                        Serial.print("Opening ");
-                        Serial.println(i);
-                        getManifold()->get(i)->open();
-                    }
-                    else
-                    {
-                        Serial.print("Closing ");
-                        Serial.println(i);
-                        getManifold()->get(i)->close();
-                    }
-                }
-            }
-            valveTableValues = valveControlBittset;
+            // not going through notifyPacket, a batch cut off by a small mtu still decodes up to the cut so no need to complain about it 10 times a second
+            raw_stream_characteristic_length = length;
+            sendNotify(conn, raw_stream_characteristic_value_handle, raw_stream_characteristic_data, length);
+            conn->rawStreamSequence++;
         }
-        return 0;
+    }
+    else if (hasBulkChunk(conn))
+    {
+        uint16_t length = bulkReadChunk(conn->handle, bulk_characteristic_data, bulkNotifySize(conn));
+        if (length > 0)
+        {
+            bulk_characteristic_length = length;
+            sendNotify(conn, bulk_characteristic_value_handle, bulk_characteristic_data, length);
+        }
+    }
+    else if (conn->throughputActive)
+    {
+        sendThroughputFiller(conn);
     }
 
-    // if (att_handle == status_characteristic_client_configuration_handle)
-    // {
-    //     log_i("STATUS CHARACTERISTIC WRITTEN?? %i", little_endian_read_16(buffer, 0));
-    //     // status_characteristic_client_configuration[con_handle] = little_endian_read_16(buffer, 0); // setting status_characteristic_client_configuration to 1
-    //     return 0;
-    // }
-    // if (att_handle == rest_characteristic_client_configuration_handle)
-    // {
-    //     log_i("REST CHARACTERISTIC WRITTEN?? %i", little_endian_read_16(buffer, 0));
-    //     // rest_characteristic_client_configuration[con_handle] = little_endian_read_16(buffer, 0);
-    //     return 0;
-    // }
-    // if (att_handle == valve_control_characteristic_client_configuration_handle)
-    // {
-    //     log_i("VALVE CHARACTERISTIC WRITTEN?? %i", little_endian_read_16(buffer, 0));
-    //     // valve_control_characteristic_client_configuration[con_handle] = little_endian_read_16(buffer, 0);
-    //     return 0;
-    // }
-
-    return 0;
+    // more waiting? get back in line
+    runNotifyScheduler();
 }
 
-static void handle_connection_complete(uint8_t *packet)
+void buildStatusPacket()
 {
-    hci_con_handle_t handle = hci_subevent_le_connection_complete_get_connection_handle(packet);
-    uint8_t status = hci_subevent_le_connection_complete_get_status(packet);
-
+    uint32_t statusBittset = 0;
+    if (getCompressor()->isFrozen())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::COMPRESSOR_FROZEN);
+    }
+    if (getCompressor()->isOn())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::COMPRESSOR_STATUS_ON);
+    }
+    if (isVehicleOn())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::ACC_STATUS_ON);
+    }
+    if (isEBrakeOn())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::EBRAKE_STATUS_ON);
+    }
+    if (isKeepAliveTimerExpired())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::TIMER_STATUS_EXPIRED);
+    }
+    if ((millis() / 250) % 2)
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::CLOCK);
+    }
+    if (getriseOnStart())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::RISE_ON_START);
+    }
+    if (getmaintainPressure())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::MAINTAIN_PRESSURE);
+    }
+    if (getairOutOnShutoff())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::AIR_OUT_ON_SHUTOFF);
+    }
+    if (getheightSensorMode())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::HEIGHT_SENSOR_MODE);
+    }
+    if (getsafetyMode())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::SAFETY_MODE);
+    }
+    if (getaiEnabled())
+    {
+        statusBittset = statusBittset | (1 << StatusPacketBittset::AI_STATUS_ENABLED);
+    }
+
+    // // pack these 2 values together at the top of the statusBittset
+    // int aiDataPacked = (AIPercentage << 4) + AIReadyBittset; // combine at bottom
+    // aiDataPacked = (aiDataPacked << 21);                     // move to top end (4 + 7 = 11; 32-11 = 21)
+    // statusBittset = statusBittset | aiDataPacked;
+    StatusPacket statusPacket(getWheel(WHEEL_FRONT_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_REAR_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_FRONT_DRIVER)->getSelectedInputValue(), getWheel(WHEEL_REAR_DRIVER)->getSelectedInputValue(), getCompressor()->getTankPressure(), statusBittset, AIPercentage, AIReadyBittset);
+
+    memcpy(status_characteristic_data, statusPacket.tx(), BTOAS_PACKET_SIZE);
+    status_characteristic_length = statusPacket.txLength(true);
+}
+
+// send when something moved enough, but no faster than the client asked for, and at least every heartbeat so it knows we are still here
+bool shouldSendStatus(Connection *conn, StatusFields *current, unsigned long now)
+{
+    unsigned long elapsed = now - conn->lastStatusTime;
+    if (elapsed < conn->statusIntervalMS)
+    {
+        return false;
+    }
+    if (elapsed >= conn->statusHeartbeatMS)
+    {
+        return true;
+    }
+    uint32_t clockMask = ~(uint32_t)(1 << StatusPacketBittset::CLOCK); // flips every 250ms, doesn't count as a change
+    if ((current->bittset & clockMask) != (conn->lastStatus.bittset & clockMask) || current->aiPercentage != conn->lastStatus.aiPercentage || current->aiReadyBittset != conn->lastStatus.aiReadyBittset)
+    {
+        return true;
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        int delta = abs((int)current->pressures[i] - (int)conn->lastStatus.pressures[i]);
+        if (delta > 0 && delta >= conn->statusDeltaPSI)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void setStatusRate(hci_con_handle_t handle, StatusRatePacket *packet)
+{
+    Connection *conn = getConnection(handle, true);
+    if (conn == nullptr)
+    {
+        return;
+    }
+    uint16_t rate = packet->getMaxRateHz();
+    if (rate < 1)
+    {
+        rate = 1;
+    }
+    if (rate > STATUS_MAX_RATE_HZ)
+    {
+        rate = STATUS_MAX_RATE_HZ;
+    }
+    conn->statusIntervalMS = 1000 / rate;
+    conn->statusDeltaPSI = packet->getDeltaPSI();
+    conn->statusHeartbeatMS = packet->getHeartbeatMS() < conn->statusIntervalMS ? conn->statusIntervalMS : packet->getHeartbeatMS();
+    log_i("Client %i status rate: %iHz, delta %ipsi, heartbeat %ims", handle, rate, conn->statusDeltaPSI, conn->statusHeartbeatMS);
+}
+
+static unsigned long lastLinkActivity = 0;
+
+// anything a client sends, or valves moving on their own (routines, gamepad) keeps the links on the fast profile
+void linkActivity()
+{
+    lastLinkActivity = millis();
+}
+
+void requestLinkProfile(Connection *conn, BLELinkProfile profile)
+{
+    const BLELinkParams *params = getBLELinkParams(profile);
+    conn->linkProfile = profile;
+    // the central decides in the end, the controller turns down relaxed while it's on the home screen
+    gap_request_connection_parameter_update(conn->handle, params->minInterval, params->maxInterval, params->latency, params->timeout);
+    log_i("Client %i requesting %s link profile", conn->handle, getBLELinkProfileName(profile));
+}
+
+void updateLinkProfiles(unsigned long now)
+{
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        if (getManifold()->get(i)->isOpen())
+        {
+            lastLinkActivity = now;
+            break;
+        }
+    }
+    BLELinkProfile wanted = now - lastLinkActivity < BLE_LINK_IDLE_MS ? BLE_LINK_FAST : BLE_LINK_RELAXED;
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        if (connections[i].handle != HCI_CON_HANDLE_INVALID && connections[i].linkProfile != wanted)
+        {
+            requestLinkProfile(&connections[i], wanted);
+        }
+    }
+}
+
+void linkParamsChanged(hci_con_handle_t handle, uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    Connection *conn = getConnection(handle, false);
+    if (conn != nullptr)
+    {
+        conn->connInterval = interval;
+        conn->connLatency = latency;
+        conn->supervisionTimeout = timeout;
+    }
+    log_i("Client %i link: interval %.2fms, latency %i, timeout %ims", handle, interval * 1.25f, latency, timeout * 10);
+}
+
+void notifyTimerHandler(btstack_timer_source_t *ts)
+{
+    checkConnectedClients();
+    updateLinkProfiles(millis());
+    bulkCheckTimeouts(millis());
+
+    if (getAuthedCount() > 0)
+    {
+        buildStatusPacket();
+        StatusFields current;
+        memcpy(&current, &status_characteristic_data[BTOAS_HEADER_SIZE], sizeof(StatusFields));
+        unsigned long now = millis();
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            Connection *conn = &connections[i];
+            if (conn->handle != HCI_CON_HANDLE_INVALID && conn->authed && shouldSendStatus(conn, &current, now))
+            {
+                conn->statusPending = true; // if the last one never went out it just gets replaced by this one
+                conn->lastStatusTime = now;
+                conn->lastStatus = current;
+            }
+        }
+    }
+    runNotifyScheduler();
+
+    btstack_run_loop_set_timer(ts, NOTIFY_TICK_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+void notifyKickHandler(void *context)
+{
+    notifyKickPending = false;
+    runNotifyScheduler();
+}
+
+// call from anywhere when there is something new to send. Hops over to the btstack thread to actually do it
+void kickNotifyScheduler()
+{
+    bool expected = false;
+    if (notifyKickPending.compare_exchange_strong(expected, true))
+    {
+        btstack_run_loop_execute_on_main_thread(&notifyKick);
+    }
+}
+
+void startNotifySchedulerHandler(void *context)
+{
+    btstack_run_loop_set_timer_handler(&notifyTimer, notifyTimerHandler);
+    btstack_run_loop_set_timer(&notifyTimer, NOTIFY_TICK_MS);
+    btstack_run_loop_add_timer(&notifyTimer);
+}
+
+void startNotifyScheduler()
+{
+    notifyKick.callback = notifyKickHandler;
+    notifyKick.context = NULL;
+
+    static btstack_context_callback_registration_t startRegistration;
+    startRegistration.callback = startNotifySchedulerHandler;
+    startRegistration.context = NULL;
+    btstack_run_loop_execute_on_main_thread(&startRegistration);
+}
+
+#pragma endregion
+
+// ATT read callback
+static uint16_t att_read_callback(hci_con_handle_t con_handle, uint16_t att_handle, uint16_t offset, uint8_t *buffer, uint16_t buffer_size)
+{
+    if (att_handle == status_characteristic_value_handle)
+    {
+        return att_read_callback_handle_blob(status_characteristic_data, sizeof(status_characteristic_data), offset, buffer, buffer_size);
+    }
+    if (att_handle == rest_characteristic_value_handle)
+    {
+        return att_read_callback_handle_blob(rest_characteristic_data, sizeof(rest_characteristic_data), offset, buffer, buffer_size);
+    }
+    if (att_handle == valve_control_characteristic_value_handle)
+    {
+        return att_read_callback_handle_blob(valve_control_characteristic_data, sizeof(valve_control_characteristic_data), offset, buffer, buffer_size);
+    }
+    if (att_handle == raw_stream_characteristic_value_handle)
+    {
+        return att_read_callback_handle_blob(raw_stream_characteristic_data, raw_stream_characteristic_length, offset, buffer, buffer_size);
+    }
+    if (att_handle == bulk_characteristic_value_handle)
+    {
+        return att_read_callback_handle_blob(bulk_characteristic_data, bulk_characteristic_length, offset, buffer, buffer_size);
+    }
+    if (att_handle == status_characteristic_client_configuration_handle)
+    {
+        return 1; // att_read_callback_handle_little_endian_16(status_characteristic_client_configuration[con_handle], offset, buffer, buffer_size);
+    }
+    if (att_handle == rest_characteristic_client_configuration_handle)
+    {
+        return 1; // att_read_callback_handle_little_endian_16(rest_characteristic_client_configuration[con_handle], offset, buffer, buffer_size);
+    }
+    if (att_handle == valve_control_characteristic_client_configuration_handle)
+    {
+        return 1; // att_read_callback_handle_little_endian_16(valve_control_characteristic_client_configuration[con_handle], offset, buffer, buffer_size);
+    }
+    if (att_handle == raw_stream_characteristic_client_configuration_handle || att_handle == bulk_characteristic_client_configuration_handle)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+int runReceivedPacket(hci_con_handle_t con_handle, BTOasPacket *packet, uint16_t length);
+
+// ATT write callback
+static int att_write_callback(hci_con_handle_t con_handle, uint16_t att_handle, uint16_t transaction_mode, uint16_t offset, uint8_t *buffer, uint16_t buffer_size)
+{
+    static unsigned int valveTableValues = 0;
+
+    if (att_handle == rest_characteristic_value_handle)
+    {
+
+        Serial.println("Received rest command");
+        // packets always fit in one write, a long write would hand us pieces of one
+        if (transaction_mode != ATT_TRANSACTION_MODE_NONE || offset != 0)
+        {
+            return ATT_ERROR_REQUEST_NOT_SUPPORTED;
+        }
+        // copy it out so shorter compact packets get filled out with 0's
+        BTOasPacket received;
+        if (!received.rx(buffer, buffer_size))
+        {
+            return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+        }
+        received.dump();
+        Connection *conn = getConnection(con_handle, false);
+        if (conn != nullptr)
+        {
+            conn->packetsReceived++;
+        }
+        return runReceivedPacket(con_handle, &received, buffer_size);
+    }
+
+    if (att_handle == valve_control_characteristic_value_handle)
+    {
+
+        // for some reason some devices send less than the 4 bytes required for this (notably, only 1 byte gets sent from the mobile app). So this little trick gets us into a 4 byte buffer safely.
+        // An empty write would close everything though, so that one doesn't count
+        if (buffer_size == 0 || buffer_size > 4 || offset != 0)
+        {
+            return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+        }
+        uint8_t valveControlBittsetArr[4] = {0};
+        memcpy(valveControlBittsetArr, buffer, buffer_size > 3 ? 4 : buffer_size);
+
+        if (isAuthed(con_handle))
+        {
+            unsigned int valveControlBittset = *(unsigned int *)&valveControlBittsetArr; // little_endian_read_32(buffer, 0);
+            linkActivity();
+            Serial.printf("Value received for valve: %i\n", valveControlBittset);
+
+            for (int i = 0; i < 8; i++)
+            {
+                bool prevVal = (valveTableValues >> i) & 1;
+                bool curVal = (valveControlBittset >> i) & 1;
+                if (prevVal != curVal)
+                {
+                    if (curVal)
+                    {
+                        Serial.print("Opening ");
+                        Serial.println(i);
+                        getManifold()->get(i)->open();
+                    }
+                    else
+                    {
+                        Serial.print("Closing ");
+                        Serial.println(i);
+                        getManifold()->get(i)->close();
+                    }
+                }
+            }
+            valveTableValues = valveControlBittset;
+        }
+        return 0;
+    }
+
+    // unlike the others, this one is opt in so we actually care about the subscribe
+    if (att_handle == raw_stream_characteristic_client_configuration_handle)
+    {
+        bool subscribed = buffer_size >= 2 && (little_endian_read_16(buffer, 0) & GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION) != 0;
+        setRawStreamSubscribed(con_handle, subscribed);
+        return 0;
+    }
+
+    // if (att_handle == status_characteristic_client_configuration_handle)
+    // {
+    //     log_i("STATUS CHARACTERISTIC WRITTEN?? %i", little_endian_read_16(buffer, 0));
+    //     // status_characteristic_client_configuration[con_handle] = little_endian_read_16(buffer, 0); // setting status_characteristic_client_configuration to 1
+    //     return 0;
+    // }
+    // if (att_handle == rest_characteristic_client_configuration_handle)
+    // {
+    //     log_i("REST CHARACTERISTIC WRITTEN?? %i", little_endian_read_16(buffer, 0));
+    //     // rest_characteristic_client_configuration[con_handle] = little_endian_read_16(buffer, 0);
+    //     return 0;
+    // }
+    // if (att_handle == valve_control_characteristic_client_configuration_handle)
+    // {
+    //     log_i("VALVE CHARACTERISTIC WRITTEN?? %i", little_endian_read_16(buffer, 0));
+    //     // valve_control_characteristic_client_configuration[con_handle] = little_endian_read_16(buffer, 0);
+    //     return 0;
+    // }
+
+    return 0;
+}
+
+static void handle_connection_complete(uint8_t *packet)
+{
+    hci_con_handle_t handle = hci_subevent_le_connection_complete_get_connection_handle(packet);
+    uint8_t status = hci_subevent_le_connection_complete_get_status(packet);
+
     bd_addr_t addr;
     hci_subevent_le_connection_complete_get_peer_address(packet, addr);
     printf("Connected to device with MAC: %s\n", bd_addr_to_str(addr));
@@ -347,23 +990,27 @@ static void handle_connection_complete(uint8_t *packet)
     // memcpy(rest_characteristic_data, arp.tx(), BTOAS_PACKET_SIZE);
     currentUserNum++;
 
-    ClientTime ct = {};
-    ct.conn_id = handle;
-    ct.connectTime = millis();
-    memcpy(ct.addr, addr, sizeof(bd_addr_t));
-
-    addConnectedClient(ct);
+    Connection *conn = getConnection(handle, true); // has to be here before auth so the auth reply can go out
+    if (conn == nullptr)
+    {
+        // can't happen with gap_set_max_number_peripheral_connections set, but without a slot they could never auth anyways
+        log_i("No free connection slot, disconnecting %04x", handle);
+        gap_disconnect(handle);
+        return;
+    }
+    memcpy(conn->addr, addr, sizeof(bd_addr_t));
+    if (!packetMover::claimQueue(handle))
+    {
+        log_i("No free rest queue for %04x", handle); // same count as the connection slots, so shouldn't happen either
+    }
 
     gap_advertisements_enable(1);
 
-    // Request faster connection parameters
-    gap_request_connection_parameter_update(
-        handle,
-        12, // min_interval: 15ms
-        24, // max_interval: 30ms
-        0,  // latency
-        100 // timeout: 1000ms
-    );
+    linkParamsChanged(handle, hci_subevent_le_connection_complete_get_conn_interval(packet), hci_subevent_le_connection_complete_get_conn_latency(packet), hci_subevent_le_connection_complete_get_supervision_timeout(packet));
+
+    // connecting counts as activity, auth and the first few packets should be quick
+    linkActivity();
+    requestLinkProfile(conn, BLE_LINK_FAST);
 }
 
 // HCI event handler
@@ -381,7 +1028,10 @@ static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *pa
     {
     case HCI_EVENT_DISCONNECTION_COMPLETE:
         log_i("Client disconnected!");
-        removeAuthed(hci_event_disconnection_complete_get_connection_handle(packet));
+        packetMover::releaseQueue(hci_event_disconnection_complete_get_connection_handle(packet));
+        releaseConnection(hci_event_disconnection_complete_get_connection_handle(packet));
+        valvePulseCancel(hci_event_disconnection_complete_get_connection_handle(packet)); // don't leave air flowing if they dropped mid pulse
+        bulkCancel(hci_event_disconnection_complete_get_connection_handle(packet));       // they resume by opening it again at their last offset
         gap_advertisements_enable(1);
         break;
 
@@ -391,7 +1041,31 @@ static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *pa
         case HCI_SUBEVENT_LE_CONNECTION_COMPLETE:
             handle_connection_complete(packet);
             break;
+        case HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE:
+            if (hci_subevent_le_connection_update_complete_get_status(packet) == ERROR_CODE_SUCCESS)
+            {
+                linkParamsChanged(hci_subevent_le_connection_update_complete_get_connection_handle(packet),
+                                  hci_subevent_le_connection_update_complete_get_conn_interval(packet),
+                                  hci_subevent_le_connection_update_complete_get_conn_latency(packet),
+                                  hci_subevent_le_connection_update_complete_get_supervision_timeout(packet));
+            }
+            break;
+        }
+        break;
+
+    case ATT_EVENT_MTU_EXCHANGE_COMPLETE:
+    {
+        Connection *conn = getConnection(att_event_mtu_exchange_complete_get_handle(packet), false);
+        if (conn != nullptr)
+        {
+            conn->mtu = att_event_mtu_exchange_complete_get_MTU(packet);
+            log_i("Client %i mtu: %i", conn->handle, conn->mtu);
         }
+    }
+    break;
+
+    case ATT_EVENT_CAN_SEND_NOW:
+        handleCanSendNow(att_event_can_send_now_get_handle(packet));
         break;
 
     case BTSTACK_EVENT_STATE:
@@ -432,7 +1106,8 @@ void generateAdvData(String name)
 
 void ble_setup()
 {
-    packetMover::setupRestSemaphore();
+    packetMover::setupRestQueues();
+    setupConnections();
 
     // Initialize ATT Server with our database
     att_server_init(profile_data, att_read_callback, att_write_callback);
@@ -471,340 +1146,747 @@ void ble_setup()
     int valveValue = 0;
     little_endian_store_32(valve_control_characteristic_data, 0, valveValue);
 
+    startNotifyScheduler();
+
     Serial.print("Broadcast started, name:");
     Serial.println(getbleName().c_str());
     Serial.println("Waiting a client connection to notify...");
 }
 
-void ble_loop()
+#pragma region link benchmark
+
+// Round trips and throughput from this end, started from usb serial (see readLinkBenchCommand). Pings go to every authed client,
+// the echoes come back through handlePing on the btstack thread
+#define BENCH_PING_INTERVAL_MS 50
+#define BENCH_ECHO_WAIT_MS 1000 // after the last ping, before printing
+
+static LinkBenchmark linkBench;
+static uint16_t benchPingsLeft = 0;
+static uint16_t benchPingSequence = 0;
+static unsigned long benchNextPingTime = 0;
+static bool benchPrintPending = false;
+static btstack_context_callback_registration_t benchThroughputStart;
+
+void benchThroughputStartHandler(void *context)
 {
-    static int prevConnectedCount = -1;
-    int connectedCount = authedClients.size();
-    if (connectedCount != prevConnectedCount)
+    uint32_t durationMS = (uint32_t)(uintptr_t)context;
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
     {
-        Serial.printf("connectedCount: %d\n", connectedCount);
+        if (connections[i].handle != HCI_CON_HANDLE_INVALID && connections[i].authed)
+        {
+            startThroughput(&connections[i], durationMS);
+        }
     }
-    prevConnectedCount = connectedCount;
+}
 
-    checkConnectedClients();
-    ble_notify();
+void benchPrint()
+{
+    char buf[64];
+    linkBench.formatRtt(buf, sizeof(buf));
+    Serial.printf("BENCH RTT %s\n", buf);
 }
 
-uint8_t att_server_notify_SAFE(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value, uint16_t value_len)
+void updateLinkBenchmark()
 {
+    uint32_t arg = 0;
+    char other[32];
+    switch (readLinkBenchCommand(&arg, other, sizeof(other)))
+    {
+    case LINK_BENCH_PING:
+        linkBench.reset();
+        benchPingsLeft = arg;
+        benchNextPingTime = millis();
+        break;
+    case LINK_BENCH_THROUGHPUT:
+        benchThroughputStart.callback = benchThroughputStartHandler;
+        benchThroughputStart.context = (void *)(uintptr_t)(arg * 1000);
+        btstack_run_loop_execute_on_main_thread(&benchThroughputStart);
+        break;
+    case LINK_BENCH_PRINT:
+        benchPrint();
+        break;
+    case LINK_BENCH_OTHER:
+        if (strcmp(other, "tasks") == 0)
+        {
+            printTaskDiagnostics();
+        }
+        break;
+    default:
+        break;
+    }
 
-    while (!att_server_can_send_packet_now(con_handle))
+    unsigned long now = millis();
+    if (benchPingsLeft > 0 && (long)(now - benchNextPingTime) >= 0)
+    {
+        PingPacket ping(PINGCMD_PING, benchPingSequence++);
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            if (connections[i].handle != HCI_CON_HANDLE_INVALID && connections[i].authed)
+            {
+                packetMover::sendRestPacket(&ping, connections[i].handle);
+                linkBench.pingsSent++;
+            }
+        }
+        benchPingsLeft--;
+        benchNextPingTime = now + BENCH_PING_INTERVAL_MS;
+        benchPrintPending = benchPingsLeft == 0;
+    }
+    if (benchPrintPending && (long)(now - benchNextPingTime) >= BENCH_ECHO_WAIT_MS)
     {
-        // log_i("\n\n\nCAN'T SEND PACKET\n\n\n");
-        delay(10);
+        benchPrintPending = false;
+        benchPrint();
     }
-    return att_server_notify(con_handle, attribute_handle, value, value_len);
 }
 
-extern uint8_t AIReadyBittset; // 4
-extern uint8_t AIPercentage;   // 7
+void benchEchoReceived(PingPacket *echo)
+{
+    linkBench.addRtt(micros() - echo->getSenderTime());
+}
+
+#pragma endregion
 
-void ble_notify()
+void ble_loop()
 {
+    static int prevConnectedCount = -1;
+    int connectedCount = getAuthedCount();
+    if (connectedCount != prevConnectedCount)
+    {
+        Serial.printf("connectedCount: %d\n", connectedCount);
+    }
+    prevConnectedCount = connectedCount;
 
-    // first, pending packets
-    BTOasPacket packet;
-    hci_con_handle_t rest_con_handle;
-    while (packetMover::getBTRestPacketToSend(&packet, rest_con_handle))
+    static uint32_t prevOverflowCount = 0;
+    uint32_t overflowCount = packetMover::getOverflowCount();
+    if (overflowCount != prevOverflowCount)
     {
-        delay(40); // This feels really shitty but it wants some delay here in-between packets or it won't send. So there is various delay's throught this file
-        packet.dump();
-        memcpy(rest_characteristic_data, packet.tx(), BTOAS_PACKET_SIZE);
-        att_server_notify_SAFE(rest_con_handle, rest_characteristic_value_handle, rest_characteristic_data, BTOAS_PACKET_SIZE);
-        Serial.println("Sent rest packet!");
-        delay(40);
+        Serial.printf("Rest queue overflow, %u packets dropped total\n", overflowCount);
+        prevOverflowCount = overflowCount;
+    }
+
+    // auth timeouts and notifies are all handled by the notify scheduler on the btstack thread now
+
+    updateLinkBenchmark();
+}
+
+
+#pragma region packet handlers
+
+// Every rest packet a client can send is in packetHandlers at the bottom. Each entry says how much of args its handler reads and
+// whether the client has to be authed, and runReceivedPacket checks both before calling it so a short write gets turned away
+// instead of the handler acting on 0's the client never sent. Adding a command is a new handler and a new line in the table
+
+enum PacketAuthLevel
+{
+    PACKET_AUTH_NONE,  // anyone connected, the handler checks for itself
+    PACKET_AUTH_CLIENT // only clients that sent the right passkey
+};
+
+typedef void (*PacketHandler)(hci_con_handle_t con_handle, BTOasPacket *packet);
+
+struct PacketHandlerEntry
+{
+    uint16_t cmd;
+    uint8_t minPayloadSize; // bytes of args the handler needs. For BTOAS_PAYLOAD_VARIABLE packets it's what's left after the trailing 0's get trimmed
+    PacketAuthLevel auth;
+    PacketHandler handler; // nullptr to accept it and do nothing
+};
+
+// replies carry the request id of what they answer so the client can match them up
+static void sendReply(hci_con_handle_t con_handle, BTOasPacket *request, BTOasPacket *reply)
+{
+    reply->requestId = request->requestId;
+    packetMover::sendRestPacket(reply, con_handle);
+}
+
+static void handleAirUp(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    Serial.println("Calling air up!");
+    airUp();
+}
+
+static void handleAirOut(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    airOut();
+}
+
+static void handleAirSM(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    airUpRelativeToAverage(((AirsmPacket *)packet)->getRelativeValue());
+}
+
+static void handleSaveToProfile(hci_con_handle_t con_handle, BTOasPacket *packet) // add if (profileIndex > MAX_PROFILE_COUNT)
+{
+    writeProfile(((SaveToProfilePacket *)packet)->getProfileIndex());
+}
+
+static void handleSaveCurrentPressuresToProfile(hci_con_handle_t con_handle, BTOasPacket *packet) // add if (profileIndex > MAX_PROFILE_COUNT)
+{
+    Serial.println("Calling Save Current Pressures To Profile!");
+    savePressuresToProfile(((SaveCurrentPressuresToProfilePacket *)packet)->getProfileIndex(), getWheel(WHEEL_FRONT_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_REAR_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_FRONT_DRIVER)->getSelectedInputValue(), getWheel(WHEEL_REAR_DRIVER)->getSelectedInputValue());
+}
+
+static void handleReadProfile(hci_con_handle_t con_handle, BTOasPacket *packet) // add if (profileIndex > MAX_PROFILE_COUNT)
+{
+    readProfile(((ReadProfilePacket *)packet)->getProfileIndex());
+}
+
+static void handleAirUpQuick(hci_con_handle_t con_handle, BTOasPacket *packet) // add if (profileIndex > MAX_PROFILE_COUNT)
+{
+    // load profile then air up
+    Serial.println("Calling air up quick!");
+    readProfile(((AirupQuickPacket *)packet)->getProfileIndex());
+    airUp(false); // typically this was true but im changing it to not be because now this is the main air up method on the controller :)
+}
+
+static void handleBaseProfile(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setbaseProfile(((BaseProfilePacket *)packet)->getProfileIndex());
+}
+
+static void handleSetAirHeight(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    SetAirheightPacket *ahp = (SetAirheightPacket *)packet;
+    switch (ahp->getWheelIndex())
+    {
+    case WHEEL_FRONT_PASSENGER:
+        setRideHeightFrontPassenger(ahp->getPressure());
+        break;
+    case WHEEL_REAR_PASSENGER:
+        setRideHeightRearPassenger(ahp->getPressure());
+        break;
+    case WHEEL_FRONT_DRIVER:
+        setRideHeightFrontDriver(ahp->getPressure());
+        break;
+    case WHEEL_REAR_DRIVER:
+        setRideHeightRearDriver(ahp->getPressure());
+        break;
     }
+}
+
+static void handleRiseOnStart(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setriseOnStart(((RiseOnStartPacket *)packet)->getBoolean());
+}
+
+#if ENABLE_AIR_OUT_ON_SHUTOFF
+static void handleFallOnShutdown(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setairOutOnShutoff(((FallOnShutdownPacket *)packet)->getBoolean());
+}
+#endif
+
+static void handleHeightSensorMode(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setheightSensorMode(((HeightSensorModePacket *)packet)->getBoolean());
+}
+
+static void handleSafetyMode(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setsafetyMode(((SafetyModePacket *)packet)->getBoolean());
+}
+
+static void handleDetectPressureSensors(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setlearnPressureSensors(true);
+    setinternalReboot(true);
+}
+
+static void handleRaiseOnPressureSet(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setraiseOnPressure(((RaiseOnPressureSetPacket *)packet)->getBoolean());
+}
+
+static void handleReboot(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setinternalReboot(true);
+    Serial.println(F("Rebooting..."));
+}
+
+static void handleTurnOff(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    Serial.println(F("Turning off..."));
+    forceShutoff = true;
+}
 
-    //  calculate whether or not to do stuff at a specific interval, in this case, every 1 second we want to send out a notify.
-    static bool prevTime = false;
-    bool timeChange = (millis() / 250) % 2; // changes from 0 to 1 every 250ms
-    bool runNotifications = false;
-    if (prevTime != timeChange)
+static void handleResetAI(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    clearPressureData();
+}
+
+static void handleCalibrate(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    Serial.println("Feature unfinished");
+}
+
+static void handleStartWeb(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    Serial.println(F("Starting OTA..."));
+    setwifiSSID(((StartwebPacket *)packet)->getSSID());
+    setwifiPassword(((StartwebPacket *)packet)->getPassword());
+    setupdateMode(true);
+    setinternalReboot(true);
+}
+
+static void handlePresetReport(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    readProfile(((PresetPacket *)packet)->getProfile());
+    PresetPacket presetPacket(((PresetPacket *)packet)->getProfile(), currentProfile[WHEEL_FRONT_PASSENGER], currentProfile[WHEEL_REAR_PASSENGER], currentProfile[WHEEL_FRONT_DRIVER], currentProfile[WHEEL_REAR_DRIVER]);
+    sendReply(con_handle, packet, &presetPacket);
+    presetPacket.dump();
+}
+
+static void handleMaintainPressure(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setmaintainPressure(((MaintainPressurePacket *)packet)->getBoolean());
+}
+
+static void handleCompressorStatus(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    // TODO: THIS MIGHT HAVE THREADING ISSUES BUT IDK
+    getCompressor()->enableDisableOverride(((CompressorStatusPacket *)packet)->getBoolean());
+}
+
+static void handleAIStatusEnabled(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setaiEnabled(((AIStatusPacket *)packet)->getBoolean());
+}
+
+static void handleConfigValues(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    ConfigValuesPacket *recpkt = (ConfigValuesPacket *)packet;
+    if (*recpkt->_setValues())
     {
-        runNotifications = true;
+        setbagMaxPressure(*recpkt->_bagMaxPressure());
+        setsystemShutoffTimeM(*recpkt->_systemShutoffTimeM());
+        setcompressorOnPSI(*recpkt->_compressorOnPSI());
+        setcompressorOffPSI(*recpkt->_compressorOffPSI());
+        setpressureSensorMax(*recpkt->_pressureSensorMax());
+        setbagVolumePercentage(*recpkt->_bagVolumePercentage());
     }
-    prevTime = timeChange;
-    if (runNotifications && authedClients.size() > 0)
+    ConfigValuesPacket pkt(false, getbagMaxPressure(), getsystemShutoffTimeM(), getcompressorOnPSI(), getcompressorOffPSI(), getpressureSensorMax(), getbagVolumePercentage());
+    sendReply(con_handle, packet, &pkt);
+}
+
+// the only one that runs before the client is authed, since this is how it gets authed
+static void handleAuth(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    AuthPacket *ap = (AuthPacket *)packet;
+    switch (ap->getBleAuthResult())
     {
-        uint32_t statusBittset = 0;
-        if (getCompressor()->isFrozen())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::COMPRESSOR_FROZEN);
-        }
-        if (getCompressor()->isOn())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::COMPRESSOR_STATUS_ON);
-        }
-        if (isVehicleOn())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::ACC_STATUS_ON);
-        }
-        if (isEBrakeOn())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::EBRAKE_STATUS_ON);
-        }
-        if (isKeepAliveTimerExpired())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::TIMER_STATUS_EXPIRED);
-        }
-        if (timeChange)
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::CLOCK);
-        }
-        if (getriseOnStart())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::RISE_ON_START);
-        }
-        if (getmaintainPressure())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::MAINTAIN_PRESSURE);
-        }
-        if (getairOutOnShutoff())
-        {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::AIR_OUT_ON_SHUTOFF);
-        }
-        if (getheightSensorMode())
+    case AuthResult::AUTHRESULT_WAITING:
+    {
+        // AUTH REQUEST
+        if (ap->getBlePasskey() == getblePasskey())
         {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::HEIGHT_SENSOR_MODE);
+            ap->setBleAuthResult(AuthResult::AUTHRESULT_SUCCESS);
+            addAuthed(con_handle);
+            Connection *conn = getConnection(con_handle, true);
+            if (conn != nullptr)
+            {
+                conn->compact = (ap->getCapabilities() & BTOAS_CAP_COMPACT) != 0;
+                conn->statusDelta = conn->compact && (ap->getCapabilities() & BTOAS_CAP_STATUS_DELTA) != 0;
+            }
         }
-        if (getsafetyMode())
+        else
         {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::SAFETY_MODE);
+            ap->setBleAuthResult(AuthResult::AUTHRESULT_FAIL);
         }
-        if (getaiEnabled())
+        ap->setManifoldCapabilities(BTOAS_CAP_COMPACT | BTOAS_CAP_STATUS_DELTA | BTOAS_CAP_VALVE_PULSE | BTOAS_CAP_BATCH | BTOAS_CAP_BULK | BTOAS_CAP_STATE_SYNC | BTOAS_CAP_REQUEST_ID | BTOAS_CAP_JOYSTICK_CONFIG | BTOAS_CAP_GAMEPAD_MAP); // tell them what we support
+        packetMover::sendRestPacket(ap, con_handle);
+    }
+    break;
+    case AuthResult::AUTHRESULT_UPDATEKEY:
+        // only someone who already knows the passkey gets to change it
+        if (isAuthed(con_handle) && ap->getBlePasskey() != getblePasskey())
         {
-            statusBittset = statusBittset | (1 << StatusPacketBittset::AI_STATUS_ENABLED);
+            setblePasskey(ap->getBlePasskey());
         }
+        break;
+    default:
+        break;
+    }
+}
 
-        // // pack these 2 values together at the top of the statusBittset
-        // int aiDataPacked = (AIPercentage << 4) + AIReadyBittset; // combine at bottom
-        // aiDataPacked = (aiDataPacked << 21);                     // move to top end (4 + 7 = 11; 32-11 = 21)
-        // statusBittset = statusBittset | aiDataPacked;
-        StatusPacket statusPacket(getWheel(WHEEL_FRONT_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_REAR_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_FRONT_DRIVER)->getSelectedInputValue(), getWheel(WHEEL_REAR_DRIVER)->getSelectedInputValue(), getCompressor()->getTankPressure(), statusBittset, AIPercentage, AIReadyBittset);
-
-        memcpy(status_characteristic_data, statusPacket.tx(), BTOAS_PACKET_SIZE);
-
-        for (hci_con_handle_t handle : authedClients)
-        {
-            att_server_notify_SAFE(handle, status_characteristic_value_handle, status_characteristic_data, BTOAS_PACKET_SIZE);
-            delay(10); // need a delay here or it only sends it to 1 client
-        }
+static void handleBroadcastName(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    String name = ((BroadcastNamePacket *)packet)->getBroadcastName();
+    if (name != getbleName())
+    {
+        setbleName(name);
+        Serial.print("new broacast name:");
+        Serial.println(getbleName());
     }
 }
 
-void runReceivedPacket(hci_con_handle_t con_handle, BTOasPacket *packet)
+static void handleBP32(hci_con_handle_t con_handle, BTOasPacket *packet)
 {
-    notifyKeepAlive();
-    switch (packet->cmd)
+    BP32CMD bp32cmd = (BP32CMD)((BP32Packet *)packet)->args16()[0].i;
+    bool bp32val = ((BP32Packet *)packet)->args16()[1].i;
+    switch (bp32cmd)
     {
-    case BTOasIdentifier::IDLE:
-        break;
-    case BTOasIdentifier::ASSIGNRECEPIENT: // ignore from server
-        break;
-    case BTOasIdentifier::MESSAGE: // ignore from server
-        break;
-    case BTOasIdentifier::AIRUP:
-        Serial.println("Calling air up!");
-        airUp();
-        break;
-    case BTOasIdentifier::AIROUT:
-        airOut();
+    case BP32CMD::BP32CMD_ENABLE_NEW_CONN:
+        Serial.println("Enabling new connections!");
+        bp32_setAllowNewConnections(bp32val);
         break;
-    case BTOasIdentifier::AIRSM:
-        airUpRelativeToAverage(((AirsmPacket *)packet)->getRelativeValue());
+    case BP32CMD::BP32CMD_FORGET_DEVICES:
+        Serial.println("Forgetting controllers!");
+        bp32_forgetDevices();
         break;
-    case BTOasIdentifier::SAVETOPROFILE: // add if (profileIndex > MAX_PROFILE_COUNT)
-        writeProfile(((SaveToProfilePacket *)packet)->getProfileIndex());
+    case BP32CMD::BP32CMD_DISCONNECT_DEVICES:
+        Serial.println("disconnecting controllers!");
+        bp32_disconnectControllers();
         break;
-    case BTOasIdentifier::SAVECURRENTPRESSURESTOPROFILE: // add if (profileIndex > MAX_PROFILE_COUNT)
-        Serial.println("Calling Save Current Pressures To Profile!");
-        savePressuresToProfile(((SaveCurrentPressuresToProfilePacket *)packet)->getProfileIndex(), getWheel(WHEEL_FRONT_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_REAR_PASSENGER)->getSelectedInputValue(), getWheel(WHEEL_FRONT_DRIVER)->getSelectedInputValue(), getWheel(WHEEL_REAR_DRIVER)->getSelectedInputValue());
-        break;
-    case BTOasIdentifier::READPROFILE: // add if (profileIndex > MAX_PROFILE_COUNT)
-        readProfile(((ReadProfilePacket *)packet)->getProfileIndex());
-        break;
-    case BTOasIdentifier::AIRUPQUICK: // add if (profileIndex > MAX_PROFILE_COUNT)
-        // load profile then air up
-        Serial.println("Calling air up quick!");
-        readProfile(((AirupQuickPacket *)packet)->getProfileIndex());
-        airUp(false); // typically this was true but im changing it to not be because now this is the main air up method on the controller :)
-        break;
-    case BTOasIdentifier::BASEPROFILE:
-        setbaseProfile(((BaseProfilePacket *)packet)->getProfileIndex());
+    }
+}
+
+// firmware version, or why the last update failed
+static const char *getUpdateStatusText()
+{
+    switch (getupdateResult())
+    {
+    case UPDATE_STATUS::UPDATE_STATUS_FAIL_FILE_REQUEST:
+        return "[F] FW DL";
+    case UPDATE_STATUS::UPDATE_STATUS_FAIL_GENERIC:
+        return "[F] Install";
+    case UPDATE_STATUS::UPDATE_STATUS_FAIL_VERSION_REQUEST:
+        return "[F] Finding";
+    case UPDATE_STATUS::UPDATE_STATUS_FAIL_WIFI_CONNECTION:
+        return "[F] No WiFi";
+    default:
+        return "v" EVALUATE_AND_STRINGIFY(RELEASE_VERSION);
+    }
+}
+
+static void handleUpdateStatusRequest(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    UpdateStatusRequestPacket pkt(getUpdateStatusText());
+    sendReply(con_handle, packet, &pkt);
+}
+
+static void handleBootTimings(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    BootTimingsPacket pkt(isFastBoot(), getBootPhaseTimes());
+    sendReply(con_handle, packet, &pkt);
+}
+
+static void handleTelemetry(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    TelemetryPacket *tp = (TelemetryPacket *)packet;
+    switch (tp->getCommand())
+    {
+    case TelemetryCMD::TELEMETRYCMD_SET_RATE:
+        settelemetryRateMS(telemetryClampRate(tp->getValue()));
         break;
-    case BTOasIdentifier::SETAIRHEIGHT:
+    case TelemetryCMD::TELEMETRYCMD_EXPORT:
     {
-        SetAirheightPacket *ahp = (SetAirheightPacket *)packet;
-        switch (ahp->getWheelIndex())
+        // client walks the offset up until it gets a 0 length back
+        if (tp->getValue() == 0)
         {
-        case WHEEL_FRONT_PASSENGER:
-            setRideHeightFrontPassenger(ahp->getPressure());
-            break;
-        case WHEEL_REAR_PASSENGER:
-            setRideHeightRearPassenger(ahp->getPressure());
-            break;
-        case WHEEL_FRONT_DRIVER:
-            setRideHeightFrontDriver(ahp->getPressure());
-            break;
-        case WHEEL_REAR_DRIVER:
-            setRideHeightRearDriver(ahp->getPressure());
-            break;
+            telemetryFlush(); // get whatever is sitting in ram out too
         }
+        TelemetryPacket pkt(TelemetryCMD::TELEMETRYCMD_EXPORT, tp->getValue());
+        pkt.setTotalSize(telemetryGetSize());
+        pkt.setDataLength(telemetryRead(tp->getValue(), pkt.data(), TELEMETRY_PACKET_DATA_SIZE));
+        sendReply(con_handle, packet, &pkt);
     }
     break;
-    case BTOasIdentifier::RISEONSTART:
-        setriseOnStart(((RiseOnStartPacket *)packet)->getBoolean());
-        break;
-#if ENABLE_AIR_OUT_ON_SHUTOFF
-    case BTOasIdentifier::FALLONSHUTDOWN:
-        setairOutOnShutoff(((FallOnShutdownPacket *)packet)->getBoolean());
-        break;
-#endif
-    case BTOasIdentifier::HEIGHTSENSORMODE:
-        setheightSensorMode(((HeightSensorModePacket *)packet)->getBoolean());
-        break;
-    case BTOasIdentifier::SAFETYMODE:
-        setsafetyMode(((SafetyModePacket *)packet)->getBoolean());
-        break;
-    case BTOasIdentifier::DETECTPRESSURESENSORS:
-        setlearnPressureSensors(true);
-        setinternalReboot(true);
-        break;
-    case BTOasIdentifier::RAISEONPRESSURESET:
-        setraiseOnPressure(((RaiseOnPressureSetPacket *)packet)->getBoolean());
-        break;
-    case BTOasIdentifier::REBOOT:
-        setinternalReboot(true);
-        Serial.println(F("Rebooting..."));
-        break;
-    case BTOasIdentifier::TURNOFF:
-        Serial.println(F("Turning off..."));
-        forceShutoff = true;
+    }
+}
+
+static void handleStatusRate(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    setStatusRate(con_handle, (StatusRatePacket *)packet);
+}
+
+static void handleValvePulse(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    valvePulseStart(con_handle, (ValvePulsePacket *)packet);
+}
+
+static void handleStatusDelta(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    // client lost track, next status it gets will be a keyframe
+    Connection *conn = getConnection(con_handle, false);
+    if (conn != nullptr)
+    {
+        conn->keyframeNeeded = true;
+        conn->statusPending = true;
+        kickNotifyScheduler();
+    }
+}
+
+// one reply with everything the controller asks for on connect, instead of a request and reply for each piece
+static void handleStateSync(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    static uint32_t bootId = 0;
+    if (bootId == 0)
+    {
+        bootId = esp_random() | 1; // never 0, that's what a client with nothing cached sends
+    }
+    StateSyncPacket *request = (StateSyncPacket *)packet;
+    uint32_t stateVersion = getPreferencableChangeCount();
+    StateSyncPacket reply(bootId, stateVersion);
+    memcpy(reply.status(), status_characteristic_data + BTOAS_HEADER_SIZE, STATESYNC_STATUS_SIZE);
+    if (request->getBootId() != bootId || request->getStateVersion() != stateVersion)
+    {
+        reply.setFull(true);
+        ConfigValuesPacket config(false, getbagMaxPressure(), getsystemShutoffTimeM(), getcompressorOnPSI(), getcompressorOffPSI(), getpressureSensorMax(), getbagVolumePercentage());
+        memcpy(reply.config(), config.args, STATESYNC_CONFIG_SIZE);
+        for (int i = 0; i < MAX_PROFILE_COUNT; i++)
+        {
+            for (int w = 0; w < 4; w++)
+            {
+                reply.setPresetPressure(i, w, _SaveData.profile[i].pressure[w].get().i);
+            }
+        }
+        reply.setFirmwareVersion(getUpdateStatusText());
+    }
+    sendReply(con_handle, packet, &reply);
+}
+
+static void handleBulk(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    BulkPacket reply(BULKCMD_OPEN, 0, 0);
+    if (bulkHandlePacket(con_handle, (BulkPacket *)packet, &reply))
+    {
+        sendReply(con_handle, packet, &reply);
+    }
+    kickNotifyScheduler(); // an ack or a resend means there's more to send
+}
+
+static void handlePing(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    PingPacket *ping = (PingPacket *)packet;
+    switch (ping->getCommand())
+    {
+    case PINGCMD_PING:
+    {
+        PingPacket echo = *ping;
+        echo.setCommand(PINGCMD_ECHO);
+        echo.setEchoTime(micros());
+        sendReply(con_handle, packet, &echo);
         break;
-    case BTOasIdentifier::RESETAIPKT:
-        clearPressureData();
+    }
+    case PINGCMD_ECHO:
+        benchEchoReceived(ping);
         break;
-    case BTOasIdentifier::CALIBRATE:
-        Serial.println("Feature unfinished");
+    case PINGCMD_THROUGHPUT:
+    {
+        Connection *conn = getConnection(con_handle, false);
+        if (conn != nullptr)
+        {
+            startThroughput(conn, ping->getValue());
+        }
         break;
-    case BTOasIdentifier::STARTWEB:
-        Serial.println(F("Starting OTA..."));
-        setwifiSSID(((StartwebPacket *)packet)->getSSID());
-        setwifiPassword(((StartwebPacket *)packet)->getPassword());
-        setupdateMode(true);
-        setinternalReboot(true);
+    }
+    default:
         break;
-    case BTOasIdentifier::PRESETREPORT:
+    }
+}
+
+static void handleJoystickConfig(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    JoystickConfigPacket *recpkt = (JoystickConfigPacket *)packet;
+    if (recpkt->getSetValues())
     {
-        readProfile(((PresetPacket *)packet)->getProfile());
-        PresetPacket presetPacket(((PresetPacket *)packet)->getProfile(), currentProfile[WHEEL_FRONT_PASSENGER], currentProfile[WHEEL_REAR_PASSENGER], currentProfile[WHEEL_FRONT_DRIVER], currentProfile[WHEEL_REAR_DRIVER]);
-        packetMover::sendRestPacket(&presetPacket, con_handle);
-        presetPacket.dump();
+        // out of range values just get pulled back in, bp32 picks up the new ones on the next input
+        uint8_t curve = recpkt->getCurve();
+        uint16_t period = recpkt->getPeriod();
+        setjoystickMode(recpkt->getMode() == JOYSTICK_MODE_PROPORTIONAL ? JOYSTICK_MODE_PROPORTIONAL : JOYSTICK_MODE_ON_OFF);
+        setjoystickDeadzone(recpkt->getDeadzone() > JOYSTICK_DEADZONE_MAX ? JOYSTICK_DEADZONE_MAX : recpkt->getDeadzone());
+        setjoystickCurve(curve < JOYSTICK_CURVE_MIN ? JOYSTICK_CURVE_MIN : (curve > JOYSTICK_CURVE_MAX ? JOYSTICK_CURVE_MAX : curve));
+        setjoystickPeriodMS(period < JOYSTICK_PERIOD_MIN_MS ? JOYSTICK_PERIOD_MIN_MS : (period > JOYSTICK_PERIOD_MAX_MS ? JOYSTICK_PERIOD_MAX_MS : period));
+    }
+    JoystickConfigPacket reply(false, (JoystickMode)getjoystickMode(), getjoystickDeadzone(), getjoystickCurve(), getjoystickPeriodMS());
+    sendReply(con_handle, packet, &reply);
+}
 
-        // memcpy(rest_characteristic_data, presetPacket.tx(), BTOAS_PACKET_SIZE);
-        // att_server_notify_SAFE(con_handle, rest_characteristic_value_handle, rest_characteristic_data, BTOAS_PACKET_SIZE);
+static void handleGamepadMap(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    GamepadMapPacket *recpkt = (GamepadMapPacket *)packet;
+    GamepadMapPacket reply(recpkt->getCommand(), recpkt->getIndex());
+    GamepadMapStatus status = GAMEPADMAP_STATUS_OK;
+    switch (recpkt->getCommand())
+    {
+    case GAMEPADMAPCMD_GET:
+    {
+        GamepadBinding binding;
+        if (gamepadMapGet(recpkt->getIndex(), &binding))
+        {
+            reply.setBinding(&binding);
+        }
+        else
+        {
+            status = GAMEPADMAP_STATUS_BAD_INDEX;
+        }
         break;
     }
-    case BTOasIdentifier::MAINTAINPRESSURE:
-        setmaintainPressure(((MaintainPressurePacket *)packet)->getBoolean());
+    case GAMEPADMAPCMD_SET:
+    {
+        GamepadBinding binding;
+        recpkt->getBinding(&binding);
+        status = gamepadMapSet(recpkt->getIndex(), &binding);
         break;
-    case BTOasIdentifier::COMPRESSORSTATUS:
-        // TODO: THIS MIGHT HAVE THREADING ISSUES BUT IDK
-        getCompressor()->enableDisableOverride(((CompressorStatusPacket *)packet)->getBoolean());
+    }
+    case GAMEPADMAPCMD_REMOVE:
+        status = gamepadMapRemove(recpkt->getIndex());
         break;
-    case BTOasIdentifier::AISTATUSENABLED:
-        setaiEnabled(((AIStatusPacket *)packet)->getBoolean());
+    case GAMEPADMAPCMD_RESET:
+        gamepadMapReset();
         break;
-    case BTOasIdentifier::GETCONFIGVALUES:
-    {
-        ConfigValuesPacket *recpkt = (ConfigValuesPacket *)packet;
-        if (*recpkt->_setValues())
-        {
-            setbagMaxPressure(*recpkt->_bagMaxPressure());
-            setsystemShutoffTimeM(*recpkt->_systemShutoffTimeM());
-            setcompressorOnPSI(*recpkt->_compressorOnPSI());
-            setcompressorOffPSI(*recpkt->_compressorOffPSI());
-            setpressureSensorMax(*recpkt->_pressureSensorMax());
-            setbagVolumePercentage(*recpkt->_bagVolumePercentage());
-        }
-        ConfigValuesPacket pkt(false, getbagMaxPressure(), getsystemShutoffTimeM(), getcompressorOnPSI(), getcompressorOffPSI(), getpressureSensorMax(), getbagVolumePercentage());
-        packetMover::sendRestPacket(&pkt, con_handle);
-        //  memcpy(rest_characteristic_data, pkt.tx(), BTOAS_PACKET_SIZE);
-        //  att_server_notify_SAFE(con_handle, rest_characteristic_value_handle, rest_characteristic_data, BTOAS_PACKET_SIZE);
+    default:
+        status = GAMEPADMAP_STATUS_INVALID;
         break;
     }
-    case BTOasIdentifier::AUTHPACKET:
-        if (((AuthPacket *)packet)->getBleAuthResult() == AuthResult::AUTHRESULT_UPDATEKEY)
-        {
-            if (((AuthPacket *)packet)->getBlePasskey() != getblePasskey())
-            {
-                setblePasskey(((AuthPacket *)packet)->getBlePasskey());
-            }
-        }
-        break;
-    case BTOasIdentifier::BROADCASTNAME:
+    reply.setCount(gamepadMapCount());
+    reply.setStatus(status);
+    sendReply(con_handle, packet, &reply);
+}
 
-        if (((BroadcastNamePacket *)packet)->getBroadcastName() != getbleName())
-        {
-            setbleName(((BroadcastNamePacket *)packet)->getBroadcastName());
-            Serial.print("new broacast name:");
-            Serial.println(getbleName());
-        }
-        break;
-    case BTOasIdentifier::BP32PKT:
+static void handleBatch(hci_con_handle_t con_handle, BTOasPacket *packet); // down by dispatchPacket, it runs each packet back through the table
+
+static const PacketHandlerEntry packetHandlers[] = {
+    {IDLE, 0, PACKET_AUTH_CLIENT, nullptr},
+    {ASSIGNRECEPIENT, 0, PACKET_AUTH_CLIENT, nullptr}, // ignore from server
+    {MESSAGE, 0, PACKET_AUTH_CLIENT, nullptr},         // ignore from server
+    {AIRUP, 0, PACKET_AUTH_CLIENT, handleAirUp},
+    {AIROUT, 0, PACKET_AUTH_CLIENT, handleAirOut},
+    {AIRSM, 4, PACKET_AUTH_CLIENT, handleAirSM},
+    {SAVETOPROFILE, 4, PACKET_AUTH_CLIENT, handleSaveToProfile},
+    {SAVECURRENTPRESSURESTOPROFILE, 4, PACKET_AUTH_CLIENT, handleSaveCurrentPressuresToProfile},
+    {READPROFILE, 4, PACKET_AUTH_CLIENT, handleReadProfile},
+    {AIRUPQUICK, 4, PACKET_AUTH_CLIENT, handleAirUpQuick},
+    {BASEPROFILE, 4, PACKET_AUTH_CLIENT, handleBaseProfile},
+    {SETAIRHEIGHT, 8, PACKET_AUTH_CLIENT, handleSetAirHeight},
+    {RISEONSTART, 4, PACKET_AUTH_CLIENT, handleRiseOnStart},
+#if ENABLE_AIR_OUT_ON_SHUTOFF
+    {FALLONSHUTDOWN, 4, PACKET_AUTH_CLIENT, handleFallOnShutdown},
+#endif
+    {HEIGHTSENSORMODE, 4, PACKET_AUTH_CLIENT, handleHeightSensorMode},
+    {SAFETYMODE, 4, PACKET_AUTH_CLIENT, handleSafetyMode},
+    {DETECTPRESSURESENSORS, 0, PACKET_AUTH_CLIENT, handleDetectPressureSensors},
+    {RAISEONPRESSURESET, 4, PACKET_AUTH_CLIENT, handleRaiseOnPressureSet},
+    {REBOOT, 0, PACKET_AUTH_CLIENT, handleReboot},
+    {TURNOFF, 0, PACKET_AUTH_CLIENT, handleTurnOff},
+    {RESETAIPKT, 0, PACKET_AUTH_CLIENT, handleResetAI},
+    {CALIBRATE, 0, PACKET_AUTH_CLIENT, handleCalibrate},
+    {STARTWEB, 1, PACKET_AUTH_CLIENT, handleStartWeb}, // no ssid, no update
+    {PRESETREPORT, 10, PACKET_AUTH_CLIENT, handlePresetReport},
+    {MAINTAINPRESSURE, 4, PACKET_AUTH_CLIENT, handleMaintainPressure},
+    {COMPRESSORSTATUS, 4, PACKET_AUTH_CLIENT, handleCompressorStatus},
+    {AISTATUSENABLED, 4, PACKET_AUTH_CLIENT, handleAIStatusEnabled},
+    {GETCONFIGVALUES, 12, PACKET_AUTH_CLIENT, handleConfigValues},
+    {AUTHPACKET, 8, PACKET_AUTH_NONE, handleAuth}, // passkey and result, older clients don't send capabilities
+    {BROADCASTNAME, 1, PACKET_AUTH_CLIENT, handleBroadcastName}, // a blank name would make us invisible
+    {BP32PKT, 4, PACKET_AUTH_CLIENT, handleBP32},
+    {UPDATESTATUSREQUEST, 0, PACKET_AUTH_CLIENT, handleUpdateStatusRequest},
+    {BOOTTIMINGS, 0, PACKET_AUTH_CLIENT, handleBootTimings},
+    {TELEMETRYPKT, 0, PACKET_AUTH_CLIENT, handleTelemetry}, // export at offset 0 gets trimmed down to nothing
+    {STATUSRATE, 6, PACKET_AUTH_CLIENT, handleStatusRate},
+    {VALVEPULSE, 20, PACKET_AUTH_CLIENT, handleValvePulse},
+    {STATUSDELTA, 0, PACKET_AUTH_CLIENT, handleStatusDelta},
+    {BATCH, 1, PACKET_AUTH_CLIENT, handleBatch},
+    {BULKPKT, 14, PACKET_AUTH_CLIENT, handleBulk},
+    {STATESYNC, 0, PACKET_AUTH_CLIENT, handleStateSync}, // a client with nothing cached sends no payload
+    {PINGPKT, 0, PACKET_AUTH_CLIENT, handlePing}, // a ping with sequence 0 and no times yet is all 0s
+    {JOYSTICKCONFIG, 6, PACKET_AUTH_CLIENT, handleJoystickConfig},
+    {GAMEPADMAP, 2, PACKET_AUTH_CLIENT, handleGamepadMap},
+};
+
+// ~40 entries, a straight search is quicker than the write that got us here
+static const PacketHandlerEntry *findPacketHandler(uint16_t cmd)
+{
+    for (size_t i = 0; i < sizeof(packetHandlers) / sizeof(packetHandlers[0]); i++)
     {
-        BP32CMD bp32cmd = (BP32CMD)((BP32Packet *)packet)->args16()[0].i;
-        bool bp32val = ((BP32Packet *)packet)->args16()[1].i;
-        switch (bp32cmd)
+        if (packetHandlers[i].cmd == cmd)
         {
-        case BP32CMD::BP32CMD_ENABLE_NEW_CONN:
-            Serial.println("Enabling new connections!");
-            bp32_setAllowNewConnections(bp32val);
-            break;
-        case BP32CMD::BP32CMD_FORGET_DEVICES:
-            Serial.println("Forgetting controllers!");
-            bp32_forgetDevices();
-            break;
-        case BP32CMD::BP32CMD_DISCONNECT_DEVICES:
-            Serial.println("disconnecting controllers!");
-            bp32_disconnectControllers();
-            break;
+            return &packetHandlers[i];
         }
     }
-    break;
-    case UPDATESTATUSREQUEST:
+    return nullptr;
+}
+
+// length is how many bytes the client actually wrote, packet has already been 0 filled out to BTOAS_PACKET_SIZE
+static BatchStatus dispatchPacket(hci_con_handle_t con_handle, BTOasPacket *packet, uint16_t length, bool inBatch)
+{
+    const PacketHandlerEntry *entry = findPacketHandler(packet->cmd);
+    if (entry == nullptr)
+    {
+        log_i("Unknown packet %i from %i", packet->cmd, con_handle);
+        return BATCH_STATUS_UNKNOWN;
+    }
+    // a batch only gets checked once, so anything that does its own auth checking can't ride along in one
+    if (inBatch && (entry->auth == PACKET_AUTH_NONE || entry->cmd == BATCH))
+    {
+        return BATCH_STATUS_NOT_ALLOWED;
+    }
+    if (entry->auth == PACKET_AUTH_CLIENT && !isAuthed(con_handle))
     {
-        UpdateStatusRequestPacket pkt;
-        byte updateResult = getupdateResult();
-        switch (updateResult)
+        return BATCH_STATUS_NOT_ALLOWED; // not authed yet, just drop it
+    }
+    if (length < BTOAS_HEADER_SIZE + entry->minPayloadSize)
+    {
+        log_i("Packet %i from %i too short, %i bytes", packet->cmd, con_handle, length);
+        return BATCH_STATUS_TOO_SHORT;
+    }
+    if (entry->handler != nullptr)
+    {
+        entry->handler(con_handle, packet);
+    }
+    return BATCH_STATUS_OK;
+}
+
+static void handleBatch(hci_con_handle_t con_handle, BTOasPacket *packet)
+{
+    BatchPacket *batch = (BatchPacket *)packet;
+    uint8_t count = batch->getCount();
+    if (count > BATCH_MAX_PACKETS)
+    {
+        count = BATCH_MAX_PACKETS;
+    }
+
+    BatchPacket reply;
+    reply.setCount(count);
+    int offset = BATCH_FIRST_OFFSET;
+    bool failed = false;
+    for (int i = 0; i < count; i++)
+    {
+        if (failed)
         {
-        case UPDATE_STATUS::UPDATE_STATUS_FAIL_FILE_REQUEST:
-            pkt.setStatus("[F] FW DL");
-            break;
-        case UPDATE_STATUS::UPDATE_STATUS_FAIL_GENERIC:
-            pkt.setStatus("[F] Install");
-            break;
-        case UPDATE_STATUS::UPDATE_STATUS_FAIL_VERSION_REQUEST:
-            pkt.setStatus("[F] Finding");
-            break;
-        case UPDATE_STATUS::UPDATE_STATUS_FAIL_WIFI_CONNECTION:
-            pkt.setStatus("[F] No WiFi");
-            break;
-        case UPDATE_STATUS::UPDATE_STATUS_FAIL_ALREADY_UP_TO_DATE:
-        case UPDATE_STATUS::UPDATE_STATUS_NONE:
-        case UPDATE_STATUS::UPDATE_STATUS_SUCCESS:
-            pkt.setStatus("v" EVALUATE_AND_STRINGIFY(RELEASE_VERSION));
-            break;
+            reply.setStatus(i, BATCH_STATUS_SKIPPED);
+            continue;
         }
+        BTOasPacket sub;
+        uint16_t length = 0;
+        offset = batch->readPacket(offset, &sub, &length);
+        if (sub.requestId != 0)
+        {
+            sub.requestId += 1 + i;
+        }
+        BatchStatus status = offset < 0 ? BATCH_STATUS_TOO_SHORT : dispatchPacket(con_handle, &sub, length, true);
+        reply.setStatus(i, status);
+        failed = status != BATCH_STATUS_OK;
+    }
+    sendReply(con_handle, packet, &reply);
+}
 
-        packetMover::sendRestPacket(&pkt, con_handle);
+// Returns 0 or the ATT error to send back
+int runReceivedPacket(hci_con_handle_t con_handle, BTOasPacket *packet, uint16_t length)
+{
+    if (isAuthed(con_handle))
+    {
+        notifyKeepAlive();
+        linkActivity();
     }
+
+    // nothing to reply with outside of a batch except for a short write, everything else gets ignored like it always has
+    if (dispatchPacket(con_handle, packet, length, false) == BATCH_STATUS_TOO_SHORT)
+    {
+        return ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
     }
+    return 0;
 }
 
-#endif
\ No newline at end of file
+#pragma endregion
+
+#endif
@@ -27,6 +27,7 @@
 
 #include "airSuspensionUtil.h"
 #include <BTOas.h>
+#include <packetQueue.h>
 #include "components/manifold.h"
 #include "tasks/tasks.h"
 #include <vector>
@@ -34,7 +35,7 @@
 #include "oasman_service.gatt.h"
 
 #include <unordered_map>
-#include <set>
+#include <atomic>
 
 #include "bp32.h"
 
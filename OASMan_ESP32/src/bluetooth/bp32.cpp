@@ -5,6 +5,10 @@
 // http://retro.moe/unijoysticle2
 
 #include "bp32.h"
+#include "valveDuty.h"
+#include "gamepadMap.h"
+#include "allowedDevices.h"
+#include <BTOas.h>
 
 //
 // README FIRST, README FIRST, README FIRST
@@ -31,10 +35,14 @@ struct OASMANJoystickState
 {
     bool up, down, left, right = false;
     bool rup, rdown, rleft, rright = false;
+    uint16_t duty[SOLENOID_COUNT] = {}; // proportional mode, what this controller wants each valve at
 };
 // OASMANControllerData previousControllerData[BP32_MAX_GAMEPADS];
 OASMANJoystickState oasmanJoystickState[BP32_MAX_GAMEPADS];
 
+void releaseJoystick(int index);
+void releaseGamepadMap(int index, bool disconnected);
+
 // This callback gets called any time a new gamepad is connected.
 // Up to 4 gamepads can be connected at the same time.
 void onConnectedController(ControllerPtr ctl)
@@ -58,6 +66,7 @@ void onConnectedController(ControllerPtr ctl)
             Serial.printf("Controller model: %s, VID=0x%04x, PID=0x%04x, BTAddr=%02x:%02x:%02x:%02x:%02x:%02x\n", ctl->getModelName(), properties.vendor_id,
                           properties.product_id, properties.btaddr[0], properties.btaddr[1], properties.btaddr[2], properties.btaddr[3], properties.btaddr[4], properties.btaddr[5]);
             myControllers[i] = ctl;
+            allowedDeviceSeen(properties.btaddr, ctl->getModelName().c_str());
             foundEmptySlot = true;
             // previousControllerData[i] = {0};
             break;
@@ -81,6 +90,8 @@ void onDisconnectedController(ControllerPtr ctl)
         if (myControllers[i] == ctl)
         {
             Serial.printf("CALLBACK: Controller disconnected from index=%d\n", i);
+            releaseJoystick(ctl->index()); // don't leave anything it was holding open
+            releaseGamepadMap(ctl->index(), true);
             myControllers[i] = nullptr;
             foundController = true;
             break;
@@ -185,12 +196,58 @@ void dumpBalanceBoard(ControllerPtr ctl)
     );
 }
 
+#pragma region input latency
+
+// How long a stick movement can sit before it reaches the valves. Bluepad32's arduino side has no callback for new data,
+// BP32.update() just says something came in since the last call, so bp32_loop polls it every tick. The data showed up
+// some time after the poll before it, so the time from that poll to the gpio write is the worst it could have been
+#define BP32_POLL_TICKS 1
+#define BP32_LATENCY_REPORT_MS 10000
+
+static unsigned long bp32PrevPollUS = 0;   // last poll that came back empty
+static unsigned long bp32DataSeenUS = 0;   // poll that found the data being processed now
+static uint32_t latencyCount = 0;
+static uint64_t latencySumUS = 0;
+static uint32_t latencyMaxUS = 0;
+static uint32_t processingMaxUS = 0;
+static bool latencyPaused = false;
+
+// a joystick valve just opened or closed. No printing here, it's between valve writes. reportInputLatency prints the totals
+void recordInputLatency()
+{
+    if (latencyPaused)
+    {
+        return;
+    }
+    unsigned long now = micros();
+    uint32_t latency = now - bp32PrevPollUS;
+    uint32_t processing = now - bp32DataSeenUS;
+    latencyCount++;
+    latencySumUS += latency;
+    latencyMaxUS = latency > latencyMaxUS ? latency : latencyMaxUS;
+    processingMaxUS = processing > processingMaxUS ? processing : processingMaxUS;
+}
+
+void reportInputLatency()
+{
+    static unsigned long lastReport = 0;
+    static uint32_t lastReportCount = 0;
+    if (millis() - lastReport < BP32_LATENCY_REPORT_MS || latencyCount == lastReportCount)
+    {
+        return;
+    }
+    lastReport = millis();
+    lastReportCount = latencyCount;
+    Serial.printf("BP32 input to valve: avg %uus max %uus, processing max %uus (%u changes)\n", (uint32_t)(latencySumUS / latencyCount), latencyMaxUS, processingMaxUS, latencyCount);
+}
+
+#pragma endregion
+
 #pragma region joystick stuff
 
 int player = 0;
 int battery = 0;
 bool armed = true;
-bool armedIsHeldDown = false;
 
 void runJoystickInput(bool *val,
                       Solenoid *a,
@@ -201,10 +258,10 @@ void runJoystickInput(bool *val,
         // open valve for left and set oasmanJoystickState flag
         a->open();
         b->open();
-        // if (*val != true)
-        // {
-        //     Serial.println("Opening valve");
-        // }
+        if (*val != true)
+        {
+            recordInputLatency();
+        }
         *val = true;
     }
     else
@@ -216,10 +273,89 @@ void runJoystickInput(bool *val,
             // Serial.println("Closing valve");
             a->close();
             b->close();
+            recordInputLatency();
         }
     }
 }
 
+#define JOYSTICK_AXIS_MAX 512
+#define JOYSTICK_ON_OFF_THRESHOLD 400
+
+static JoystickMode joystickModeInUse = JOYSTICK_MODE_ON_OFF;
+static uint16_t appliedDuty[SOLENOID_COUNT];
+
+// stick past the dead zone, through the curve, as a valve duty
+uint16_t joystickDuty(int32_t amount)
+{
+    int32_t deadzone = JOYSTICK_AXIS_MAX * getjoystickDeadzone() / 100;
+    if (amount <= deadzone)
+    {
+        return 0;
+    }
+    float magnitude = (float)(amount - deadzone) / (JOYSTICK_AXIS_MAX - deadzone);
+    if (magnitude > 1)
+    {
+        magnitude = 1;
+    }
+    uint16_t duty = powf(magnitude, getjoystickCurve() / 10.0f) * VALVE_DUTY_MAX;
+    return duty == 0 ? 1 : duty;
+}
+
+// one direction of one stick, amount is how far it's pushed that way. a and b are SOLENOID_INDEX
+void runJoystickDirection(OASMANJoystickState *thisJoystickState, bool *val, int a, int b, int32_t amount)
+{
+    if (joystickModeInUse != JOYSTICK_MODE_PROPORTIONAL)
+    {
+        runJoystickInput(val, getManifold()->get(a), getManifold()->get(b), amount >= JOYSTICK_ON_OFF_THRESHOLD);
+        return;
+    }
+    // directions share valves (left and up both fill the front driver), so each valve goes with whichever wants it most
+    uint16_t duty = joystickDuty(amount);
+    thisJoystickState->duty[a] = duty > thisJoystickState->duty[a] ? duty : thisJoystickState->duty[a];
+    thisJoystickState->duty[b] = duty > thisJoystickState->duty[b] ? duty : thisJoystickState->duty[b];
+    if (*val && duty == 0)
+    {
+        // the balance board still opens them straight, the scheduler only closes what it's running
+        if (!valveDutyActive(a))
+        {
+            getManifold()->get(a)->close();
+        }
+        if (!valveDutyActive(b))
+        {
+            getManifold()->get(b)->close();
+        }
+    }
+    *val = duty > 0;
+}
+
+// call before running both sticks of a controller
+void beginJoystickDuty(OASMANJoystickState *thisJoystickState)
+{
+    memset(thisJoystickState->duty, 0, sizeof(thisJoystickState->duty));
+}
+
+// and after, hands the combined duty of every controller to the valve scheduler
+void applyJoystickDuty()
+{
+    uint16_t period = getjoystickPeriodMS();
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        uint16_t duty = 0;
+        for (int c = 0; c < BP32_MAX_GAMEPADS; c++)
+        {
+            duty = oasmanJoystickState[c].duty[i] > duty ? oasmanJoystickState[c].duty[i] : duty;
+        }
+        if (duty != appliedDuty[i])
+        {
+            valveDutySet(i, duty, period);
+            appliedDuty[i] = duty;
+            recordInputLatency(); // proportional mode's valve write is this one, not where the stick gets read
+        }
+    }
+}
+
+void runJoystickAxes(OASMANJoystickState *thisJoystickState, int32_t x, int32_t y, bool right);
+
 void joystickLoop2(ControllerPtr ctl, bool right = false)
 {
 
@@ -250,35 +386,41 @@ void joystickLoop2(ControllerPtr ctl, bool right = false)
         }
     }
 
-    const int threshold = 400;
-
-    bool *val;
-    Solenoid *a;
-    Solenoid *b;
+    runJoystickAxes(thisJoystickState, x, y, right);
+}
 
+void runJoystickAxes(OASMANJoystickState *thisJoystickState, int32_t x, int32_t y, bool right)
+{
     // left
-    val = right ? &thisJoystickState->rleft : &thisJoystickState->left;
-    a = right ? getWheel(WHEEL_FRONT_PASSENGER)->getOutSolenoid() : getWheel(WHEEL_FRONT_DRIVER)->getInSolenoid();
-    b = right ? getWheel(WHEEL_REAR_PASSENGER)->getOutSolenoid() : getWheel(WHEEL_REAR_DRIVER)->getInSolenoid();
-    runJoystickInput(val, a, b, x <= -threshold);
+    runJoystickDirection(thisJoystickState, right ? &thisJoystickState->rleft : &thisJoystickState->left,
+                         right ? FRONT_PASSENGER_OUT : FRONT_DRIVER_IN, right ? REAR_PASSENGER_OUT : REAR_DRIVER_IN, -x);
 
     // right
-    val = right ? &thisJoystickState->rright : &thisJoystickState->right;
-    a = right ? getWheel(WHEEL_FRONT_PASSENGER)->getInSolenoid() : getWheel(WHEEL_FRONT_DRIVER)->getOutSolenoid();
-    b = right ? getWheel(WHEEL_REAR_PASSENGER)->getInSolenoid() : getWheel(WHEEL_REAR_DRIVER)->getOutSolenoid();
-    runJoystickInput(val, a, b, x >= threshold);
+    runJoystickDirection(thisJoystickState, right ? &thisJoystickState->rright : &thisJoystickState->right,
+                         right ? FRONT_PASSENGER_IN : FRONT_DRIVER_OUT, right ? REAR_PASSENGER_IN : REAR_DRIVER_OUT, x);
 
     // up
-    val = right ? &thisJoystickState->rup : &thisJoystickState->up;
-    a = right ? getWheel(WHEEL_REAR_DRIVER)->getInSolenoid() : getWheel(WHEEL_FRONT_DRIVER)->getInSolenoid();
-    b = right ? getWheel(WHEEL_REAR_PASSENGER)->getInSolenoid() : getWheel(WHEEL_FRONT_PASSENGER)->getInSolenoid();
-    runJoystickInput(val, a, b, y <= -threshold);
+    runJoystickDirection(thisJoystickState, right ? &thisJoystickState->rup : &thisJoystickState->up,
+                         right ? REAR_DRIVER_IN : FRONT_DRIVER_IN, right ? REAR_PASSENGER_IN : FRONT_PASSENGER_IN, -y);
 
     // down
-    val = right ? &thisJoystickState->rdown : &thisJoystickState->down;
-    a = right ? getWheel(WHEEL_REAR_DRIVER)->getOutSolenoid() : getWheel(WHEEL_FRONT_DRIVER)->getOutSolenoid();
-    b = right ? getWheel(WHEEL_REAR_PASSENGER)->getOutSolenoid() : getWheel(WHEEL_FRONT_PASSENGER)->getOutSolenoid();
-    runJoystickInput(val, a, b, y >= threshold);
+    runJoystickDirection(thisJoystickState, right ? &thisJoystickState->rdown : &thisJoystickState->down,
+                         right ? REAR_DRIVER_OUT : FRONT_DRIVER_OUT, right ? REAR_PASSENGER_OUT : FRONT_PASSENGER_OUT, y);
+}
+
+// closes everything this controller had open. Covers the balance board too, it uses the same up/down valves
+void releaseJoystick(int index)
+{
+    if (index < 0 || index >= BP32_MAX_GAMEPADS)
+    {
+        return;
+    }
+    latencyPaused = true; // not from input, don't count it
+    beginJoystickDuty(&oasmanJoystickState[index]);
+    runJoystickAxes(&oasmanJoystickState[index], 0, 0, false);
+    runJoystickAxes(&oasmanJoystickState[index], 0, 0, true);
+    applyJoystickDuty();
+    latencyPaused = false;
 }
 
 #ifdef oldjoystickcode
@@ -582,27 +724,7 @@ void loadProfileAirUpQuick(int profileIndex)
     airUp(true);
 }
 
-uint8_t konamiIndex = 0;
 uint8_t konamiCompletions = 0;
-struct konamiInput
-{
-    int type;
-    int bit;
-};
-
-// 0 is ctl->dpad()
-// 1 is ctl->buttons()
-konamiInput konamiCode[] = {
-    {0, DPAD_UP},
-    {0, DPAD_UP},
-    {0, DPAD_DOWN},
-    {0, DPAD_DOWN},
-    {0, DPAD_LEFT},
-    {0, DPAD_RIGHT},
-    {0, DPAD_LEFT},
-    {0, DPAD_RIGHT},
-    {1, BUTTON_B},
-    {1, BUTTON_A}};
 
 void driverUpPassDown(int ms)
 {
@@ -650,46 +772,144 @@ void doDance()
     loadProfileAirUpQuick(2);
 }
 
-void updateKonami(ControllerPtr ctl)
+void konamiComplete(ControllerPtr ctl)
 {
-    if ((konamiCode[konamiIndex].type == 1 ? ctl->buttons() : ctl->dpad()) & konamiCode[konamiIndex].bit)
+    Serial.println("Konami code complete!");
+    konamiCompletions++;
+    ctl->playDualRumble(0 /* delayedStartMs */, 5000 /* durationMs */, 0x80 /* weakMagnitude */,
+                        0x40 /* strongMagnitude */);
+    if (konamiCompletions > 1)
     {
+        do_dance = true;
+    }
+}
+#pragma endregion
+
+#pragma region gamepad bindings
+static GamepadMapEvent gamepadEvents[GAMEPAD_MAP_MAX_EVENTS];
+static GamepadMapEvent releaseEvents[GAMEPAD_MAP_MAX_EVENTS]; // releases happen while gamepadEvents is being run
 
-        konamiIndex++;
-        Serial.print("Konami progress update: ");
-        Serial.println(konamiIndex);
-        if (konamiIndex == (sizeof(konamiCode) / sizeof(*konamiCode)))
+ControllerPtr findController(int index)
+{
+    for (auto myController : myControllers)
+    {
+        if (myController && myController->index() == index)
         {
-            Serial.println("Konami code complete!");
-            konamiCompletions++;
-            ctl->playDualRumble(0 /* delayedStartMs */, 5000 /* durationMs */, 0x80 /* weakMagnitude */,
-                                0x40 /* strongMagnitude */);
-            konamiIndex = 0;
-            if (konamiCompletions > 1)
+            return myController;
+        }
+    }
+    return nullptr;
+}
+
+// opens or closes every valve in a SOLENOID_INDEX mask
+void setBindingValves(int16_t mask, bool open)
+{
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        if (mask & (1 << i))
+        {
+            if (open)
             {
-                do_dance = true;
+                getManifold()->get(i)->open();
+            }
+            else
+            {
+                getManifold()->get(i)->close();
             }
         }
     }
-    else
+    recordInputLatency();
+}
+
+// false if it disconnected the controller, nothing else should run for it after that
+bool runGamepadEvent(GamepadMapEvent *event)
+{
+    GamepadBinding *binding = &event->binding;
+    if (!event->start)
+    {
+        setBindingValves(binding->arg, false);
+        return true;
+    }
+    // only these two work while disarmed, otherwise there'd be no way back
+    if (!armed && binding->action != GAMEPAD_ACTION_ARM_TOGGLE && binding->action != GAMEPAD_ACTION_DISCONNECT)
+    {
+        return true;
+    }
+    ControllerPtr ctl = findController(event->controller);
+    switch (binding->action)
     {
-        if (konamiIndex > 0)
+    case GAMEPAD_ACTION_PRESET:
+        loadProfileAirUpQuick(binding->arg);
+        break;
+    case GAMEPAD_ACTION_AIR_UP:
+        airUp();
+        break;
+    case GAMEPAD_ACTION_AIR_OUT:
+        airOut();
+        break;
+    case GAMEPAD_ACTION_RAISE:
+        airUpRelativeToAverage(binding->arg);
+        break;
+    case GAMEPAD_ACTION_VALVES:
+        setBindingValves(binding->arg, true);
+        break;
+    case GAMEPAD_ACTION_ARM_TOGGLE:
+        armed = !armed;
+        if (ctl)
         {
-            // check if a different button was pressed and reset konami code
-            if (ctl->buttons() != 0 || ctl->dpad() != 0)
+            ctl->playDualRumble(0 /* delayedStartMs */, 250 /* durationMs */, 0x80 /* weakMagnitude */,
+                                0x40 /* strongMagnitude */);
+        }
+        if (!armed)
+        {
+            // anything being held open by a binding goes too, not just the sticks
+            for (int i = 0; i < BP32_MAX_GAMEPADS; i++)
             {
-
-                // check if it's just the previous button that was pressed and don't reset it. our code doesn't perfectly decide if a button was a full press or just held down and this is a shortcut so i don't have to implement that functionality
-                if ((konamiCode[konamiIndex - 1].type == 1 ? ctl->buttons() : ctl->dpad()) & konamiCode[konamiIndex - 1].bit)
-                {
-                }
-                else
-                {
-                    konamiIndex = 0;
-                }
+                releaseGamepadMap(i, false);
             }
         }
+        break;
+    case GAMEPAD_ACTION_DISCONNECT:
+        Serial.println("Misc button pressed, controller disconnecting");
+        releaseJoystick(event->controller);
+        releaseGamepadMap(event->controller, false);
+        // reset armed state
+        armed = true;
+        if (ctl)
+        {
+            ctl->disconnect();
+        }
+        return false;
+    case GAMEPAD_ACTION_KONAMI:
+        if (ctl)
+        {
+            konamiComplete(ctl);
+        }
+        break;
     }
+    return true;
+}
+
+bool runGamepadEvents(GamepadMapEvent *events, int count)
+{
+    bool connected = true;
+    for (int i = 0; i < count; i++)
+    {
+        connected = runGamepadEvent(&events[i]) && connected;
+    }
+    return connected;
+}
+
+void releaseGamepadMap(int index, bool disconnected)
+{
+    if (index < 0 || index >= BP32_MAX_GAMEPADS)
+    {
+        return;
+    }
+    // stop events only close valves, they can't come back in here
+    latencyPaused = true;
+    runGamepadEvents(releaseEvents, gamepadMapRelease(index, disconnected, releaseEvents));
+    latencyPaused = false;
 }
 #pragma endregion
 
@@ -749,47 +969,27 @@ void processGamepad(ControllerPtr ctl)
 
     // // See ArduinoController.h for all the available functions.
 
-    // on off button
-    if (ctl->miscSystem()) // pressing the system button on the controller
+    // buttons, see gamepadMap for what each one does. Only costs anything when something got pressed or let go
+    uint32_t inputs = (ctl->buttons() & 0xFFFF) | ((uint32_t)(ctl->dpad() & 0xF) << GAMEPAD_INPUT_DPAD_SHIFT) |
+                      ((uint32_t)(ctl->miscButtons() & 0xF) << GAMEPAD_INPUT_MISC_SHIFT);
+    if (!runGamepadEvents(gamepadEvents, gamepadMapFrame(ctl->index(), inputs, millis(), gamepadEvents)))
     {
-        Serial.println("Misc button pressed, controller disconnecting");
-        ctl->disconnect();
-
-        // reset armed state
-        armedIsHeldDown = false;
-        armed = true;
         return;
     }
 
-    // check arming
-    if (ctl->r1() && ctl->l1())
-    {
-        if (armedIsHeldDown == false)
-        {
-            // this means we just pressed them, flip value of armed
-            armed = !armed;
-            ctl->playDualRumble(0 /* delayedStartMs */, 250 /* durationMs */, 0x80 /* weakMagnitude */,
-                                0x40 /* strongMagnitude */);
-        }
-        armedIsHeldDown = true;
-    }
-    else
-    {
-        armedIsHeldDown = false;
-    }
-
     if (!armed)
     {
+        releaseJoystick(ctl->index()); // disarming while holding a stick shouldn't leave the valves going
         return;
     }
 
     // okay armed, let code run
 
-    updateKonami(ctl);
-
     // joystickLoop(ctl);
+    beginJoystickDuty(&oasmanJoystickState[ctl->index()]);
     joystickLoop2(ctl, false);
     joystickLoop2(ctl, true);
+    applyJoystickDuty();
     // getManifold()->debugOut();
 }
 
@@ -997,6 +1197,18 @@ void processBalanceBoardLeft(ControllerPtr ctl)
 
 void processControllers()
 {
+    // switching modes lets go of everything first, otherwise valves the old mode opened never get closed by the new one
+    JoystickMode mode = (JoystickMode)getjoystickMode();
+    if (mode != joystickModeInUse)
+    {
+        for (int i = 0; i < BP32_MAX_GAMEPADS; i++)
+        {
+            releaseJoystick(i);
+        }
+        joystickModeInUse = mode;
+        log_i("Joystick mode %i", mode);
+    }
+
     for (auto myController : myControllers)
     {
         if (myController && myController->isConnected() && myController->hasData())
@@ -1076,92 +1288,57 @@ void bp32_loop()
 {
     // This call fetches all the controllers' data.
     // Call this function in your main loop.
+    // It only copies whatever bluepad32 got since last time, so it's cheap enough to call every tick. Presses and releases
+    // both go straight through to the valves from here, nothing sits around waiting for the next loop
+    unsigned long pollUS = micros();
     bool dataUpdated = BP32.update();
     if (dataUpdated)
+    {
+        bp32DataSeenUS = pollUS;
         processControllers();
+    }
+    bp32PrevPollUS = pollUS;
+
+    runGamepadEvents(gamepadEvents, gamepadMapTick(millis(), gamepadEvents)); // long presses
+
+    reportInputLatency();
 
     // The main loop must have some kind of "yield to lower priority task" event.
     // Otherwise, the watchdog will get triggered.
-    // If your main loop doesn't have one, just add a simple `vTaskDelay(1)`.
     // Detailed info here:
     // https://stackoverflow.com/questions/66278271/task-watchdog-got-triggered-the-tasks-did-not-reset-the-watchdog-in-time
-
-    delay(100);
+    vTaskDelay(BP32_POLL_TICKS);
 }
 
-struct BTDeviceMac
-{
-    uint8_t addr[6];
-};
-#define MAX_ALLOWED_BLUETOOTH_DEVICES 20
-static BTDeviceMac allowedBluetoothDevices[MAX_ALLOWED_BLUETOOTH_DEVICES];
-
-#define BLUETOOTH_SAVED_DEVICES_FILE "/allowed_bt_devices.dat"
 void clearAllowedBluetoothDevices()
 {
-    deleteFile(BLUETOOTH_SAVED_DEVICES_FILE);
-    loadAllowedBluetoothDevices();
+    clearAllowedDevices();
 }
 void loadAllowedBluetoothDevices()
 {
     Serial.println("Loading allowed Bluetooth devices...");
-    memset(allowedBluetoothDevices, 0, sizeof(allowedBluetoothDevices));
-    readBytes(BLUETOOTH_SAVED_DEVICES_FILE, allowedBluetoothDevices, sizeof(allowedBluetoothDevices));
-}
-
-void addAllowedBluetoothDevice(const uint8_t *addr)
-{
-    bool written = false;
-    for (int i = 0; i < MAX_ALLOWED_BLUETOOTH_DEVICES; i++)
-    {
-        if (allowedBluetoothDevices[i].addr[0] == 0 && allowedBluetoothDevices[i].addr[1] == 0 &&
-            allowedBluetoothDevices[i].addr[2] == 0 && allowedBluetoothDevices[i].addr[3] == 0 &&
-            allowedBluetoothDevices[i].addr[4] == 0 && allowedBluetoothDevices[i].addr[5] == 0) // could have just converted the 4 bytes to an int32 and checked if 0 and probably been fine but figure'd why not be exact
-        {
-            memcpy(allowedBluetoothDevices[i].addr, addr, 6);
-            written = true;
-            break;
-        }
-    }
-    if (written)
-    {
-        writeBytes(BLUETOOTH_SAVED_DEVICES_FILE, allowedBluetoothDevices, sizeof(allowedBluetoothDevices));
-    }
-    else
-    {
-        Serial.println("BP32: No space left to add new Bluetooth device.");
-    }
+    loadAllowedDevices();
 }
 
 bool isBTDeviceARegisteredController(const uint8_t *addr)
 {
-    for (int i = 0; i < MAX_ALLOWED_BLUETOOTH_DEVICES; i++)
-    {
-        if (memcmp(allowedBluetoothDevices[i].addr, addr, 6) == 0)
-        {
-            return true;
-        }
-    }
-    return false;
+    return allowedDeviceFind(addr);
 }
 
 bool areNewConnectionsAllowed = false;
 bool checkAndAllowBluetoothDevice(const uint8_t *addr)
 {
-    for (int i = 0; i < MAX_ALLOWED_BLUETOOTH_DEVICES; i++)
+    if (allowedDeviceFind(addr))
     {
-        if (memcmp(allowedBluetoothDevices[i].addr, addr, 6) == 0)
-        {
-            Serial.printf("BP32: Allowing previously accepted device: %02x:%02x:%02x:%02x:%02x:%02x\n",
-                          addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
-            return true;
-        }
+        Serial.printf("BP32: Allowing previously accepted device: %02x:%02x:%02x:%02x:%02x:%02x\n",
+                      addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
+        return true;
     }
     if (areNewConnectionsAllowed)
     {
         Serial.printf("BP32: Allowing new device: %02x:%02x:%02x:%02x:%02x:%02x\n",
                       addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
-        addAllowedBluetoothDevice(addr);
+        allowedDeviceAdd(addr);
         return true;
     }
     return false;
@@ -1182,7 +1359,7 @@ void bp32_forgetDevices()
 {
     Serial.println("Forgetting Bluetooth keys...");
     BP32.forgetBluetoothKeys();
-    clearAllowedBluetoothDevices(); // delete our saved file of bt macs
+    clearAllowedBluetoothDevices(); // forget our saved table of bt macs too
 
     // disconnect all currently connected controllers
     bp32_disconnectControllers();
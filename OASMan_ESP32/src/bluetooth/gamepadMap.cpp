@@ -0,0 +1,595 @@
+#include "gamepadMap.h"
+#include "bp32.h"
+#include "preferencable.h"
+
+#define GAMEPAD_MAP_VERSION 1
+#define GAMEPAD_MAP_TABLE_BITS 7
+#define GAMEPAD_MAP_TABLE_SIZE (1 << GAMEPAD_MAP_TABLE_BITS)
+#define GAMEPAD_MAP_TABLE_FILL (GAMEPAD_MAP_TABLE_SIZE * 3 / 4) // past this the probes start getting long
+#define GAMEPAD_MAP_NONE 0xFF
+#define GAMEPAD_MAP_INPUT_BITS 0x00FFFFFF // keys keep the node and kind above this
+
+enum GamepadMapKeyKind
+{
+    KEY_PRESS,
+    KEY_LONG_PRESS,
+    KEY_SEQUENCE, // node is where the sequence is so far, value is the node it moves to
+};
+
+struct GamepadMapSlot
+{
+    uint32_t key;
+    uint8_t value;
+    bool used;
+};
+
+struct GamepadMapCompiled
+{
+    GamepadMapSlot table[GAMEPAD_MAP_TABLE_SIZE];
+    uint16_t tableUsed;
+    uint8_t nodeCount; // node 0 is the root, nothing pressed yet
+    uint8_t nodeParent[GAMEPAD_MAP_MAX_NODES];
+    uint8_t nodeDepth[GAMEPAD_MAP_MAX_NODES];
+    uint32_t nodeInputs[GAMEPAD_MAP_MAX_NODES];  // what got pressed to get here from the parent
+    uint8_t nodeBinding[GAMEPAD_MAP_MAX_NODES];  // sequence that finishes here
+    uint8_t nodeFail[GAMEPAD_MAP_MAX_NODES];     // longest end of this sequence that's the start of another one
+    uint8_t nodeFinishes[GAMEPAD_MAP_MAX_NODES]; // sequence that finishes here or at the end of one of the fail links
+};
+
+struct GamepadMapState
+{
+    uint32_t held;
+    uint8_t tap;       // press binding held back until it's clear it isn't a long press
+    uint8_t longPress; // waiting on longDue
+    unsigned long longDue;
+    uint8_t sequenceNode;
+    unsigned long sequenceTime;
+    bool holding; // holdBinding is a VALVES binding that runs until its inputs are let go
+    GamepadBinding holdBinding; // a copy so editing the bindings can't pull it out from under us
+};
+
+struct GamepadMapFile
+{
+    uint8_t version;
+    uint8_t count;
+    uint16_t reserved;
+    GamepadBinding bindings[GAMEPAD_MAP_MAX_BINDINGS];
+};
+
+static GamepadBinding bindings[GAMEPAD_MAP_MAX_BINDINGS];
+static uint8_t bindingCount = 0;
+static GamepadMapCompiled compiled;
+static GamepadMapState states[BP32_MAX_GAMEPADS];
+static SemaphoreHandle_t gamepadMapMutex;
+
+// only used while editing, which only happens on one task at a time. Too big for the stack
+static GamepadBinding editBindings[GAMEPAD_MAP_MAX_BINDINGS];
+static GamepadMapCompiled editCompiled;
+static GamepadMapFile mapFile;
+
+#pragma region compiling
+
+static uint32_t makeKey(GamepadMapKeyKind kind, uint8_t node, uint32_t inputs)
+{
+    return inputs | ((uint32_t)node << 24) | ((uint32_t)kind << 30);
+}
+
+static int lookup(const GamepadMapCompiled *map, uint32_t key)
+{
+    uint32_t slot = (key * 2654435761u) >> (32 - GAMEPAD_MAP_TABLE_BITS);
+    while (map->table[slot].used)
+    {
+        if (map->table[slot].key == key)
+        {
+            return map->table[slot].value;
+        }
+        slot = (slot + 1) & (GAMEPAD_MAP_TABLE_SIZE - 1);
+    }
+    return -1;
+}
+
+// caller has already checked there's room and it isn't in there
+static void insert(GamepadMapCompiled *map, uint32_t key, uint8_t value)
+{
+    uint32_t slot = (key * 2654435761u) >> (32 - GAMEPAD_MAP_TABLE_BITS);
+    while (map->table[slot].used)
+    {
+        slot = (slot + 1) & (GAMEPAD_MAP_TABLE_SIZE - 1);
+    }
+    map->table[slot].key = key;
+    map->table[slot].value = value;
+    map->table[slot].used = true;
+    map->tableUsed++;
+}
+
+static void clearCompiled(GamepadMapCompiled *map)
+{
+    memset(map, 0, sizeof(GamepadMapCompiled));
+    map->nodeCount = 1;
+    map->nodeBinding[0] = GAMEPAD_MAP_NONE;
+    map->nodeFinishes[0] = GAMEPAD_MAP_NONE;
+}
+
+static uint8_t bindingSteps(const GamepadBinding *binding)
+{
+    return binding->trigger == GAMEPAD_TRIGGER_SEQUENCE ? binding->steps : 1;
+}
+
+// the inputs that have to stay held for a VALVES binding
+static uint32_t bindingHeldInputs(const GamepadBinding *binding)
+{
+    return binding->inputs[bindingSteps(binding) - 1];
+}
+
+static bool validBinding(const GamepadBinding *binding)
+{
+    if (binding->trigger > GAMEPAD_TRIGGER_SEQUENCE || binding->action == GAMEPAD_ACTION_NONE || binding->action > GAMEPAD_ACTION_KONAMI)
+    {
+        return false;
+    }
+    uint8_t steps = bindingSteps(binding);
+    if (steps == 0 || steps > GAMEPAD_SEQUENCE_MAX)
+    {
+        return false;
+    }
+    for (int i = 0; i < steps; i++)
+    {
+        if (binding->inputs[i] == 0 || (binding->inputs[i] & ~GAMEPAD_MAP_INPUT_BITS) != 0)
+        {
+            return false;
+        }
+    }
+    switch (binding->action)
+    {
+    case GAMEPAD_ACTION_PRESET:
+        return binding->arg >= 0 && binding->arg < MAX_PROFILE_COUNT;
+    case GAMEPAD_ACTION_VALVES:
+        return binding->arg > 0 && binding->arg < (1 << SOLENOID_COUNT);
+    default:
+        return true;
+    }
+}
+
+// adds list[index]. False if it's invalid, clashes with one that's already in or there's no room left. The map is untouched if so
+static bool compileBinding(GamepadMapCompiled *map, const GamepadBinding *list, uint8_t index)
+{
+    const GamepadBinding *binding = &list[index];
+    if (!validBinding(binding))
+    {
+        return false;
+    }
+    if (binding->trigger != GAMEPAD_TRIGGER_SEQUENCE)
+    {
+        bool press = binding->trigger == GAMEPAD_TRIGGER_PRESS;
+        uint32_t key = makeKey(press ? KEY_PRESS : KEY_LONG_PRESS, 0, binding->inputs[0]);
+        if (lookup(map, key) >= 0 || map->tableUsed >= GAMEPAD_MAP_TABLE_FILL)
+        {
+            return false;
+        }
+        // a press with a long press on the same inputs only runs once they're let go, too late to hold valves open
+        int other = lookup(map, makeKey(press ? KEY_LONG_PRESS : KEY_PRESS, 0, binding->inputs[0]));
+        if (other >= 0 && (press ? binding->action : list[other].action) == GAMEPAD_ACTION_VALVES)
+        {
+            return false;
+        }
+        insert(map, key, index);
+        return true;
+    }
+
+    // follow whatever part of it is already in the trie
+    uint8_t node = 0;
+    uint8_t step = 0;
+    for (; step < binding->steps; step++)
+    {
+        int next = lookup(map, makeKey(KEY_SEQUENCE, node, binding->inputs[step]));
+        if (next < 0)
+        {
+            break;
+        }
+        node = next;
+        if (map->nodeBinding[node] != GAMEPAD_MAP_NONE)
+        {
+            return false; // a shorter one finishes on the way, this one could never run
+        }
+    }
+    if (step == binding->steps)
+    {
+        return false; // the same one, or the start of a longer one
+    }
+    uint8_t newNodes = binding->steps - step;
+    if (map->nodeCount + newNodes > GAMEPAD_MAP_MAX_NODES || map->tableUsed + newNodes > GAMEPAD_MAP_TABLE_FILL)
+    {
+        return false;
+    }
+    for (; step < binding->steps; step++)
+    {
+        uint8_t child = map->nodeCount++;
+        map->nodeParent[child] = node;
+        map->nodeDepth[child] = step + 1;
+        map->nodeInputs[child] = binding->inputs[step];
+        map->nodeBinding[child] = GAMEPAD_MAP_NONE;
+        insert(map, makeKey(KEY_SEQUENCE, node, binding->inputs[step]), child);
+        node = child;
+    }
+    map->nodeBinding[node] = index;
+    return true;
+}
+
+// where a sequence at node goes when inputs get pressed. Falls back to shorter matches instead of starting over,
+// so up up up down still finds the up up down some other sequence starts with
+static uint8_t sequenceStep(const GamepadMapCompiled *map, uint8_t node, uint32_t inputs)
+{
+    while (true)
+    {
+        int next = lookup(map, makeKey(KEY_SEQUENCE, node, inputs));
+        if (next >= 0)
+        {
+            return next;
+        }
+        if (node == 0)
+        {
+            return 0;
+        }
+        node = map->nodeFail[node];
+    }
+}
+
+// fail links, shallowest nodes first since each one is built from its parent's
+static void finishCompile(GamepadMapCompiled *map)
+{
+    for (uint8_t depth = 1; depth <= GAMEPAD_SEQUENCE_MAX; depth++)
+    {
+        for (uint8_t node = 1; node < map->nodeCount; node++)
+        {
+            if (map->nodeDepth[node] != depth)
+            {
+                continue;
+            }
+            map->nodeFail[node] = depth == 1 ? 0 : sequenceStep(map, map->nodeFail[map->nodeParent[node]], map->nodeInputs[node]);
+            map->nodeFinishes[node] = map->nodeBinding[node] != GAMEPAD_MAP_NONE ? map->nodeBinding[node] : map->nodeFinishes[map->nodeFail[node]];
+        }
+    }
+}
+
+// everything or nothing, for edits
+static bool compileAll(const GamepadBinding *list, uint8_t count, GamepadMapCompiled *map)
+{
+    clearCompiled(map);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!compileBinding(map, list, i))
+        {
+            return false;
+        }
+    }
+    finishCompile(map);
+    return true;
+}
+
+// drops whatever doesn't fit, for loading. Returns how many are left
+static uint8_t compileSkipping(GamepadBinding *list, uint8_t count, GamepadMapCompiled *map)
+{
+    clearCompiled(map);
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        list[kept] = list[i];
+        if (!compileBinding(map, list, kept))
+        {
+            log_i("Gamepad binding %i skipped, it's invalid or doesn't fit", i);
+            continue;
+        }
+        kept++;
+    }
+    finishCompile(map);
+    return kept;
+}
+
+#pragma endregion
+
+#pragma region runtime
+
+static int addEvent(GamepadMapEvent *events, int count, uint8_t controller, const GamepadBinding *binding, bool start)
+{
+    if (count >= GAMEPAD_MAP_MAX_EVENTS)
+    {
+        return count;
+    }
+    events[count].controller = controller;
+    events[count].start = start;
+    events[count].binding = *binding;
+    return count + 1;
+}
+
+static int startBinding(GamepadMapState *state, uint8_t controller, uint8_t index, GamepadMapEvent *events, int count)
+{
+    const GamepadBinding *binding = &bindings[index];
+    if (binding->action == GAMEPAD_ACTION_VALVES)
+    {
+        if (state->holding)
+        {
+            count = addEvent(events, count, controller, &state->holdBinding, false);
+        }
+        state->holdBinding = *binding;
+        state->holding = true;
+    }
+    return addEvent(events, count, controller, binding, true);
+}
+
+static void dropPending(GamepadMapState *state)
+{
+    state->tap = GAMEPAD_MAP_NONE;
+    state->longPress = GAMEPAD_MAP_NONE;
+    state->sequenceNode = 0;
+}
+
+int gamepadMapFrame(uint8_t controller, uint32_t inputs, unsigned long now, GamepadMapEvent *events)
+{
+    if (controller >= BP32_MAX_GAMEPADS)
+    {
+        return 0;
+    }
+    GamepadMapState *state = &states[controller];
+    inputs &= GAMEPAD_MAP_INPUT_BITS;
+    if (inputs == state->held)
+    {
+        return 0; // most frames are just the sticks moving
+    }
+
+    int count = 0;
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    uint32_t pressed = inputs & ~state->held;
+    state->held = inputs;
+
+    if (state->holding && (inputs & bindingHeldInputs(&state->holdBinding)) != bindingHeldInputs(&state->holdBinding))
+    {
+        count = addEvent(events, count, controller, &state->holdBinding, false);
+        state->holding = false;
+    }
+    if (state->longPress != GAMEPAD_MAP_NONE && (inputs & bindings[state->longPress].inputs[0]) != bindings[state->longPress].inputs[0])
+    {
+        // let go before it turned into a long press, so it was a tap after all
+        if (state->tap != GAMEPAD_MAP_NONE && pressed == 0)
+        {
+            count = startBinding(state, controller, state->tap, events, count);
+        }
+        state->tap = GAMEPAD_MAP_NONE;
+        state->longPress = GAMEPAD_MAP_NONE;
+    }
+
+    if (pressed != 0)
+    {
+        // anything pending was for what was held before, it's a different combo now
+        state->tap = GAMEPAD_MAP_NONE;
+        state->longPress = GAMEPAD_MAP_NONE;
+        int tap = lookup(&compiled, makeKey(KEY_PRESS, 0, inputs));
+        int hold = lookup(&compiled, makeKey(KEY_LONG_PRESS, 0, inputs));
+        if (hold >= 0)
+        {
+            state->longPress = hold;
+            state->longDue = now + (bindings[hold].holdMS != 0 ? bindings[hold].holdMS : GAMEPAD_LONG_PRESS_DEFAULT_MS);
+            state->tap = tap >= 0 ? tap : GAMEPAD_MAP_NONE;
+        }
+        else if (tap >= 0)
+        {
+            count = startBinding(state, controller, tap, events, count);
+        }
+
+        // sequences see every press, one that also has its own binding still runs it
+        if (compiled.nodeCount > 1)
+        {
+            if (now - state->sequenceTime > GAMEPAD_SEQUENCE_TIMEOUT_MS)
+            {
+                state->sequenceNode = 0;
+            }
+            uint8_t node = sequenceStep(&compiled, state->sequenceNode, inputs);
+            if (node == 0 && pressed != inputs)
+            {
+                node = sequenceStep(&compiled, state->sequenceNode, pressed); // rolled onto the next one before letting go of the last
+            }
+            state->sequenceNode = node;
+            state->sequenceTime = now;
+            if (compiled.nodeFinishes[node] != GAMEPAD_MAP_NONE)
+            {
+                count = startBinding(state, controller, compiled.nodeFinishes[node], events, count);
+                state->sequenceNode = 0;
+            }
+        }
+    }
+    xSemaphoreGive(gamepadMapMutex);
+    return count;
+}
+
+int gamepadMapTick(unsigned long now, GamepadMapEvent *events)
+{
+    int count = 0;
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < BP32_MAX_GAMEPADS; i++)
+    {
+        GamepadMapState *state = &states[i];
+        if (state->longPress != GAMEPAD_MAP_NONE && (long)(now - state->longDue) >= 0)
+        {
+            count = startBinding(state, i, state->longPress, events, count);
+            state->tap = GAMEPAD_MAP_NONE;
+            state->longPress = GAMEPAD_MAP_NONE;
+        }
+    }
+    xSemaphoreGive(gamepadMapMutex);
+    return count;
+}
+
+int gamepadMapRelease(uint8_t controller, bool disconnected, GamepadMapEvent *events)
+{
+    if (controller >= BP32_MAX_GAMEPADS)
+    {
+        return 0;
+    }
+    int count = 0;
+    GamepadMapState *state = &states[controller];
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    if (state->holding)
+    {
+        count = addEvent(events, count, controller, &state->holdBinding, false);
+        state->holding = false;
+    }
+    dropPending(state);
+    if (disconnected)
+    {
+        state->held = 0;
+    }
+    xSemaphoreGive(gamepadMapMutex);
+    return count;
+}
+
+#pragma endregion
+
+#pragma region loading and editing
+
+// the built in ones, same as what the gamepads did before they could be changed
+static const GamepadBinding defaultBindings[] = {
+    {GAMEPAD_TRIGGER_PRESS, GAMEPAD_ACTION_ARM_TOGGLE, 0, 0, 1, 0, {GAMEPAD_INPUT_L1 | GAMEPAD_INPUT_R1}},
+    {GAMEPAD_TRIGGER_PRESS, GAMEPAD_ACTION_DISCONNECT, 0, 0, 1, 0, {GAMEPAD_INPUT_SYSTEM}},
+    {GAMEPAD_TRIGGER_SEQUENCE, GAMEPAD_ACTION_KONAMI, 0, 0, 10, 0, {GAMEPAD_INPUT_UP, GAMEPAD_INPUT_UP, GAMEPAD_INPUT_DOWN, GAMEPAD_INPUT_DOWN, GAMEPAD_INPUT_LEFT, GAMEPAD_INPUT_RIGHT, GAMEPAD_INPUT_LEFT, GAMEPAD_INPUT_RIGHT, GAMEPAD_INPUT_B, GAMEPAD_INPUT_A}},
+};
+
+// swaps in what was just compiled into editBindings/editCompiled. Caller holds the mutex
+static void installEdit(uint8_t count)
+{
+    memcpy(bindings, editBindings, sizeof(bindings));
+    memcpy(&compiled, &editCompiled, sizeof(GamepadMapCompiled));
+    bindingCount = count;
+    // pending ones are binding and node numbers from the old table. Held valves keep going, they have their own copy
+    for (int i = 0; i < BP32_MAX_GAMEPADS; i++)
+    {
+        dropPending(&states[i]);
+    }
+}
+
+static void loadDefaults()
+{
+    memset(editBindings, 0, sizeof(editBindings));
+    memcpy(editBindings, defaultBindings, sizeof(defaultBindings));
+    uint8_t count = compileSkipping(editBindings, sizeof(defaultBindings) / sizeof(*defaultBindings), &editCompiled);
+    installEdit(count);
+}
+
+// copied out while holding the mutex, written after so bp32 isn't stuck waiting on spiffs
+static void saveGamepadMap()
+{
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    mapFile.version = GAMEPAD_MAP_VERSION;
+    mapFile.count = bindingCount;
+    mapFile.reserved = 0;
+    memcpy(mapFile.bindings, bindings, sizeof(bindings));
+    xSemaphoreGive(gamepadMapMutex);
+    writeBytes(GAMEPAD_MAP_FILE, &mapFile, sizeof(GamepadMapFile) - sizeof(mapFile.bindings) + mapFile.count * sizeof(GamepadBinding));
+}
+
+void setupGamepadMap()
+{
+    gamepadMapMutex = xSemaphoreCreateMutex();
+    for (int i = 0; i < BP32_MAX_GAMEPADS; i++)
+    {
+        dropPending(&states[i]);
+    }
+
+    memset(&mapFile, 0, sizeof(GamepadMapFile));
+    size_t size = readBytes(GAMEPAD_MAP_FILE, &mapFile, sizeof(GamepadMapFile));
+    size_t headerSize = sizeof(GamepadMapFile) - sizeof(mapFile.bindings);
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    if (size >= headerSize && mapFile.version == GAMEPAD_MAP_VERSION && mapFile.count <= GAMEPAD_MAP_MAX_BINDINGS &&
+        size == headerSize + mapFile.count * sizeof(GamepadBinding))
+    {
+        memset(editBindings, 0, sizeof(editBindings));
+        memcpy(editBindings, mapFile.bindings, mapFile.count * sizeof(GamepadBinding));
+        installEdit(compileSkipping(editBindings, mapFile.count, &editCompiled));
+    }
+    else
+    {
+        loadDefaults();
+    }
+    log_i("Gamepad map: %i bindings, %i sequence steps, %i of %i table slots", bindingCount, compiled.nodeCount - 1, compiled.tableUsed, GAMEPAD_MAP_TABLE_SIZE);
+    xSemaphoreGive(gamepadMapMutex);
+}
+
+uint8_t gamepadMapCount()
+{
+    return bindingCount;
+}
+
+bool gamepadMapGet(uint8_t index, GamepadBinding *binding)
+{
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    bool found = index < bindingCount;
+    if (found)
+    {
+        *binding = bindings[index];
+    }
+    xSemaphoreGive(gamepadMapMutex);
+    return found;
+}
+
+GamepadMapStatus gamepadMapSet(uint8_t index, const GamepadBinding *binding)
+{
+    GamepadMapStatus status = GAMEPADMAP_STATUS_OK;
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    if (index > bindingCount || index >= GAMEPAD_MAP_MAX_BINDINGS)
+    {
+        status = GAMEPADMAP_STATUS_BAD_INDEX;
+    }
+    else
+    {
+        uint8_t count = index == bindingCount ? bindingCount + 1 : bindingCount;
+        memcpy(editBindings, bindings, sizeof(bindings));
+        editBindings[index] = *binding;
+        if (compileAll(editBindings, count, &editCompiled))
+        {
+            installEdit(count);
+        }
+        else
+        {
+            status = GAMEPADMAP_STATUS_INVALID;
+        }
+    }
+    xSemaphoreGive(gamepadMapMutex);
+    if (status == GAMEPADMAP_STATUS_OK)
+    {
+        saveGamepadMap();
+    }
+    return status;
+}
+
+GamepadMapStatus gamepadMapRemove(uint8_t index)
+{
+    GamepadMapStatus status = GAMEPADMAP_STATUS_OK;
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    if (index >= bindingCount)
+    {
+        status = GAMEPADMAP_STATUS_BAD_INDEX;
+    }
+    else
+    {
+        memset(editBindings, 0, sizeof(editBindings));
+        memcpy(editBindings, bindings, index * sizeof(GamepadBinding));
+        memcpy(&editBindings[index], &bindings[index + 1], (bindingCount - index - 1) * sizeof(GamepadBinding));
+        // taking one out can't make the rest clash
+        compileAll(editBindings, bindingCount - 1, &editCompiled);
+        installEdit(bindingCount - 1);
+    }
+    xSemaphoreGive(gamepadMapMutex);
+    if (status == GAMEPADMAP_STATUS_OK)
+    {
+        saveGamepadMap();
+    }
+    return status;
+}
+
+void gamepadMapReset()
+{
+    xSemaphoreTake(gamepadMapMutex, portMAX_DELAY);
+    loadDefaults();
+    xSemaphoreGive(gamepadMapMutex);
+    deleteFile(GAMEPAD_MAP_FILE);
+}
+
+#pragma endregion
@@ -0,0 +1,40 @@
+#ifndef gamepadMap_h
+#define gamepadMap_h
+
+#include <Arduino.h>
+#include <BTOas.h>
+
+// What each gamepad button does, see GamepadBinding. Bindings get compiled into one hash table when they're loaded or edited
+// (presses and long presses by their exact inputs, sequences as a trie with fallback links) so a frame only costs a couple of
+// lookups when something new gets pressed and nothing at all when the buttons didn't change.
+// This only works out what should run, bp32 runs it. Sticks aren't in here, they stay with the joystick code.
+
+#define GAMEPAD_MAP_FILE "/gamepad_map.dat"
+#define GAMEPAD_MAP_MAX_BINDINGS 32
+#define GAMEPAD_MAP_MAX_NODES 64  // sequence steps across every sequence binding, plus one
+#define GAMEPAD_MAP_MAX_EVENTS 8  // most a single call can hand back
+
+struct GamepadMapEvent
+{
+    uint8_t controller;
+    bool start; // false is a VALVES binding being let go
+    GamepadBinding binding;
+};
+
+void setupGamepadMap(); // loads the saved bindings, or the defaults if there aren't any
+
+// inputs is the GAMEPAD_INPUT_ bits for everything that controller is holding right now. Returns how many events got filled in
+int gamepadMapFrame(uint8_t controller, uint32_t inputs, unsigned long now, GamepadMapEvent *events);
+int gamepadMapTick(unsigned long now, GamepadMapEvent *events); // long presses that came due, call it every loop
+// stops anything the controller has running and drops what's pending. Keeps what it's holding unless it's gone, so
+// whatever is still held down doesn't count as a new press on the next frame
+int gamepadMapRelease(uint8_t controller, bool disconnected, GamepadMapEvent *events);
+
+// editing, every change gets saved. Anything that doesn't compile is turned down and nothing changes
+uint8_t gamepadMapCount();
+bool gamepadMapGet(uint8_t index, GamepadBinding *binding);
+GamepadMapStatus gamepadMapSet(uint8_t index, const GamepadBinding *binding); // index == count adds one
+GamepadMapStatus gamepadMapRemove(uint8_t index);
+void gamepadMapReset();
+
+#endif
@@ -35,7 +35,7 @@ const uint8_t profile_data[] =
     0x0d, 0x00, 0x02, 0x00, 0x05, 0x00, 0x03, 0x28, 0x02, 0x06, 0x00, 0x2a, 0x2b, 
     // 0x0006 VALUE CHARACTERISTIC-GATT_DATABASE_HASH - READ -''
     // READ_ANYBODY
-    0x18, 0x00, 0x02, 0x00, 0x06, 0x00, 0x2a, 0x2b, 0x91, 0x8a, 0x9a, 0x69, 0x56, 0xf3, 0x1b, 0x99, 0x04, 0x56, 0x61, 0xd7, 0xb2, 0xa8, 0x3a, 0xf9, 
+    0x18, 0x00, 0x02, 0x00, 0x06, 0x00, 0x2a, 0x2b, 0x2b, 0xd4, 0xcc, 0x9e, 0x51, 0x3c, 0x24, 0x32, 0x2f, 0xa4, 0xe2, 0xab, 0x33, 0x68, 0xfa, 0xde, 
     // OASMan Service
     // 0x0007 PRIMARY_SERVICE-679425c8-d3b4-4491-9eb2-3e3d15b625f0
     0x18, 0x00, 0x02, 0x00, 0x07, 0x00, 0x00, 0x28, 0xf0, 0x25, 0xb6, 0x15, 0x3d, 0x3e, 0xb2, 0x9e, 0x91, 0x44, 0xb4, 0xd3, 0xc8, 0x25, 0x94, 0x67, 
@@ -67,10 +67,28 @@ const uint8_t profile_data[] =
     // 0x0010 CLIENT_CHARACTERISTIC_CONFIGURATION
     // READ_ANYBODY, WRITE_ANYBODY
     0x0a, 0x00, 0x0e, 0x01, 0x10, 0x00, 0x02, 0x29, 0x00, 0x00, 
+    // RAWSTREAM_CHARACTERISTIC
+    // 0x0011 CHARACTERISTIC-4d8b3e6a-52c1-4f0e-a7d9-1c6b2e8f9a34 - NOTIFY | READ | DYNAMIC
+    0x1b, 0x00, 0x02, 0x00, 0x11, 0x00, 0x03, 0x28, 0x12, 0x12, 0x00, 0x34, 0x9a, 0x8f, 0x2e, 0x6b, 0x1c, 0xd9, 0xa7, 0x0e, 0x4f, 0xc1, 0x52, 0x6a, 0x3e, 0x8b, 0x4d, 
+    // 0x0012 VALUE CHARACTERISTIC-4d8b3e6a-52c1-4f0e-a7d9-1c6b2e8f9a34 - NOTIFY | READ | DYNAMIC
+    // READ_ANYBODY
+    0x16, 0x00, 0x02, 0x03, 0x12, 0x00, 0x34, 0x9a, 0x8f, 0x2e, 0x6b, 0x1c, 0xd9, 0xa7, 0x0e, 0x4f, 0xc1, 0x52, 0x6a, 0x3e, 0x8b, 0x4d, 
+    // 0x0013 CLIENT_CHARACTERISTIC_CONFIGURATION
+    // READ_ANYBODY, WRITE_ANYBODY
+    0x0a, 0x00, 0x0e, 0x01, 0x13, 0x00, 0x02, 0x29, 0x00, 0x00, 
+    // BULK_CHARACTERISTIC
+    // 0x0014 CHARACTERISTIC-9c3e5b71-2d4a-4f86-b0e3-7a1f6c2d8e45 - NOTIFY | READ | DYNAMIC
+    0x1b, 0x00, 0x02, 0x00, 0x14, 0x00, 0x03, 0x28, 0x12, 0x15, 0x00, 0x45, 0x8e, 0x2d, 0x6c, 0x1f, 0x7a, 0xe3, 0xb0, 0x86, 0x4f, 0x4a, 0x2d, 0x71, 0x5b, 0x3e, 0x9c, 
+    // 0x0015 VALUE CHARACTERISTIC-9c3e5b71-2d4a-4f86-b0e3-7a1f6c2d8e45 - NOTIFY | READ | DYNAMIC
+    // READ_ANYBODY
+    0x16, 0x00, 0x02, 0x03, 0x15, 0x00, 0x45, 0x8e, 0x2d, 0x6c, 0x1f, 0x7a, 0xe3, 0xb0, 0x86, 0x4f, 0x4a, 0x2d, 0x71, 0x5b, 0x3e, 0x9c, 
+    // 0x0016 CLIENT_CHARACTERISTIC_CONFIGURATION
+    // READ_ANYBODY, WRITE_ANYBODY
+    0x0a, 0x00, 0x0e, 0x01, 0x16, 0x00, 0x02, 0x29, 0x00, 0x00, 
     // compile using C:\Users\user\Documents\GitHub\bluepad32\tools>python ../external/btstack/tool/compile_gatt.py oasman_service.gatt oasman_service.gatt.h
     // END
     0x00, 0x00, 
-}; // total size 153 bytes 
+}; // total size 406 bytes 
 
 
 //
@@ -85,9 +103,9 @@ const uint8_t profile_data[] =
 #define ATT_SERVICE_GATT_SERVICE_01_START_HANDLE 0x0004
 #define ATT_SERVICE_GATT_SERVICE_01_END_HANDLE 0x0006
 #define ATT_SERVICE_679425c8_d3b4_4491_9eb2_3e3d15b625f0_START_HANDLE 0x0007
-#define ATT_SERVICE_679425c8_d3b4_4491_9eb2_3e3d15b625f0_END_HANDLE 0x0010
+#define ATT_SERVICE_679425c8_d3b4_4491_9eb2_3e3d15b625f0_END_HANDLE 0x0016
 #define ATT_SERVICE_679425c8_d3b4_4491_9eb2_3e3d15b625f0_01_START_HANDLE 0x0007
-#define ATT_SERVICE_679425c8_d3b4_4491_9eb2_3e3d15b625f0_01_END_HANDLE 0x0010
+#define ATT_SERVICE_679425c8_d3b4_4491_9eb2_3e3d15b625f0_01_END_HANDLE 0x0016
 
 //
 // list mapping between characteristics and handles
@@ -100,3 +118,7 @@ const uint8_t profile_data[] =
 #define ATT_CHARACTERISTIC_f573f13f_b38e_415e_b8f0_59a6a19a4e02_01_CLIENT_CONFIGURATION_HANDLE 0x000d
 #define ATT_CHARACTERISTIC_e225a15a_e816_4e9d_99b7_c384f91f273b_01_VALUE_HANDLE 0x000f
 #define ATT_CHARACTERISTIC_e225a15a_e816_4e9d_99b7_c384f91f273b_01_CLIENT_CONFIGURATION_HANDLE 0x0010
+#define ATT_CHARACTERISTIC_4d8b3e6a_52c1_4f0e_a7d9_1c6b2e8f9a34_01_VALUE_HANDLE 0x0012
+#define ATT_CHARACTERISTIC_4d8b3e6a_52c1_4f0e_a7d9_1c6b2e8f9a34_01_CLIENT_CONFIGURATION_HANDLE 0x0013
+#define ATT_CHARACTERISTIC_9c3e5b71_2d4a_4f86_b0e3_7a1f6c2d8e45_01_VALUE_HANDLE 0x0015
+#define ATT_CHARACTERISTIC_9c3e5b71_2d4a_4f86_b0e3_7a1f6c2d8e45_01_CLIENT_CONFIGURATION_HANDLE 0x0016
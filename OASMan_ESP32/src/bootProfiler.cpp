@@ -0,0 +1,84 @@
+#include "bootProfiler.h"
+
+static uint32_t bootPhaseTimes[BOOT_PHASE_COUNT];
+static bool fastBoot = false;
+
+void bootPhase(BootPhase phase)
+{
+    if (bootPhaseTimes[phase] != 0)
+    {
+        return;
+    }
+    uint32_t ms = esp_timer_get_time() / 1000;
+    bootPhaseTimes[phase] = ms > 0 ? ms : 1; // 0 is reserved for not reached yet
+    // the later ones happen after the summary is printed so log them on their own
+    if (phase > BOOT_PHASE_SETUP_DONE)
+    {
+        log_i("Boot phase %s: %ums", getBootPhaseName(phase), bootPhaseTimes[phase]);
+    }
+}
+
+uint32_t getBootPhaseTime(BootPhase phase)
+{
+    return bootPhaseTimes[phase];
+}
+
+const uint32_t *getBootPhaseTimes()
+{
+    return bootPhaseTimes;
+}
+
+const char *getBootPhaseName(BootPhase phase)
+{
+    switch (phase)
+    {
+    case BOOT_PHASE_SETUP_START:
+        return "setup start";
+    case BOOT_PHASE_SPIFFS:
+        return "spiffs";
+    case BOOT_PHASE_SAVEDATA:
+        return "save data";
+    case BOOT_PHASE_MANIFOLD:
+        return "manifold";
+    case BOOT_PHASE_WHEELS:
+        return "wheels";
+    case BOOT_PHASE_ACCESSORY:
+        return "accessory";
+    case BOOT_PHASE_TASKS:
+        return "tasks";
+    case BOOT_PHASE_SETUP_DONE:
+        return "setup done";
+    case BOOT_PHASE_BLE_READY:
+        return "ble ready";
+    case BOOT_PHASE_FIRST_VALVE:
+        return "first valve";
+    default:
+        return "unknown";
+    }
+}
+
+void printBootPhases()
+{
+    Serial.print(F("Boot timings"));
+    Serial.println(fastBoot ? F(" (fast boot):") : F(":"));
+    uint32_t prev = 0;
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        if (bootPhaseTimes[i] == 0)
+        {
+            continue;
+        }
+        Serial.printf("  %-12s %6ums (+%ums)\n", getBootPhaseName((BootPhase)i), bootPhaseTimes[i], bootPhaseTimes[i] - prev);
+        prev = bootPhaseTimes[i];
+    }
+}
+
+void setFastBoot(bool _fastBoot)
+{
+    fastBoot = _fastBoot;
+}
+
+bool isFastBoot()
+{
+    return fastBoot;
+}
@@ -0,0 +1,20 @@
+#ifndef bootProfiler_h
+#define bootProfiler_h
+
+#include <Arduino.h>
+#include <BTOas.h>
+
+// Timestamps for each part of setup so we can see where the boot time actually goes.
+// Times are ms since power on (esp timer), so the bootloader time before setup() is included in the first one.
+
+void bootPhase(BootPhase phase); // only the first call for each phase counts
+uint32_t getBootPhaseTime(BootPhase phase);
+const uint32_t *getBootPhaseTimes();
+const char *getBootPhaseName(BootPhase phase);
+void printBootPhases();
+
+// fast boot is when we restarted ourselves (internalReboot), skips the learn data dump and the voltage stabilize waits
+void setFastBoot(bool fastBoot);
+bool isFastBoot();
+
+#endif
@@ -0,0 +1,301 @@
+#include "bulkTransfer.h"
+#include "manifoldSaveData.h"
+#include "telemetry.h"
+#include "bluetooth/bp32.h"
+#include "bluetooth/gamepadMap.h"
+#include "bluetooth/allowedDevices.h"
+#include <SPIFFS.h>
+
+struct BulkTransfer
+{
+    bool active;
+    uint16_t owner; // connection handle
+    uint16_t transferId;
+    BulkResource resource;
+    File file;       // learn data, allowed controllers and the gamepad map
+    uint8_t *buffer; // settings backup
+    uint32_t size;
+    uint32_t ackOffset;  // client has everything before this
+    uint32_t sendOffset; // next byte to go out
+    uint8_t window;
+    unsigned long lastAckTime;
+    unsigned long lastHeardTime;
+};
+
+static BulkTransfer transfers[BULK_MAX_TRANSFERS];
+
+static BulkTransfer *findTransfer(uint16_t owner)
+{
+    for (int i = 0; i < BULK_MAX_TRANSFERS; i++)
+    {
+        if (transfers[i].active && transfers[i].owner == owner)
+        {
+            return &transfers[i];
+        }
+    }
+    return nullptr;
+}
+
+static BulkTransfer *findFreeTransfer()
+{
+    for (int i = 0; i < BULK_MAX_TRANSFERS; i++)
+    {
+        if (!transfers[i].active)
+        {
+            return &transfers[i];
+        }
+    }
+    return nullptr;
+}
+
+static void closeTransfer(BulkTransfer *transfer)
+{
+    if (transfer->file)
+    {
+        transfer->file.close();
+    }
+    if (transfer->buffer != nullptr)
+    {
+        free(transfer->buffer);
+        transfer->buffer = nullptr;
+    }
+    transfer->active = false;
+}
+
+static bool openFile(BulkTransfer *transfer, const char *name)
+{
+    transfer->file = SPIFFS.open(name, "r");
+    if (!transfer->file)
+    {
+        return false;
+    }
+    transfer->size = transfer->file.size();
+    return true;
+}
+
+static bool openSource(BulkTransfer *transfer, BulkResource resource)
+{
+    transfer->resource = resource;
+    switch (resource)
+    {
+    case BULK_LEARN_UP_FRONT:
+    case BULK_LEARN_UP_REAR:
+    case BULK_LEARN_DOWN_FRONT:
+    case BULK_LEARN_DOWN_REAR:
+        return openFile(transfer, getLogFileName((SOLENOID_AI_INDEX)(resource - BULK_LEARN_UP_FRONT)));
+    case BULK_ALLOWED_CONTROLLERS:
+        return openFile(transfer, ALLOWED_DEVICES_FILE);
+    case BULK_GAMEPAD_MAP:
+        return openFile(transfer, GAMEPAD_MAP_FILE);
+    case BULK_TELEMETRY:
+        telemetryFlush(); // get whatever is sitting in ram out too
+        transfer->size = telemetryGetSize();
+        return true;
+    case BULK_SETTINGS:
+        transfer->buffer = (uint8_t *)malloc(BULK_SETTINGS_MAX_SIZE);
+        if (transfer->buffer == nullptr)
+        {
+            return false;
+        }
+        transfer->size = writeSettingsBackup((char *)transfer->buffer, BULK_SETTINGS_MAX_SIZE);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static uint16_t readSource(BulkTransfer *transfer, uint32_t offset, uint8_t *buffer, uint16_t length)
+{
+    if (transfer->file)
+    {
+        // only seek when going back for a resend, otherwise we're already there
+        if (transfer->file.position() != offset && !transfer->file.seek(offset))
+        {
+            return 0;
+        }
+        return transfer->file.read(buffer, length);
+    }
+    if (transfer->buffer != nullptr)
+    {
+        memcpy(buffer, transfer->buffer + offset, length);
+        return length;
+    }
+    if (transfer->resource == BULK_TELEMETRY)
+    {
+        return telemetryRead(offset, buffer, length);
+    }
+    return 0;
+}
+
+static uint16_t chunkSizeFor(uint16_t maxLength)
+{
+    uint16_t chunkSize = maxLength - sizeof(BulkChunkHeader);
+    return chunkSize > BULK_MAX_CHUNK_SIZE ? BULK_MAX_CHUNK_SIZE : chunkSize;
+}
+
+static bool canSend(BulkTransfer *transfer, uint16_t maxLength)
+{
+    if (transfer == nullptr || maxLength <= sizeof(BulkChunkHeader) || transfer->sendOffset >= transfer->size)
+    {
+        return false;
+    }
+    return transfer->sendOffset - transfer->ackOffset < (uint32_t)transfer->window * chunkSizeFor(maxLength);
+}
+
+bool bulkHandlePacket(uint16_t owner, BulkPacket *packet, BulkPacket *reply)
+{
+    BulkTransfer *transfer = findTransfer(owner);
+    unsigned long now = millis();
+    switch (packet->getCommand())
+    {
+    case BULKCMD_OPEN:
+    {
+        // one at a time per client, opening again replaces it. That's also how a resume after reconnecting works
+        if (transfer != nullptr)
+        {
+            closeTransfer(transfer);
+        }
+        *reply = BulkPacket(BULKCMD_OPEN, packet->getTransferId(), packet->getOffset());
+        reply->setResource(packet->getResource());
+        transfer = findFreeTransfer();
+        if (transfer == nullptr)
+        {
+            reply->setStatus(BULK_STATUS_BUSY);
+            return true;
+        }
+        if (!openSource(transfer, packet->getResource()))
+        {
+            closeTransfer(transfer);
+            reply->setStatus(BULK_STATUS_NOT_FOUND);
+            return true;
+        }
+        reply->setSize(transfer->size);
+        if (packet->getOffset() > transfer->size)
+        {
+            closeTransfer(transfer);
+            reply->setStatus(BULK_STATUS_BAD_OFFSET);
+            return true;
+        }
+
+        uint8_t window = packet->getWindow();
+        transfer->active = true;
+        transfer->owner = owner;
+        transfer->transferId = packet->getTransferId();
+        transfer->ackOffset = packet->getOffset();
+        transfer->sendOffset = packet->getOffset();
+        transfer->window = window == 0 ? BULK_DEFAULT_WINDOW : (window > BULK_MAX_WINDOW ? BULK_MAX_WINDOW : window);
+        transfer->lastAckTime = now;
+        transfer->lastHeardTime = now;
+        reply->setStatus(BULK_STATUS_OK);
+        log_i("Bulk transfer %i of resource %i to %i, %u bytes from %u", transfer->transferId, transfer->resource, owner, transfer->size, transfer->ackOffset);
+        return true;
+    }
+    case BULKCMD_ACK:
+        if (transfer != nullptr && transfer->transferId == packet->getTransferId())
+        {
+            transfer->lastHeardTime = now;
+            uint32_t offset = packet->getOffset();
+            if (offset > transfer->ackOffset && offset <= transfer->sendOffset)
+            {
+                transfer->ackOffset = offset;
+                transfer->lastAckTime = now;
+            }
+            if (transfer->ackOffset >= transfer->size)
+            {
+                log_i("Bulk transfer %i done", transfer->transferId);
+                closeTransfer(transfer);
+            }
+        }
+        return false;
+    case BULKCMD_RESEND:
+        if (transfer != nullptr && transfer->transferId == packet->getTransferId())
+        {
+            transfer->lastHeardTime = now;
+            uint32_t offset = packet->getOffset();
+            if (offset >= transfer->ackOffset && offset <= transfer->sendOffset)
+            {
+                // everything before it was fine, so it counts as an ack too
+                transfer->ackOffset = offset;
+                transfer->sendOffset = offset;
+                transfer->lastAckTime = now;
+            }
+        }
+        return false;
+    case BULKCMD_CANCEL:
+        if (transfer != nullptr)
+        {
+            closeTransfer(transfer);
+        }
+        return false;
+    }
+    return false;
+}
+
+bool bulkHasChunk(uint16_t owner, uint16_t maxLength)
+{
+    return canSend(findTransfer(owner), maxLength);
+}
+
+uint16_t bulkReadChunk(uint16_t owner, uint8_t *buffer, uint16_t maxLength)
+{
+    BulkTransfer *transfer = findTransfer(owner);
+    if (!canSend(transfer, maxLength))
+    {
+        return 0;
+    }
+    uint32_t chunkSize = chunkSizeFor(maxLength);
+    if (chunkSize > transfer->size - transfer->sendOffset)
+    {
+        chunkSize = transfer->size - transfer->sendOffset;
+    }
+    uint8_t *data = buffer + sizeof(BulkChunkHeader);
+    uint16_t length = readSource(transfer, transfer->sendOffset, data, chunkSize);
+    if (length == 0)
+    {
+        return 0; // file got shorter under us, the acks will stop and the client can open it again
+    }
+
+    BulkChunkHeader header;
+    header.transferId = transfer->transferId;
+    header.offset = transfer->sendOffset;
+    header.crc = bulkCrc32(data, length);
+    memcpy(buffer, &header, sizeof(BulkChunkHeader));
+    transfer->sendOffset += length;
+    return sizeof(BulkChunkHeader) + length;
+}
+
+void bulkCancel(uint16_t owner)
+{
+    BulkTransfer *transfer = findTransfer(owner);
+    if (transfer != nullptr)
+    {
+        log_i("Bulk transfer %i dropped at %u of %u", transfer->transferId, transfer->ackOffset, transfer->size);
+        closeTransfer(transfer);
+    }
+}
+
+bool bulkCheckTimeouts(unsigned long now)
+{
+    bool resend = false;
+    for (int i = 0; i < BULK_MAX_TRANSFERS; i++)
+    {
+        BulkTransfer *transfer = &transfers[i];
+        if (!transfer->active)
+        {
+            continue;
+        }
+        if (now - transfer->lastHeardTime >= BULK_IDLE_TIMEOUT_MS)
+        {
+            log_i("Bulk transfer %i timed out", transfer->transferId);
+            closeTransfer(transfer);
+        }
+        else if (transfer->sendOffset > transfer->ackOffset && now - transfer->lastAckTime >= BULK_ACK_TIMEOUT_MS)
+        {
+            // acks stopped, something got lost. Go back N
+            transfer->sendOffset = transfer->ackOffset;
+            transfer->lastAckTime = now;
+            resend = true;
+        }
+    }
+    return resend;
+}
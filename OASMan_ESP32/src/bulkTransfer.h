@@ -0,0 +1,24 @@
+#ifndef bulkTransfer_h
+#define bulkTransfer_h
+
+#include <Arduino.h>
+#include <BTOas.h>
+
+// Bulk transfers (BULKPKT) off the manifold. Files get read straight out of SPIFFS one chunk at a time when btstack has room to send,
+// the only thing that gets built whole in ram is the settings backup since it doesn't exist as a file.
+// All of this runs on the btstack thread (rest writes, can send now and the notify timer) so there's no locking.
+
+#define BULK_MAX_TRANSFERS 2        // each one can hold a file open
+#define BULK_DEFAULT_WINDOW 8       // chunks in flight if the client doesn't say
+#define BULK_MAX_WINDOW 32
+#define BULK_ACK_TIMEOUT_MS 1000    // no ack for this long and we go back to the last acked offset
+#define BULK_IDLE_TIMEOUT_MS 30000  // nothing from the client for this long and the transfer gets dropped
+#define BULK_SETTINGS_MAX_SIZE 4096
+
+bool bulkHandlePacket(uint16_t owner, BulkPacket *packet, BulkPacket *reply); // true if reply should be sent back
+bool bulkHasChunk(uint16_t owner, uint16_t maxLength);
+uint16_t bulkReadChunk(uint16_t owner, uint8_t *buffer, uint16_t maxLength); // builds the next chunk notify into buffer, 0 if there's nothing to send right now
+void bulkCancel(uint16_t owner); // client disconnected
+bool bulkCheckTimeouts(unsigned long now); // true if something went back to resend
+
+#endif
@@ -1,43 +1,170 @@
 #include "screen.h"
+#include "i2cBus.h"
 
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
-void drawPSIReadings()
+// Everything but the numbers only gets drawn once. After that a number is redrawn in its own cell when it changes, and only
+// the columns of the pages those cells touch go out over i2c. The bus is shared with the ADS1115s, so a full 1KB frame every
+// 100ms was taking time away from pressure reads. Now when nothing changes nothing gets sent at all.
+// Whatever does go out takes the bus one small chunk at a time (see i2cBus) so a pressure read waits on one chunk at most
+#define SCREEN_PAGES (SCREEN_HEIGHT / 8)
+#define SCREEN_CHAR_WIDTH 6 // text size 1
+#define SCREEN_CHAR_HEIGHT 8
+#define SCREEN_VALUE_CHARS 4
+#define SCREEN_TEXT_HEIGHT_PX 10
+#define SCREEN_FULL_REFRESH_MS 30000 // everything goes out again now and then in case a transfer got garbled
+#define SCREEN_I2C_CLOCK 400000      // same speeds the adafruit library switches between around a transfer
+#define SCREEN_I2C_RESTORE_CLOCK 100000
+#define SCREEN_I2C_CHUNK 32 // data bytes per transfer, under 1ms at 400khz
+
+struct ScreenField
 {
-    display.clearDisplay();
+    const char *label;
+    int16_t x;
+    int16_t y;
+    int value; // what's on the screen now
+};
 
-    display.drawBitmap(0, 0, logo_bmp_corvette, 128, 20, 1);
+static ScreenField screenFields[] = {
+    {"FD: ", 0, 2 * SCREEN_TEXT_HEIGHT_PX + 5, 0},
+    {"FP: ", SCREEN_WIDTH / 2, 2 * SCREEN_TEXT_HEIGHT_PX + 5, 0},
+    {"RD: ", 0, (int16_t)(3.5 * SCREEN_TEXT_HEIGHT_PX + 5), 0},
+    {"RP: ", SCREEN_WIDTH / 2, (int16_t)(3.5 * SCREEN_TEXT_HEIGHT_PX + 5), 0},
+    {"Tank: ", 0, 5 * SCREEN_TEXT_HEIGHT_PX + 5, 0},
+};
+#define SCREEN_FIELD_COUNT (sizeof(screenFields) / sizeof(*screenFields))
 
-    display.setTextSize(1);
-    display.setTextColor(SSD1306_WHITE);
+static bool screenLayoutDrawn = false;
+static unsigned long lastFullRefresh = 0;
+static uint8_t dirtyStart[SCREEN_PAGES]; // columns of each page that changed since they were last sent
+static uint8_t dirtyEnd[SCREEN_PAGES];   // one past the last, 0 when the page is clean
+
+static int readScreenField(int field)
+{
+    switch (field)
+    {
+    case 0:
+        return int(getWheel(WHEEL_FRONT_DRIVER)->getSelectedInputValue());
+    case 1:
+        return int(getWheel(WHEEL_FRONT_PASSENGER)->getSelectedInputValue());
+    case 2:
+        return int(getWheel(WHEEL_REAR_DRIVER)->getSelectedInputValue());
+    case 3:
+        return int(getWheel(WHEEL_REAR_PASSENGER)->getSelectedInputValue());
+    default:
+        return int(getCompressor()->getTankPressure());
+    }
+}
+
+static void markDirty(int x, int y, int width, int height)
+{
+    for (int page = y / 8; page <= (y + height - 1) / 8 && page < SCREEN_PAGES; page++)
+    {
+        if (dirtyEnd[page] == 0)
+        {
+            dirtyStart[page] = x;
+            dirtyEnd[page] = x + width;
+        }
+        else
+        {
+            dirtyStart[page] = x < dirtyStart[page] ? x : dirtyStart[page];
+            dirtyEnd[page] = x + width > dirtyEnd[page] ? x + width : dirtyEnd[page];
+        }
+    }
+}
 
-    int textHeightPx = 10;
-    int secondRowXPos = SCREEN_WIDTH / 2;
+// one transfer with the bus held, control is 0x00 for commands or 0x40 for data
+static void sendScreenTransfer(uint8_t control, const uint8_t *bytes, int length)
+{
+    i2cBusAcquire(I2C_PRIORITY_DISPLAY);
+    Wire.setClock(SCREEN_I2C_CLOCK);
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write(control);
+    Wire.write(bytes, length);
+    Wire.endTransmission();
+    Wire.setClock(SCREEN_I2C_RESTORE_CLOCK);
+    i2cBusRelease();
+}
 
-    display.setCursor(0, 5 * textHeightPx + 5);
-    display.print(F("Tank: "));
-    display.print(int(getCompressor()->getTankPressure()));
+// the display is in horizontal addressing mode from begin(), so a page and column window then the bytes for it is all it needs.
+// The display keeps its place between transfers so anything else can use the bus in between
+static void sendDirtyPages()
+{
+    uint8_t *buffer = display.getBuffer();
+    for (int page = 0; page < SCREEN_PAGES; page++)
+    {
+        if (dirtyEnd[page] == 0)
+        {
+            continue;
+        }
+        const uint8_t window[] = {SSD1306_PAGEADDR, (uint8_t)page, (uint8_t)page, SSD1306_COLUMNADDR, dirtyStart[page], (uint8_t)(dirtyEnd[page] - 1)};
+        sendScreenTransfer(0x00, window, sizeof(window));
 
-    // Front
+        uint8_t *bytes = buffer + page * SCREEN_WIDTH + dirtyStart[page];
+        int remaining = dirtyEnd[page] - dirtyStart[page];
+        while (remaining > 0)
+        {
+            int chunk = remaining > SCREEN_I2C_CHUNK ? SCREEN_I2C_CHUNK : remaining;
+            sendScreenTransfer(0x40, bytes, chunk);
+            bytes += chunk;
+            remaining -= chunk;
+        }
+        dirtyEnd[page] = 0;
+    }
+}
 
-    display.setCursor(0, 2 * textHeightPx + 5);
-    display.print(F("FD: "));
-    display.print(int(getWheel(WHEEL_FRONT_DRIVER)->getSelectedInputValue())); // front driver
+// instead of display.display(), which holds the bus for the whole 1KB
+static void sendFullFrame()
+{
+    markDirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    sendDirtyPages();
+}
 
-    display.setCursor(secondRowXPos, 2 * textHeightPx + 5);
-    display.print(F("FP: "));
-    display.print(int(getWheel(WHEEL_FRONT_PASSENGER)->getSelectedInputValue())); // front passenger
+static void drawScreenLayout()
+{
+    display.clearDisplay();
+    display.drawBitmap(0, 0, logo_bmp_corvette, 128, 20, 1);
+    display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+    for (int i = 0; i < SCREEN_FIELD_COUNT; i++)
+    {
+        display.setCursor(screenFields[i].x, screenFields[i].y);
+        display.print(screenFields[i].label);
+    }
+}
 
-    // Rear
-    display.setCursor(0, 3.5 * textHeightPx + 5);
-    display.print(F("RD: "));
-    display.print(int(getWheel(WHEEL_REAR_DRIVER)->getSelectedInputValue())); // rear driver
+void drawPSIReadings()
+{
+    unsigned long now = millis();
+    bool full = !screenLayoutDrawn || now - lastFullRefresh >= SCREEN_FULL_REFRESH_MS;
+    if (full)
+    {
+        drawScreenLayout();
+    }
 
-    display.setCursor(secondRowXPos, 3.5 * textHeightPx + 5);
-    display.print(F("RP: "));
-    display.print(int(getWheel(WHEEL_REAR_PASSENGER)->getSelectedInputValue())); // rear passenger
+    for (int i = 0; i < SCREEN_FIELD_COUNT; i++)
+    {
+        ScreenField *field = &screenFields[i];
+        int value = readScreenField(i);
+        if (!full && value == field->value)
+        {
+            continue;
+        }
+        field->value = value;
+        int x = field->x + strlen(field->label) * SCREEN_CHAR_WIDTH;
+        display.fillRect(x, field->y, SCREEN_VALUE_CHARS * SCREEN_CHAR_WIDTH, SCREEN_CHAR_HEIGHT, SSD1306_BLACK);
+        display.setCursor(x, field->y);
+        display.print(value);
+        markDirty(x, field->y, SCREEN_VALUE_CHARS * SCREEN_CHAR_WIDTH, SCREEN_CHAR_HEIGHT);
+    }
 
-    display.display();
+    if (full)
+    {
+        markDirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+        screenLayoutDrawn = true;
+        lastFullRefresh = now;
+    }
+    sendDirtyPages();
 }
 
 void drawsplashscreen()
@@ -47,12 +174,13 @@ void drawsplashscreen()
         display.clearDisplay();
 
         display.drawBitmap(0, i, logo_bmp_bootimg, 128, 64, 1);
-        display.display();
+        sendFullFrame();
         delay(1); // 1 ms
     }
     display.clearDisplay();
 
     display.drawBitmap(0, 0, logo_bmp_bootimg, 128, 64, 1);
-    display.display();
+    sendFullFrame();
     delay(2000); // 2 seconds
+    screenLayoutDrawn = false; // the readings need their whole layout back
 }
@@ -1,4 +1,7 @@
 #include "solenoid.h"
+#include "bootProfiler.h"
+#include "telemetry.h"
+#include "rawStream.h"
 #include <Wire.h>
 #include <SPI.h>
 
@@ -19,6 +22,7 @@ void Solenoid::open()
     {
         this->pin->digitalWrite(HIGH);
         this->bopen = true;
+        this->changed();
     }
 }
 void Solenoid::close()
@@ -27,6 +31,24 @@ void Solenoid::close()
     {
         this->pin->digitalWrite(LOW);
         this->bopen = false;
+        this->changed();
+    }
+}
+void Solenoid::changed()
+{
+    // the compressor relay is a Solenoid too but it doesn't have an ai index
+    if (this->aiIndex == SOLENOID_AI_INDEX::AI_MODEL_UNDEFINED)
+    {
+        telemetryCompressorChanged();
+    }
+    else
+    {
+        if (this->bopen)
+        {
+            bootPhase(BOOT_PHASE_FIRST_VALVE);
+        }
+        telemetryValvesChanged();
+        rawStreamValvesChanged();
     }
 }
 bool Solenoid::isOpen()
@@ -9,6 +9,7 @@ private:
     InputType *pin;
     bool bopen;
     SOLENOID_AI_INDEX aiIndex = SOLENOID_AI_INDEX::AI_MODEL_UNDEFINED;
+    void changed();
 
 public:
     Solenoid();
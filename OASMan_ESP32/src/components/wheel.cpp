@@ -1,4 +1,5 @@
 #include "wheel.h"
+#include "telemetry.h"
 
 #define NUM_WHEEL_THREADS 4
 std::atomic<bool> flagStartPressureGoalRoutine[NUM_WHEEL_THREADS];
@@ -260,6 +261,7 @@ void Wheel::loop()
         int iteration = startIteration; // - values make it skip the first generation. It won't start dividing until iteration = 1
         const int fullAirOutTime = 5000;
         bool previousDirection = false;
+        telemetryRoutineStart(thisWheelNum, this->pressureGoal, this->getSelectedInputValue(), this->quickMode);
         for (;;)
         {
             // 10 second timeout in case tank doesn't have a whole lot of air or something
@@ -386,6 +388,7 @@ void Wheel::loop()
         // close both after (only applies for level sensor logic)
         this->s_AirIn->close();
         this->s_AirOut->close();
+        telemetryRoutineStop(thisWheelNum, this->getSelectedInputValue());
     }
 
     // Maintain Pressure code
@@ -0,0 +1,188 @@
+#include "i2cBus.h"
+
+struct I2CBusWaiter
+{
+    TaskHandle_t task;
+    I2CBusWaiter *next;
+};
+
+struct I2CBusStats
+{
+    uint32_t count;
+    uint64_t waitSumUS;
+    uint32_t waitMaxUS;
+    uint64_t holdSumUS;
+    uint32_t holdMaxUS;
+};
+
+static portMUX_TYPE i2cBusMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t busOwner = nullptr;
+static I2CBusPriority ownerPriority;
+static unsigned long ownerSinceUS;
+static I2CBusWaiter *waitingHead[I2C_PRIORITY_COUNT]; // each priority is first come first served
+static I2CBusWaiter *waitingTail[I2C_PRIORITY_COUNT];
+static I2CBusStats busStats[I2C_PRIORITY_COUNT];
+static unsigned long busStatsSinceUS = 0;
+
+// the spinlock can't be held across vTaskPrioritySet, so this keeps the owner from releasing between a waiter seeing
+// who owns the bus and boosting them, otherwise the boost would stick to a task that's already done with it
+static SemaphoreHandle_t boostMutex;
+static bool ownerBoosted = false;
+static UBaseType_t ownerRestorePriority;
+
+static const char *priorityNames[I2C_PRIORITY_COUNT] = {"adc", "display"};
+
+void setupI2CBus()
+{
+    boostMutex = xSemaphoreCreateMutex();
+}
+
+// lend the owner our task priority if it's lower, so it gets off the bus as fast as we would
+static void boostBusOwner(TaskHandle_t self)
+{
+    UBaseType_t ourPriority = uxTaskPriorityGet(self);
+    xSemaphoreTake(boostMutex, portMAX_DELAY);
+    portENTER_CRITICAL(&i2cBusMux);
+    TaskHandle_t owner = busOwner;
+    portEXIT_CRITICAL(&i2cBusMux);
+    if (owner != nullptr && owner != self)
+    {
+        UBaseType_t ownerPriority = uxTaskPriorityGet(owner);
+        if (ourPriority > ownerPriority)
+        {
+            if (!ownerBoosted)
+            {
+                ownerRestorePriority = ownerPriority;
+                ownerBoosted = true;
+            }
+            vTaskPrioritySet(owner, ourPriority);
+        }
+    }
+    xSemaphoreGive(boostMutex);
+}
+
+void i2cBusAcquire(I2CBusPriority priority)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    unsigned long startUS = micros();
+    I2CBusWaiter waiter = {self, nullptr}; // only linked in while we wait, release takes it back out before waking us
+
+    portENTER_CRITICAL(&i2cBusMux);
+    bool mine = busOwner == nullptr;
+    if (mine)
+    {
+        busOwner = self;
+    }
+    else
+    {
+        if (waitingTail[priority] != nullptr)
+        {
+            waitingTail[priority]->next = &waiter;
+        }
+        else
+        {
+            waitingHead[priority] = &waiter;
+        }
+        waitingTail[priority] = &waiter;
+    }
+    portEXIT_CRITICAL(&i2cBusMux);
+
+    if (!mine)
+    {
+        boostBusOwner(self);
+    }
+
+    // release makes us the owner before notifying, so nobody can get in between. Anything else that happened to notify
+    // this task just goes round again
+    while (!mine)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        portENTER_CRITICAL(&i2cBusMux);
+        mine = busOwner == self;
+        portEXIT_CRITICAL(&i2cBusMux);
+    }
+
+    unsigned long nowUS = micros();
+    uint32_t wait = nowUS - startUS;
+    portENTER_CRITICAL(&i2cBusMux);
+    ownerPriority = priority;
+    ownerSinceUS = nowUS;
+    busStats[priority].waitSumUS += wait;
+    busStats[priority].waitMaxUS = wait > busStats[priority].waitMaxUS ? wait : busStats[priority].waitMaxUS;
+    portEXIT_CRITICAL(&i2cBusMux);
+}
+
+void i2cBusRelease()
+{
+    TaskHandle_t next = nullptr;
+    unsigned long nowUS = micros();
+
+    xSemaphoreTake(boostMutex, portMAX_DELAY);
+    portENTER_CRITICAL(&i2cBusMux);
+    I2CBusStats *stats = &busStats[ownerPriority];
+    uint32_t hold = nowUS - ownerSinceUS;
+    stats->count++;
+    stats->holdSumUS += hold;
+    stats->holdMaxUS = hold > stats->holdMaxUS ? hold : stats->holdMaxUS;
+    for (int priority = 0; priority < I2C_PRIORITY_COUNT; priority++)
+    {
+        I2CBusWaiter *waiter = waitingHead[priority];
+        if (waiter != nullptr)
+        {
+            waitingHead[priority] = waiter->next;
+            if (waitingHead[priority] == nullptr)
+            {
+                waitingTail[priority] = nullptr;
+            }
+            next = waiter->task;
+            break;
+        }
+    }
+    busOwner = next;
+    portEXIT_CRITICAL(&i2cBusMux);
+    bool restore = ownerBoosted;
+    UBaseType_t restorePriority = ownerRestorePriority;
+    ownerBoosted = false;
+    xSemaphoreGive(boostMutex);
+
+    if (next != nullptr)
+    {
+        xTaskNotifyGive(next);
+    }
+    if (restore)
+    {
+        vTaskPrioritySet(nullptr, restorePriority); // only after the wake up, dropping first could get us preempted before it
+    }
+}
+
+void reportI2CBus()
+{
+    static unsigned long lastReport = 0;
+    if (millis() - lastReport < I2C_BUS_REPORT_MS)
+    {
+        return;
+    }
+    lastReport = millis();
+
+    I2CBusStats stats[I2C_PRIORITY_COUNT];
+    portENTER_CRITICAL(&i2cBusMux);
+    unsigned long nowUS = micros();
+    uint32_t elapsedUS = nowUS - busStatsSinceUS;
+    memcpy(stats, busStats, sizeof(stats));
+    memset(busStats, 0, sizeof(busStats));
+    busStatsSinceUS = nowUS;
+    portEXIT_CRITICAL(&i2cBusMux);
+
+    uint64_t busyUS = 0;
+    for (int i = 0; i < I2C_PRIORITY_COUNT; i++)
+    {
+        busyUS += stats[i].holdSumUS;
+    }
+    Serial.printf("I2C bus %u%% busy", elapsedUS == 0 ? 0 : (uint32_t)(busyUS * 100 / elapsedUS));
+    for (int i = 0; i < I2C_PRIORITY_COUNT; i++)
+    {
+        Serial.printf(", %s: %u transfers, wait avg %uus max %uus, hold max %uus", priorityNames[i], stats[i].count,
+                      stats[i].count == 0 ? 0 : (uint32_t)(stats[i].waitSumUS / stats[i].count), stats[i].waitMaxUS, stats[i].holdMaxUS);
+    }
+    Serial.println();
+}
@@ -0,0 +1,26 @@
+#ifndef i2cBus_h
+#define i2cBus_h
+
+#include <Arduino.h>
+
+// Everything on Wire (both ADS1115s and the oled) takes the bus through here. Whoever wants it while it's busy waits in a
+// queue for their priority, and releasing hands it straight to the oldest waiter of the highest priority, so a pressure
+// read never sits behind more than the one display chunk that's already going out. Transfers run on the caller's task,
+// this only decides whose turn it is. A waiter whose task outranks the owner's lends the owner its priority until it lets
+// go, so bluetooth can't preempt the oled mid chunk while a wheel waits on it.
+
+enum I2CBusPriority
+{
+    I2C_PRIORITY_ADC,     // pressure reads, the control loop is waiting on these
+    I2C_PRIORITY_DISPLAY, // oled, sent in small chunks so it never holds the bus for long
+    I2C_PRIORITY_COUNT,
+};
+
+#define I2C_BUS_REPORT_MS 30000
+
+void setupI2CBus(); // before anything touches the bus
+void i2cBusAcquire(I2CBusPriority priority); // blocks until it's ours. Not recursive
+void i2cBusRelease();
+void reportI2CBus(); // how busy the bus was and how long everyone waited, printed every I2C_BUS_REPORT_MS
+
+#endif
@@ -1,16 +1,57 @@
 #include "input_type.h"
 #include "airSuspensionUtil.h"
+#include "i2cBus.h"
 #include <Wire.h>
 
 // when using simple high and low addressing, 0x48 is low and 0x49 is high
 
-static SemaphoreHandle_t adcReadMutex;
+// each ADS1115 only has one mux so a read owns the chip from start to finish, but the bus only for the actual transfers.
+// Both chips can convert at the same time and the oled gets the bus while they do
+#define ADS_CONVERSION_MS 9 // 128 samples/s default is ~7.8ms a conversion, plus a bit for the internal oscillator so the first poll usually finds it done
+
+static SemaphoreHandle_t adcReadMutex[2];
 
 void setupADCReadMutex()
 {
-    adcReadMutex = xSemaphoreCreateMutex();
+    adcReadMutex[0] = xSemaphoreCreateMutex();
+    adcReadMutex[1] = xSemaphoreCreateMutex();
 }
 
+#if USE_ADS == true && ADS_MOCK_BYPASS == false
+static int16_t readADCChannel(Adafruit_ADS1115 *adc, int channel)
+{
+    SemaphoreHandle_t mutex = adcReadMutex[adc == &ADS1115A ? 0 : 1];
+    while (xSemaphoreTake(mutex, 1) != pdTRUE)
+    {
+        delay(1);
+    }
+
+    i2cBusAcquire(I2C_PRIORITY_ADC);
+    adc->startADCReading(MUX_BY_CHANNEL[channel], false);
+    i2cBusRelease();
+
+    delay(ADS_CONVERSION_MS);
+    bool done = false;
+    while (!done)
+    {
+        i2cBusAcquire(I2C_PRIORITY_ADC);
+        done = adc->conversionComplete();
+        i2cBusRelease();
+        if (!done)
+        {
+            delay(1); // let the oled and the other wheels have the bus between polls
+        }
+    }
+
+    i2cBusAcquire(I2C_PRIORITY_ADC);
+    int16_t value = adc->getLastConversionResults();
+    i2cBusRelease();
+
+    xSemaphoreGive(mutex);
+    return value;
+}
+#endif
+
 int voltageToESP32AnalogValue5v(float voltage)
 {
     return voltage / 5.0f * 4096.0f;
@@ -65,6 +106,8 @@ int ESP32InternalADCAdjustValue(int readAnalogValue)
 
 InputType::InputType()
 {
+    this->lastValue = 0;
+    this->readCount = 0;
     this->input_type = NORMAL;
     this->adc = nullptr;
     this->pin = -1;
@@ -72,6 +115,8 @@ InputType::InputType()
 
 InputType::InputType(int pin, int pinModeInputOutput)
 {
+    this->lastValue = 0;
+    this->readCount = 0;
     this->input_type = NORMAL;
     this->pin = pin;
     this->adc = nullptr;
@@ -80,6 +125,8 @@ InputType::InputType(int pin, int pinModeInputOutput)
 
 InputType::InputType(int pin, Adafruit_ADS1115 *adc)
 {
+    this->lastValue = 0;
+    this->readCount = 0;
     this->input_type = ADC;
     this->pin = pin;
     this->adc = adc;
@@ -100,11 +147,12 @@ int InputType::digitalRead()
 
 int InputType::analogRead()
 {
+    int value;
     if (this->input_type == NORMAL)
     {
 
         // unlike analogRead, analogReadMilliVolts gives a proper reading
-        return ::analogReadMilliVolts(this->pin) * 1.24090909091f; // map millivoltage to line between (0,0),(3.3,4095) to simulate analogRead
+        value = ::analogReadMilliVolts(this->pin) * 1.24090909091f; // map millivoltage to line between (0,0),(3.3,4095) to simulate analogRead
     }
     else
     {
@@ -115,15 +163,7 @@ int InputType::analogRead()
         }
 #if ADS_MOCK_BYPASS == false
 
-        int value = -1;
-        while (xSemaphoreTake(adcReadMutex, 1) != pdTRUE)
-        {
-            delay(1);
-        }
-        value = AnalogADCToESP32Value(this->adc, this->adc->readADC_SingleEnded(this->pin));
-        xSemaphoreGive(adcReadMutex);
-
-        return value;
+        value = AnalogADCToESP32Value(this->adc, readADCChannel(this->adc, this->pin));
 #else
         static int i = 500;
         i += 40;
@@ -131,10 +171,19 @@ int InputType::analogRead()
         {
             i = 500;
         }
-        return i;
+        value = i;
         // return random(3686); // value of max psi on esp32
 #endif
     }
+    this->lastValue = value;
+    this->readCount++;
+    return value;
+}
+
+int InputType::lastAnalogRead(uint32_t *count)
+{
+    *count = this->readCount;
+    return this->lastValue;
 }
 
 void InputType::digitalWrite(int value)
@@ -4,6 +4,7 @@
 #include <Wire.h>
 #include <Adafruit_ADS1X15.h>
 #include <user_defines.h>
+#include <atomic>
 
 enum type
 {
@@ -17,6 +18,8 @@ private:
     type input_type = NORMAL;
     Adafruit_ADS1115 *adc;
     int pin;
+    std::atomic<int> lastValue;
+    std::atomic<uint32_t> readCount;
 
 public:
     InputType();
@@ -24,6 +27,7 @@ public:
     InputType(int pin, Adafruit_ADS1115 *adc);
     int digitalRead();
     int analogRead();
+    int lastAnalogRead(uint32_t *count); // what the last analogRead() got without reading again. count goes up by 1 every read
     void digitalWrite(int value);
     void analogWrite(int value);
 };
@@ -9,6 +9,13 @@
 #include "manifoldSaveData.h"
 #include "airSuspensionUtil.h"
 #include "tasks/tasks.h"
+#include "bootProfiler.h"
+#include "telemetry.h"
+#include "rawStream.h"
+#include "valvePulse.h"
+#include "valveDuty.h"
+#include "i2cBus.h"
+#include "bluetooth/gamepadMap.h"
 #include <directdownload.h>
 
 #include <SPIFFS.h>
@@ -18,12 +25,18 @@ void writeToSpiffsLog(char *text);
 // #define FORCE_UPDATE_TEST
 void setup()
 {
+    bootPhase(BOOT_PHASE_SETUP_START);
     Serial.begin(SERIAL_BAUD_RATE);
     Serial.println(F("Startup!"));
 
     SPIFFS.begin(true);
+    bootPhase(BOOT_PHASE_SPIFFS);
 
     beginSaveData();
+    bootPhase(BOOT_PHASE_SAVEDATA);
+
+    // internalReboot means we restarted ourselves so power is already stable and nobody needs the diagnostic dump again
+    setFastBoot(getinternalReboot());
 
     // Check if in update mode and ignore everything else and just start the web server.
     if (getupdateMode())
@@ -47,13 +60,27 @@ void setup()
 #endif
 
     setupSpiffsLog();
+    setupTelemetry();
+    setupRawStream();
+    setupValvePulse();
+    setupValveDuty();
+    setupGamepadMap();
+
+    if (!isFastBoot())
+    {
+        printAILearnedData();
+    }
 
     // clearPressureData();
 
     // trainAIModels();
 
-    delay(200); // wait for voltage stabilize
+    if (!isFastBoot())
+    {
+        delay(200); // wait for voltage stabilize
+    }
 
+    setupI2CBus();
     setupADCReadMutex();
     setupWheelLockSem();
 
@@ -63,7 +90,11 @@ void setup()
 
 #endif
 
-    delay(20);
+    if (!isFastBoot())
+    {
+        delay(20);
+    }
+    bootPhase(BOOT_PHASE_MANIFOLD);
 
     pressureInputs[0] = pressureSensorInput0;
     pressureInputs[1] = pressureSensorInput1;
@@ -77,6 +108,7 @@ void setup()
     wheel[WHEEL_REAR_DRIVER] = new Wheel(manifold->get(REAR_DRIVER_IN), manifold->get(REAR_DRIVER_OUT), pressureInputs[getpressureInputRearDriver()], levelInputRearDriver, WHEEL_REAR_DRIVER);
 
     compressor = new Compressor(compressorRelayPin, pressureInputs[getpressureInputTank()]);
+    bootPhase(BOOT_PHASE_WHEELS);
 
     if (getlearnPressureSensors())
     {
@@ -86,12 +118,14 @@ void setup()
 
     accessoryWireSetup();
     ebrakeWireSetup();
+    bootPhase(BOOT_PHASE_ACCESSORY);
 
     // TODO: make base profile work (look in other spots in app for this)
     // readProfile(getbaseProfile());// TODO: add functionality for this in the controller
     readProfile(2);
 
     setup_tasks();
+    bootPhase(BOOT_PHASE_TASKS);
 
 #if TEST_MODE == false
     // only want to rise on start if it was a full boot and not a quick reboot
@@ -106,7 +140,9 @@ void setup()
 
     setinternalReboot(false);
 
+    bootPhase(BOOT_PHASE_SETUP_DONE);
     Serial.println(F("Startup Complete"));
+    printBootPhases();
 
     // for (int i = 0; i < 200; i++) {
     //     for (int j = 0; j < 2; j++) {
@@ -124,6 +160,7 @@ void loop()
 {
     accessoryWireLoop();
     ebrakeWireLoop();
+    reportI2CBus();
     if (getinternalReboot() == true)
     {
         ESP.restart();
@@ -1,4 +1,5 @@
 #include "manifoldSaveData.h"
+#include <BTOas.h>
 
 SaveData _SaveData;
 byte currentProfile[4];
@@ -73,28 +74,132 @@ void writeToSpiffsLog(char *text)
     // writeBytes(LOG_FILE_NAME, text, strlen(text), "a");
 }
 
+// Settings schema. Keys longer than 15 chars used to get cut off at 15 when they were saved, so the old keys are kept cut off here too so nobody loses their settings.
+// Profiles and ai models need a line per index since the key has to be a string literal, update these if MAX_PROFILE_COUNT changes.
+#define schemaProfile(i)                                                   \
+    schemaInt(profile[i].pressure[0], "profile" #i "|0", 50, 0, 255),     \
+        schemaInt(profile[i].pressure[1], "profile" #i "|1", 50, 0, 255), \
+        schemaInt(profile[i].pressure[2], "profile" #i "|2", 50, 0, 255), \
+        schemaInt(profile[i].pressure[3], "profile" #i "|3", 50, 0, 255)
+
+#define schemaAIModel(i)                                                \
+    schemaDouble(aiModels[i].weights[0], "model" #i "|0", 0.1),        \
+        schemaDouble(aiModels[i].weights[1], "model" #i "|1", 0.1),    \
+        schemaDouble(aiModels[i].weights[2], "model" #i "|2", 0.0),    \
+        schemaInt(aiModels[i].isReadyToUse, "model" #i "|r", false, 0, 1)
+
+static_assert(MAX_PROFILE_COUNT == 5, "update the profile lines in settingsSchema");
+
+static const PreferencableSchemaEntry settingsSchema[] = {
+    // update related data
+    schemaInt(updateMode, "updateMode", false, 0, 1),
+    schemaString(wifiSSID, "wifiSSID", ""),
+    schemaString(wifiPassword, "wifiPassword", ""),
+    schemaInt(updateResult, "updateResult", 0, 0, 255),
+
+    schemaInt(riseOnStart, "riseOnStart", false, 0, 1),
+    schemaInt(maintainPressure, "maintainPressur", false, 0, 1),
+    schemaInt(airOutOnShutoff, "airOutOnShutoff", false, 0, 1),
+    schemaInt(heightSensorMode, "heightSensorMod", false, 0, 1),
+    schemaInt(baseProfile, "baseProfile", 2, 0, MAX_PROFILE_COUNT - 1),
+    schemaInt(raiseOnPressure, "raiseOnPressure", false, 0, 1),
+    schemaInt(internalReboot, "internalReboot", false, 0, 1),
+    schemaInt(learnPressureSensors, "learnPressureSe", false, 0, 1),
+    schemaInt(safetyMode, "safetyMode", true, 0, 1),
+    schemaInt(aiEnabled, "aiEnabled", true, 0, 1),
+
+    // pressure sensor values
+    schemaInt(pressureInputFrontPassenger, "PIFP", 0, 0, 4),
+    schemaInt(pressureInputRearPassenger, "PIRP", 1, 0, 4),
+    schemaInt(pressureInputFrontDriver, "PIFD", 2, 0, 4),
+    schemaInt(pressureInputRearDriver, "PIRD", 3, 0, 4),
+    schemaInt(pressureInputTank, "PIT", 4, 0, 4),
+
+    // things moves from inside the user config
+    schemaInt(bagMaxPressure, "bagMaxPressure", MAX_PRESSURE_SAFETY, 0, 255),
+    schemaInt(blePasskey, "blePasskey", BLE_PASSKEY, 0, 999999),
+    schemaString(bleName, "bleName", BT_NAME),
+    schemaInt(systemShutoffTimeM, "systemShutoffTi", SYSTEM_SHUTOFF_TIME_M, 0, UINT32_MAX),
+    schemaInt(compressorOnPSI, "compressorOnPSI", COMPRESSOR_ON_BELOW_PSI, 0, 255),
+    schemaInt(compressorOffPSI, "compressorOffPS", COMPRESSOR_MAX_PSI, 0, 255),
+    schemaInt(pressureSensorMax, "pressureSensorM", pressuretransducermaxPSI, 0, UINT16_MAX),
+    schemaInt(bagVolumePercentage, "bagVolumePercen", 100, 0, UINT16_MAX),
+    schemaInt(telemetryRateMS, "telemetryRateMS", 1000, 0, 60000),
+    schemaInt(joystickMode, "joystickMode", JOYSTICK_MODE_ON_OFF, 0, JOYSTICK_MODE_PROPORTIONAL),
+    schemaInt(joystickDeadzone, "joystickDeadzon", 15, 0, JOYSTICK_DEADZONE_MAX),
+    schemaInt(joystickCurve, "joystickCurve", 20, JOYSTICK_CURVE_MIN, JOYSTICK_CURVE_MAX),
+    schemaInt(joystickPeriodMS, "joystickPeriod", 250, JOYSTICK_PERIOD_MIN_MS, JOYSTICK_PERIOD_MAX_MS),
+
+    schemaProfile(0),
+    schemaProfile(1),
+    schemaProfile(2),
+    schemaProfile(3),
+    schemaProfile(4),
+};
+
+// kept separate so clearPressureData can reload just the models
+static const PreferencableSchemaEntry aiModelSchema[] = {
+    schemaAIModel(0),
+    schemaAIModel(1),
+    schemaAIModel(2),
+    schemaAIModel(3),
+};
+
+static size_t writeSchemaBackup(const PreferencableSchemaEntry *schema, size_t count, char *buffer, size_t maxLength, size_t length)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const PreferencableSchemaEntry *entry = &schema[i];
+        if (entry->pref == &_SaveData.wifiPassword)
+        {
+            continue; // this one never leaves the manifold
+        }
+        int written = 0;
+        switch (entry->type)
+        {
+        case PREFERENCABLE_INT:
+            written = snprintf(buffer + length, maxLength - length, "%s=%llu\n", entry->key, (unsigned long long)entry->pref->get().i);
+            break;
+        case PREFERENCABLE_DOUBLE:
+            written = snprintf(buffer + length, maxLength - length, "%s=%.17g\n", entry->key, entry->pref->get().d);
+            break;
+        case PREFERENCABLE_STRING:
+            written = snprintf(buffer + length, maxLength - length, "%s=%s\n", entry->key, entry->pref->getString().c_str());
+            break;
+        }
+        if (written < 0 || (size_t)written >= maxLength - length)
+        {
+            break; // out of room, stop at the last full line
+        }
+        length += written;
+    }
+    return length;
+}
+
+size_t writeSettingsBackup(char *buffer, size_t maxLength)
+{
+    size_t length = writeSchemaBackup(settingsSchema, sizeof(settingsSchema) / sizeof(settingsSchema[0]), buffer, maxLength, 0);
+    return writeSchemaBackup(aiModelSchema, sizeof(aiModelSchema) / sizeof(aiModelSchema[0]), buffer, maxLength, length);
+}
+
 void loadAILearnedDataPreferences()
 {
     // load the 4 models and learn data
+    loadPreferencableSchema(aiModelSchema, sizeof(aiModelSchema) / sizeof(aiModelSchema[0]));
     for (int i = 0; i < 4; i++)
     {
         learnDataIndex[i] = readBytes(getLogFileName((SOLENOID_AI_INDEX)i), learnData[i], LEARN_SAVE_COUNT * sizeof(PressureLearnSaveStruct)) / sizeof(PressureLearnSaveStruct);
-        char buf[15];
-        snprintf(buf, sizeof(buf), "model%i|%i", i, 0);
-        _SaveData.aiModels[i].weights[0].loadDouble(buf, 0.1);
-        snprintf(buf, sizeof(buf), "model%i|%i", i, 1);
-        _SaveData.aiModels[i].weights[1].loadDouble(buf, 0.1);
-        snprintf(buf, sizeof(buf), "model%i|%i", i, 2);
-        _SaveData.aiModels[i].weights[2].loadDouble(buf, 0.0);
-        snprintf(buf, sizeof(buf), "model%i|r", i);
-        _SaveData.aiModels[i].isReadyToUse.load(buf, false);
         _SaveData.aiModels[i].loadModel(); // copy the values to the internal model
         // Serial.println(getAIModel((SOLENOID_AI_INDEX)i)->isReadyToUse.get().i);
     }
 
     _SaveData.aiModels[SOLENOID_AI_INDEX::AI_MODEL_DOWN_FRONT].model.up = false;
     _SaveData.aiModels[SOLENOID_AI_INDEX::AI_MODEL_DOWN_REAR].model.up = false;
+}
 
+// dumps all the learn data to serial for pro. This is slow at 115200 baud so it is skipped on fast boots
+void printAILearnedData()
+{
     for (int i = 0; i < 10; i++)
         Serial.println("");
     Serial.println("BEGIN IMPORTANT DATA FOR PRO");
@@ -111,56 +216,14 @@ void loadAILearnedDataPreferences()
 void beginSaveData()
 {
 
-    // update related data
-    _SaveData.updateMode.load("updateMode", false);
-    _SaveData.wifiSSID.loadString("wifiSSID", "");
-    _SaveData.wifiPassword.loadString("wifiPassword", "");
-    _SaveData.updateResult.load("updateResult", 0);
+    // everything gets loaded in one go, the update mode check just skips the learn data
+    loadPreferencableSchema(settingsSchema, sizeof(settingsSchema) / sizeof(settingsSchema[0]));
 
     if (getupdateMode())
     {
         return;
     }
 
-    _SaveData.riseOnStart.load("riseOnStart", false);
-    _SaveData.maintainPressure.load("maintainPressure", false);
-    _SaveData.airOutOnShutoff.load("airOutOnShutoff", false);
-    _SaveData.heightSensorMode.load("heightSensorMode", false);
-    _SaveData.baseProfile.load("baseProfile", 2);
-    _SaveData.raiseOnPressure.load("raiseOnPressure", false);
-    _SaveData.internalReboot.load("internalReboot", false);
-    _SaveData.learnPressureSensors.load("learnPressureSensors", false);
-    _SaveData.safetyMode.load("safetyMode", true);
-    _SaveData.aiEnabled.load("aiEnabled", true);
-
-    // pressure sensor values
-    _SaveData.pressureInputFrontPassenger.load("PIFP", 0);
-    _SaveData.pressureInputRearPassenger.load("PIRP", 1);
-    _SaveData.pressureInputFrontDriver.load("PIFD", 2);
-    _SaveData.pressureInputRearDriver.load("PIRD", 3);
-    _SaveData.pressureInputTank.load("PIT", 4);
-
-    // things moves from inside the user config
-    _SaveData.bagMaxPressure.load("bagMaxPressure", MAX_PRESSURE_SAFETY);
-    _SaveData.blePasskey.load("blePasskey", BLE_PASSKEY);
-    _SaveData.bleName.loadString("bleName", BT_NAME);
-
-    _SaveData.systemShutoffTimeM.load("systemShutoffTimeM", SYSTEM_SHUTOFF_TIME_M);
-    _SaveData.compressorOnPSI.load("compressorOnPSI", COMPRESSOR_ON_BELOW_PSI);
-    _SaveData.compressorOffPSI.load("compressorOffPSI", COMPRESSOR_MAX_PSI);
-    _SaveData.pressureSensorMax.load("pressureSensorMax", pressuretransducermaxPSI);
-    _SaveData.bagVolumePercentage.load("bagVolumePercentage", 100);
-    for (int i = 0; i < MAX_PROFILE_COUNT; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            // first create a custom name for it. This would probably be better off done as different namespaces or something but idc
-            char buf[15];
-            snprintf(buf, sizeof(buf), "profile%i|%i", i, j);
-            _SaveData.profile[i].pressure[j].load(buf, 50);
-        }
-    }
-
     // _SaveData.upModel.weights[0].loadDouble("upmod0", 0.1);
     // _SaveData.upModel.weights[1].loadDouble("upmod1", 0.1);
     // _SaveData.upModel.weights[2].loadDouble("upmod2", -0.1);
@@ -374,6 +437,11 @@ createSaveFuncInt(compressorOnPSI, uint8_t);
 createSaveFuncInt(compressorOffPSI, uint8_t);
 createSaveFuncInt(pressureSensorMax, uint16_t);
 createSaveFuncInt(bagVolumePercentage, uint16_t);
+createSaveFuncInt(telemetryRateMS, uint32_t);
+createSaveFuncInt(joystickMode, uint8_t);
+createSaveFuncInt(joystickDeadzone, uint8_t);
+createSaveFuncInt(joystickCurve, uint8_t);
+createSaveFuncInt(joystickPeriodMS, uint16_t);
 
 float getHeightSensorMax()
 {
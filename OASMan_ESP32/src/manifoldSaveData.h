@@ -77,6 +77,11 @@ public:
     Preferencable compressorOffPSI;
     Preferencable pressureSensorMax;
     Preferencable bagVolumePercentage;
+    Preferencable telemetryRateMS;
+    Preferencable joystickMode;
+    Preferencable joystickDeadzone;
+    Preferencable joystickCurve;
+    Preferencable joystickPeriodMS;
     Profile profile[MAX_PROFILE_COUNT];
     AIModelPreference aiModels[4];
 };
@@ -107,6 +112,9 @@ extern byte currentProfile[4];
 extern bool sendProfileBT;
 
 void beginSaveData();
+void printAILearnedData();
+const char *getLogFileName(SOLENOID_AI_INDEX index);
+size_t writeSettingsBackup(char *buffer, size_t maxLength); // key=value line for every setting, returns the length
 void readProfile(byte profileIndex);
 void writeProfile(byte profileIndex);
 void savePressuresToProfile(byte profileIndex, float _WHEEL_FRONT_PASSENGER, float _WHEEL_REAR_PASSENGER, float _WHEEL_FRONT_DRIVER, float _WHEEL_REAR_DRIVER);
@@ -151,6 +159,13 @@ headerDefineSaveFunc(compressorOnPSI, uint8_t);
 headerDefineSaveFunc(compressorOffPSI, uint8_t);
 headerDefineSaveFunc(pressureSensorMax, uint16_t);
 headerDefineSaveFunc(bagVolumePercentage, uint16_t);
+headerDefineSaveFunc(telemetryRateMS, uint32_t); // 0 turns off the pressure samples, events still get recorded
+
+// bluepad32 joystick, see JoystickConfigPacket
+headerDefineSaveFunc(joystickMode, uint8_t);
+headerDefineSaveFunc(joystickDeadzone, uint8_t); // percent
+headerDefineSaveFunc(joystickCurve, uint8_t);    // tenths
+headerDefineSaveFunc(joystickPeriodMS, uint16_t);
 
 float getHeightSensorMax();
 
@@ -0,0 +1,193 @@
+#include "rawStream.h"
+#include "airSuspensionUtil.h"
+#include <atomic>
+
+struct RawStreamBatch
+{
+    uint16_t length;
+    uint8_t data[RAWSTREAM_MAX_BATCH_SIZE];
+};
+
+static RawStreamBatch ring[RAWSTREAM_RING_COUNT];
+static uint16_t nextSequence = 0; // sequence of the batch being built, everything before it is in the ring
+static uint16_t oldestSequence = 0;
+
+static RawStreamBatch building;
+static unsigned long batchStartTime = 0;
+static unsigned long lastRecordTime = 0;
+static int16_t prevSample[4];
+static bool hasPrevSample = false;
+static uint32_t prevReadCount[4]; // only touched by the raw stream task
+
+static std::atomic<int> subscribers(0);
+static portMUX_TYPE rawStreamMux = portMUX_INITIALIZER_UNLOCKED;
+
+// has to be called inside the mux
+static void startBatch(unsigned long now)
+{
+    building.length = RAWSTREAM_HEADER_SIZE;
+    uint32_t time = now;
+    memcpy(&building.data[0], &nextSequence, sizeof(uint16_t));
+    memcpy(&building.data[2], &time, sizeof(uint32_t));
+    batchStartTime = now;
+    lastRecordTime = now;
+    hasPrevSample = false; // first sample of every batch is a full one so batches decode on their own
+}
+
+// has to be called inside the mux
+static void finishBatch(unsigned long now)
+{
+    if (building.length > RAWSTREAM_HEADER_SIZE)
+    {
+        memcpy(&ring[nextSequence % RAWSTREAM_RING_COUNT], &building, sizeof(RawStreamBatch));
+        nextSequence++;
+        if ((uint16_t)(nextSequence - oldestSequence) > RAWSTREAM_RING_COUNT)
+        {
+            oldestSequence = nextSequence - RAWSTREAM_RING_COUNT;
+        }
+    }
+    startBatch(now);
+}
+
+// has to be called inside the mux. Starts a new batch if this record won't fit or too much time went by for the uint8 time difference
+static void makeRoom(uint8_t length, unsigned long now)
+{
+    if (building.length + RAWSTREAM_RECORD_HEADER_SIZE + length > RAWSTREAM_MAX_BATCH_SIZE || now - lastRecordTime > 255)
+    {
+        finishBatch(now);
+    }
+}
+
+// has to be called inside the mux, after makeRoom
+static void appendRecord(RawStreamRecordType type, const uint8_t *payload, uint8_t length, unsigned long now)
+{
+    uint8_t *out = &building.data[building.length];
+    out[0] = type;
+    out[1] = now - lastRecordTime;
+    memcpy(&out[RAWSTREAM_RECORD_HEADER_SIZE], payload, length);
+    building.length += RAWSTREAM_RECORD_HEADER_SIZE + length;
+    lastRecordTime = now;
+}
+
+void setupRawStream()
+{
+    portENTER_CRITICAL(&rawStreamMux);
+    startBatch(millis());
+    portEXIT_CRITICAL(&rawStreamMux);
+}
+
+void rawStreamSetSubscribers(int count)
+{
+    if (subscribers == 0 && count > 0)
+    {
+        // throw away whatever was half built from before, it'd go out with a stale time
+        portENTER_CRITICAL(&rawStreamMux);
+        startBatch(millis());
+        portEXIT_CRITICAL(&rawStreamMux);
+    }
+    subscribers = count;
+}
+
+void rawStreamValvesChanged()
+{
+    if (subscribers == 0 || getManifold() == nullptr)
+    {
+        return;
+    }
+    uint8_t mask = 0;
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        if (getManifold()->get(i)->isOpen())
+        {
+            mask |= 1 << i;
+        }
+    }
+    portENTER_CRITICAL(&rawStreamMux);
+    unsigned long now = millis();
+    makeRoom(RAWSTREAM_VALVES_PAYLOAD_SIZE, now);
+    appendRecord(RAWSTREAM_VALVES, &mask, RAWSTREAM_VALVES_PAYLOAD_SIZE, now);
+    portEXIT_CRITICAL(&rawStreamMux);
+}
+
+uint16_t rawStreamNextSequence()
+{
+    portENTER_CRITICAL(&rawStreamMux);
+    uint16_t sequence = nextSequence;
+    portEXIT_CRITICAL(&rawStreamMux);
+    return sequence;
+}
+
+uint16_t rawStreamRead(uint16_t &sequence, uint8_t *buffer)
+{
+    uint16_t length = 0;
+    portENTER_CRITICAL(&rawStreamMux);
+    if ((uint16_t)(sequence - oldestSequence) >= RAWSTREAM_RING_COUNT && sequence != nextSequence)
+    {
+        sequence = oldestSequence; // fell behind, skip ahead. The client sees the gap in the sequence numbers
+    }
+    if (sequence != nextSequence)
+    {
+        RawStreamBatch *batch = &ring[sequence % RAWSTREAM_RING_COUNT];
+        length = batch->length;
+        memcpy(buffer, batch->data, length);
+    }
+    portEXIT_CRITICAL(&rawStreamMux);
+    return length;
+}
+
+// takes whatever the wheel tasks read last instead of converting again, so streaming never adds work on the adcs.
+// Nothing gets recorded until at least one corner has a new reading
+static void sample()
+{
+    int16_t values[4];
+    bool fresh = false;
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t count;
+        values[i] = getWheel(i)->getPressurePin()->lastAnalogRead(&count);
+        fresh = fresh || count != prevReadCount[i];
+        prevReadCount[i] = count;
+    }
+    if (!fresh)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&rawStreamMux);
+    unsigned long now = millis();
+    makeRoom(RAWSTREAM_SAMPLE_PAYLOAD_SIZE, now); // before picking delta or not, a new batch has to start with a full sample
+    bool delta = hasPrevSample;
+    int16_t diffs[4];
+    for (int i = 0; i < 4; i++)
+    {
+        diffs[i] = values[i] - prevSample[i];
+        if (diffs[i] > 2047 || diffs[i] < -2048)
+        {
+            delta = false;
+        }
+    }
+    uint8_t payload[RAWSTREAM_SAMPLE_PAYLOAD_SIZE];
+    rawStreamPack12(payload, delta ? diffs : values);
+    appendRecord(delta ? RAWSTREAM_SAMPLE_DELTA : RAWSTREAM_SAMPLE, payload, RAWSTREAM_SAMPLE_PAYLOAD_SIZE, now);
+    memcpy(prevSample, values, sizeof(prevSample));
+    hasPrevSample = true;
+    if (now - batchStartTime >= RAWSTREAM_BATCH_MS)
+    {
+        finishBatch(now);
+    }
+    portEXIT_CRITICAL(&rawStreamMux);
+}
+
+// runs in its own task, only does anything while someone is subscribed
+void rawStreamLoop()
+{
+    if (subscribers == 0)
+    {
+        delay(100);
+        return;
+    }
+    unsigned long start = millis();
+    sample();
+    long wait = (1000 / RAWSTREAM_RATE_HZ) - (long)(millis() - start);
+    delay(wait > 0 ? wait : 1);
+}
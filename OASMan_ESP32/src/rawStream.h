@@ -0,0 +1,22 @@
+#ifndef rawStream_h
+#define rawStream_h
+
+#include <Arduino.h>
+#include <BTOas.h>
+
+// Raw pressure stream for live graphing. While at least one client is subscribed to the raw stream characteristic, a task picks up the 4 corner
+// pressure readings the wheel tasks take anyways and batches them up with the valve open/close events in between. The bluetooth side picks finished batches out of a small ring.
+// See RawStreamRecordType in BTOas.h for the format
+
+#define RAWSTREAM_RATE_HZ 50 // how often to look for new readings. The wheels read every 100ms when idle and faster while a routine is running. The timestamps show the real spacing
+#define RAWSTREAM_BATCH_MS 100 // send a batch at least this often even if it isn't full
+#define RAWSTREAM_RING_COUNT 8
+
+void setupRawStream();
+void rawStreamSetSubscribers(int count);
+void rawStreamValvesChanged();
+uint16_t rawStreamNextSequence(); // sequence the next finished batch will get
+uint16_t rawStreamRead(uint16_t &sequence, uint8_t *buffer); // copies out batch number sequence (or the oldest one still around if it already got overwritten), returns 0 if it isn't ready yet
+void rawStreamLoop();
+
+#endif
@@ -1,4 +1,8 @@
 #include "tasks.h"
+#include "bootProfiler.h"
+#include "telemetry.h"
+#include "rawStream.h"
+#include "i2cBus.h"
 
 bool bp32ServiceStarted = false;
 
@@ -6,19 +10,25 @@ void writeToSpiffsLog(char *text);
 
 void task_bluetooth(void *parameters)
 {
-    delay(200); // just wait a moment i guess this is legacy
+    if (!isFastBoot())
+    {
+        delay(200); // just wait a moment i guess this is legacy
+    }
 
-    // wait for bp32 service to boot
+    // wait for bp32 service to boot. bp32ServiceStarted only goes true once bp32_setup returned, that's all a fast boot waits on
     while (bp32ServiceStarted == false)
     {
         delay(1);
     }
-    delay(50);
-
-    delay(1000); // wait for the bluepad32 to start first
+    if (!isFastBoot())
+    {
+        delay(50);
+        delay(1000); // wait for the bluepad32 to start first
+    }
 
     Serial.println(F("Bluetooth Rest Service Beginning"));
     ble_setup();
+    bootPhase(BOOT_PHASE_BLE_READY);
     delay(10);
     for (;;)
     {
@@ -39,7 +49,10 @@ void easterEggFunc()
 void task_screen(void *parameters)
 {
     // SSD1306_SWITCHCAPVCC = generate display voltage from 3.3V internally
-    if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS))
+    i2cBusAcquire(I2C_PRIORITY_DISPLAY);
+    bool displayStarted = display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS);
+    i2cBusRelease();
+    if (!displayStarted)
     {
         for (;;)
         {
@@ -89,72 +102,121 @@ void task_wheel(void *parameters)
     }
 }
 
+void task_telemetry(void *parameters)
+{
+    for (;;)
+    {
+        telemetryLoop();
+    }
+}
+
+void task_rawStream(void *parameters)
+{
+    for (;;)
+    {
+        rawStreamLoop();
+    }
+}
+
+enum TaskSlot
+{
+    TASK_BLUETOOTH,
+    TASK_OLED,
+    TASK_COMPRESSOR,
+    TASK_WHEEL, // one per wheel, in wheel index order
+    TASK_BP32 = TASK_WHEEL + 4,
+    TASK_TELEMETRY,
+    TASK_RAW_STREAM,
+    TASK_TRAIN_AI,
+    TASK_COUNT,
+};
+
+struct TaskPlan
+{
+    const char *name;
+    uint32_t stackSize;
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+static const TaskPlan taskPlans[TASK_COUNT] = {
+    {"Bluetooth", STACK_BLUETOOTH, PRIORITY_RADIO, CORE_RADIO},
+    {"OLED", STACK_OLED, PRIORITY_UI, CORE_RADIO},
+    {"Compressor", STACK_COMPRESSOR, PRIORITY_CONTROL, CORE_CONTROL},
+    {"Wheel FP", STACK_WHEEL, PRIORITY_CONTROL, CORE_CONTROL},
+    {"Wheel RP", STACK_WHEEL, PRIORITY_CONTROL, CORE_CONTROL},
+    {"Wheel FD", STACK_WHEEL, PRIORITY_CONTROL, CORE_CONTROL},
+    {"Wheel RD", STACK_WHEEL, PRIORITY_CONTROL, CORE_CONTROL},
+    {"BP32 Task", STACK_BP32, PRIORITY_RADIO, CORE_RADIO},
+    {"Telemetry", STACK_TELEMETRY, PRIORITY_BACKGROUND, CORE_CONTROL},
+    {"Raw Stream", STACK_RAW_STREAM, PRIORITY_SAMPLING, CORE_CONTROL},
+    // lowest there is, it only ever runs when core 1 would otherwise be idle
+    {"trainAI", STACK_TRAIN_AI, PRIORITY_TRAINING, CORE_CONTROL},
+};
+static TaskHandle_t taskHandles[TASK_COUNT];
+static portMUX_TYPE taskHandlesMux = portMUX_INITIALIZER_UNLOCKED; // so a task that ends itself can't go while it's being looked at
+
 void task_trainAI(void *parameters)
 {
     trainAIModels();
+    portENTER_CRITICAL(&taskHandlesMux);
+    taskHandles[TASK_TRAIN_AI] = NULL; // the handle goes stale once it's deleted
+    portEXIT_CRITICAL(&taskHandlesMux);
     vTaskDelete(NULL);
 }
 
-void setup_tasks()
+static void startTask(TaskSlot slot, TaskFunction_t function, void *parameters)
 {
+    const TaskPlan *plan = &taskPlans[slot];
+    if (xTaskCreatePinnedToCore(function, plan->name, plan->stackSize, parameters, plan->priority, &taskHandles[slot], plan->core) != pdPASS)
+    {
+        taskHandles[slot] = NULL;
+        Serial.printf("Failed to start task %s\n", plan->name);
+    }
+}
 
-    //   Bluetooth Task
-
-    xTaskCreate(
-        task_bluetooth,
-        "Bluetooth",
-        512 * 6,
-        NULL,
-        1000,
-        NULL);
-
+void setup_tasks()
+{
+    startTask(TASK_BLUETOOTH, task_bluetooth, NULL);
 #if SCREEN_ENABLED == true
-    // Manifold OLED Task
-    xTaskCreate(
-        task_screen,
-        "OLED",
-        512 * 4,
-        NULL,
-        1000,
-        NULL);
+    startTask(TASK_OLED, task_screen, NULL);
 #endif
-
-    // Compressor Control Task
-    xTaskCreate(
-        task_compressor,
-        "Compressor Control",
-        512 * 4,
-        NULL,
-        1000,
-        NULL);
-
-    // Wheel Tasks
+    startTask(TASK_COMPRESSOR, task_compressor, NULL);
     for (int i = 0; i < 4; i++)
     {
-        xTaskCreate(
-            task_wheel,
-            "Wheel Task",
-            512 * 5,
-            getWheel(i),
-            1000,
-            NULL);
+        startTask((TaskSlot)(TASK_WHEEL + i), task_wheel, getWheel(i));
     }
+    startTask(TASK_BP32, task_bp32_controller, NULL);
+    startTask(TASK_TELEMETRY, task_telemetry, NULL); // only samples and writes to flash
+    startTask(TASK_RAW_STREAM, task_rawStream, NULL); // sleeps unless a client subscribed to the raw pressure stream
+    startTask(TASK_TRAIN_AI, task_trainAI, NULL);
+}
 
-    // bluepad32 Controller Task
-    xTaskCreate(
-        task_bp32_controller,
-        "BP32 Task",
-        512 * 5,
-        NULL,
-        1000,
-        NULL);
-
-    //  Train AI Task
-    xTaskCreate(
-        task_trainAI,
-        "trainAI",
-        512 * 4,
-        NULL,
-        1000,
-        NULL);
-}
\ No newline at end of file
+void printTaskDiagnostics()
+{
+    Serial.println(F("TASK name        core prio  stack   used   free suggest"));
+    for (int i = 0; i < TASK_COUNT; i++)
+    {
+        const TaskPlan *plan = &taskPlans[i];
+        uint32_t leastFree = 0;
+        UBaseType_t priority = 0;
+        portENTER_CRITICAL(&taskHandlesMux);
+        TaskHandle_t handle = taskHandles[i];
+        if (handle != NULL)
+        {
+            // esp-idf counts stacks in bytes, so the high water mark is the fewest bytes that have ever been free
+            leastFree = uxTaskGetStackHighWaterMark(handle);
+            priority = uxTaskPriorityGet(handle);
+        }
+        portEXIT_CRITICAL(&taskHandlesMux);
+        if (handle == NULL)
+        {
+            continue; // never started (no screen), or finished like trainAI
+        }
+        uint32_t used = plan->stackSize - leastFree;
+        uint32_t margin = used / 4 > STACK_MARGIN_MIN ? used / 4 : STACK_MARGIN_MIN;
+        uint32_t suggest = (used + margin + 255) / 256 * 256;
+        Serial.printf("TASK %-12s %4i %4u %6u %6u %6u %6u\n", plan->name, plan->core, priority, plan->stackSize,
+                      used, leastFree, suggest);
+    }
+}
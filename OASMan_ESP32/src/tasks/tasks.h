@@ -8,6 +8,34 @@
 #include "bluetooth/ble.h"
 #include "bluetooth/bp32.h"
 
+// Everything that has to keep time (wheels, compressor, raw samples) runs on core 1 with the arduino loop, above it in
+// priority. Bluetooth (btstack, bluepad32 and our rest service) lives on core 0 next to the controller, all of it below
+// the bt controller and esp_timer tasks so the radio and the valve pulses never wait on us. The oled and telemetry just get
+// whatever time is left, and ai training only what's left after that.
+#define CORE_RADIO 0
+#define CORE_CONTROL 1
+
+#define PRIORITY_CONTROL 10   // wheels and compressor
+#define PRIORITY_SAMPLING 8   // raw stream
+#define PRIORITY_RADIO 6      // ble rest service and bluepad32
+#define PRIORITY_UI 2         // oled
+#define PRIORITY_BACKGROUND 1 // telemetry
+#define PRIORITY_TRAINING 0   // ai training, shares with the idle task so it can't hold off telemetry or the arduino loop
+
+// stack sizes in bytes. These are NOT tuned yet, they're the same sizes the tasks always had. Run the tasks
+// serial command on a car that's been driven a while and use what it suggests. It prints the most each one has ever used
+#define STACK_BLUETOOTH (512 * 6)
+#define STACK_OLED (512 * 4)
+#define STACK_COMPRESSOR (512 * 4)
+#define STACK_WHEEL (512 * 5)
+#define STACK_BP32 (512 * 5)
+#define STACK_TELEMETRY (512 * 5)
+#define STACK_RAW_STREAM (512 * 4)
+#define STACK_TRAIN_AI (512 * 4)
+
+#define STACK_MARGIN_MIN 512 // suggested sizes leave at least this much on top of the most used
+
 void setup_tasks();
+void printTaskDiagnostics(); // core, priority and stack use of every task we started
 
 #endif
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "telemetry.h"
+#include "airSuspensionUtil.h"
+#include "bootProfiler.h"
+#include <esp_partition.h>
+
+static const esp_partition_t *telemetryPartition = nullptr;
+static uint32_t slotCount = 0;
+static uint32_t nextSlot = 0;
+static uint32_t nextSequence = 0;
+
+// double buffered pages. Writers fill activePage, the task writes out pendingPage
+static uint8_t pages[2][TELEMETRY_PAGE_SIZE];
+static int activePage = 0;
+static uint16_t activeLength = 0;
+static int pendingPage = -1;
+static uint16_t pendingLength = 0;
+static uint32_t droppedRecords = 0;
+static portMUX_TYPE telemetryMux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t telemetrySem;
+
+// has to be called inside the mux
+static void startPage(int page)
+{
+    memset(pages[page], 0xFF, TELEMETRY_PAGE_SIZE);
+    TelemetryPageHeader header;
+    header.magic = TELEMETRY_PAGE_MAGIC;
+    header.sequence = nextSequence++;
+    header.timeUS = esp_timer_get_time();
+    memcpy(pages[page], &header, sizeof(header));
+    activePage = page;
+    activeLength = sizeof(header);
+}
+
+// has to be called inside the mux. Returns false if the task hasn't written out the last page yet
+static bool swapPages()
+{
+    if (pendingPage != -1)
+    {
+        return false;
+    }
+    pendingPage = activePage;
+    pendingLength = activeLength;
+    startPage(activePage ^ 1);
+    return true;
+}
+
+// find where we left off by looking for the newest page in the partition
+static void findNextSlot()
+{
+    bool found = false;
+    uint32_t newestSequence = 0;
+    uint32_t newestSlot = 0;
+    for (uint32_t i = 0; i < slotCount; i++)
+    {
+        TelemetryPageHeader header;
+        if (esp_partition_read(telemetryPartition, i * TELEMETRY_PAGE_SIZE, &header, sizeof(header)) != ESP_OK)
+        {
+            continue;
+        }
+        if (header.magic == TELEMETRY_PAGE_MAGIC && (!found || header.sequence > newestSequence))
+        {
+            found = true;
+            newestSequence = header.sequence;
+            newestSlot = i;
+        }
+    }
+    nextSlot = found ? (newestSlot + 1) % slotCount : 0;
+    nextSequence = found ? newestSequence + 1 : 0;
+    // not on a sector boundary means the rest of this sector is still erased from last time, otherwise writePage will erase it
+}
+
+static void writePage(const uint8_t *page, uint16_t length)
+{
+    uint32_t offset = nextSlot * TELEMETRY_PAGE_SIZE;
+    if (offset % TELEMETRY_SECTOR_SIZE == 0)
+    {
+        esp_partition_erase_range(telemetryPartition, offset, TELEMETRY_SECTOR_SIZE);
+    }
+    esp_partition_write(telemetryPartition, offset, page, length);
+    nextSlot = (nextSlot + 1) % slotCount;
+}
+
+void setupTelemetry()
+{
+    // older builds took whatever rate they were sent
+    uint32_t rate = gettelemetryRateMS();
+    if (telemetryClampRate(rate) != rate)
+    {
+        settelemetryRateMS(telemetryClampRate(rate));
+    }
+
+    telemetryPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, TELEMETRY_PARTITION_LABEL);
+    if (telemetryPartition == nullptr)
+    {
+        // boards that were only ever updated over the air still have the old partition table
+        Serial.println(F("No telemetry partition, telemetry disabled"));
+        return;
+    }
+    slotCount = telemetryPartition->size / TELEMETRY_PAGE_SIZE;
+    telemetrySem = xSemaphoreCreateBinary();
+    findNextSlot();
+
+    portENTER_CRITICAL(&telemetryMux);
+    startPage(0);
+    portEXIT_CRITICAL(&telemetryMux);
+
+    uint8_t boot[2] = {(uint8_t)esp_reset_reason(), isFastBoot()};
+    telemetryRecord(TELEMETRY_BOOT, boot, sizeof(boot));
+    log_i("Telemetry started at slot %u of %u", nextSlot, slotCount);
+}
+
+void telemetryRecord(TelemetryRecordType type, const void *payload, uint8_t length)
+{
+    if (telemetryPartition == nullptr)
+    {
+        return;
+    }
+    TelemetryRecordHeader header;
+    header.type = type;
+    header.timeUS = (uint32_t)esp_timer_get_time();
+
+    bool wake = false;
+    portENTER_CRITICAL(&telemetryMux);
+    if (activeLength + sizeof(header) + length > TELEMETRY_PAGE_SIZE)
+    {
+        if (swapPages())
+        {
+            wake = true;
+        }
+        else
+        {
+            droppedRecords++;
+            portEXIT_CRITICAL(&telemetryMux);
+            return;
+        }
+    }
+    memcpy(&pages[activePage][activeLength], &header, sizeof(header));
+    memcpy(&pages[activePage][activeLength + sizeof(header)], payload, length);
+    activeLength += sizeof(header) + length;
+    portEXIT_CRITICAL(&telemetryMux);
+
+    if (wake)
+    {
+        xSemaphoreGive(telemetrySem);
+    }
+}
+
+void telemetryValvesChanged()
+{
+    if (getManifold() == nullptr)
+    {
+        return;
+    }
+    uint8_t mask = 0;
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        if (getManifold()->get(i)->isOpen())
+        {
+            mask |= 1 << i;
+        }
+    }
+    telemetryRecord(TELEMETRY_VALVES, &mask, sizeof(mask));
+}
+
+void telemetryCompressorChanged()
+{
+    if (getCompressor() == nullptr)
+    {
+        return;
+    }
+    uint8_t state = getCompressor()->isOn() | (getCompressor()->isFrozen() << 1);
+    telemetryRecord(TELEMETRY_COMPRESSOR, &state, sizeof(state));
+}
+
+void telemetryRoutineStart(uint8_t wheel, uint8_t goal, uint8_t start, bool quick)
+{
+    uint8_t payload[4] = {wheel, goal, start, quick};
+    telemetryRecord(TELEMETRY_ROUTINE_START, payload, sizeof(payload));
+}
+
+void telemetryRoutineStop(uint8_t wheel, uint8_t end)
+{
+    uint8_t payload[2] = {wheel, end};
+    telemetryRecord(TELEMETRY_ROUTINE_STOP, payload, sizeof(payload));
+}
+
+void telemetryFlush()
+{
+    if (telemetryPartition == nullptr)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&telemetryMux);
+    bool swapped = activeLength > sizeof(TelemetryPageHeader) && swapPages();
+    portEXIT_CRITICAL(&telemetryMux);
+    if (swapped)
+    {
+        xSemaphoreGive(telemetrySem);
+    }
+}
+
+uint32_t telemetryGetSize()
+{
+    return telemetryPartition == nullptr ? 0 : telemetryPartition->size;
+}
+
+uint16_t telemetryRead(uint32_t offset, uint8_t *buffer, uint16_t length)
+{
+    if (telemetryPartition == nullptr || offset >= telemetryPartition->size)
+    {
+        return 0;
+    }
+    if (offset + length > telemetryPartition->size)
+    {
+        length = telemetryPartition->size - offset;
+    }
+    if (esp_partition_read(telemetryPartition, offset, buffer, length) != ESP_OK)
+    {
+        return 0;
+    }
+    return length;
+}
+
+static void samplePressures()
+{
+    uint16_t pressures[5];
+    for (int i = 0; i < 4; i++)
+    {
+        pressures[i] = getWheel(i)->getSelectedInputValue() * 10;
+    }
+    float tank = getCompressor()->getTankPressure();
+    pressures[_TANK_INDEX] = tank > 0 ? tank * 10 : 0;
+    telemetryRecord(TELEMETRY_PRESSURES, pressures, sizeof(pressures));
+}
+
+// runs in its own low priority task. Samples pressures at the set rate and writes out pages as they fill up
+void telemetryLoop()
+{
+    if (telemetryPartition == nullptr)
+    {
+        delay(1000);
+        return;
+    }
+    uint32_t rate = telemetryClampRate(gettelemetryRateMS());
+    xSemaphoreTake(telemetrySem, pdMS_TO_TICKS(rate == 0 ? 1000 : rate));
+
+    portENTER_CRITICAL(&telemetryMux);
+    int page = pendingPage;
+    uint16_t length = pendingLength;
+    portEXIT_CRITICAL(&telemetryMux);
+
+    if (page != -1)
+    {
+        writePage(pages[page], length);
+        portENTER_CRITICAL(&telemetryMux);
+        pendingPage = -1;
+        portEXIT_CRITICAL(&telemetryMux);
+        if (droppedRecords > 0)
+        {
+            log_i("Telemetry dropped %u records", droppedRecords);
+            droppedRecords = 0;
+        }
+    }
+
+    // compressor frozen doesn't go through the relay so check it here
+    static bool prevFrozen = false;
+    if (getCompressor()->isFrozen() != prevFrozen)
+    {
+        prevFrozen = !prevFrozen;
+        telemetryCompressorChanged();
+    }
+
+    static unsigned long lastSample = 0;
+    if (rate > 0 && millis() - lastSample >= rate)
+    {
+        lastSample = millis();
+        samplePressures();
+    }
+}
+
+uint32_t telemetryClampRate(uint32_t rateMS)
+{
+    return rateMS != 0 && rateMS < TELEMETRY_MIN_RATE_MS ? TELEMETRY_MIN_RATE_MS : rateMS;
+}
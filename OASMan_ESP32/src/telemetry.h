@@ -0,0 +1,56 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <Arduino.h>
+#include <BTOas.h>
+
+// Telemetry recorder. Writes a compact binary log to the "telemetry" flash partition so we can look at what the manifold actually did after the fact.
+// Records go into one of 2 ram pages, when a page fills up it is handed to a low priority task which writes it out to flash while the other page keeps filling.
+// The partition is used as a ring, the oldest sector gets erased once it wraps around.
+// Decode a dump with OASMan_ESP32/tools/telemetry_decode.py
+
+#define TELEMETRY_PARTITION_LABEL "telemetry"
+#define TELEMETRY_PAGE_SIZE 1024
+#define TELEMETRY_PAGE_MAGIC 0x5453414F // "OAST" when read as bytes
+#define TELEMETRY_SECTOR_SIZE 4096
+#define TELEMETRY_MIN_RATE_MS 100 // anything faster just spins the task and wears through the flash ring
+
+// NOTE: the decoder has a copy of these, update it if you change anything here
+enum TelemetryRecordType
+{
+    TELEMETRY_PRESSURES = 1,     // 5 x uint16 psi*10 (fp, rp, fd, rd, tank)
+    TELEMETRY_VALVES = 2,        // uint8 valve mask, bit = SOLENOID_INDEX
+    TELEMETRY_COMPRESSOR = 3,    // uint8 bit0 = on, bit1 = frozen
+    TELEMETRY_ROUTINE_START = 4, // uint8 wheel, uint8 goal psi, uint8 start psi, uint8 quick
+    TELEMETRY_ROUTINE_STOP = 5,  // uint8 wheel, uint8 end psi
+    TELEMETRY_BOOT = 6,          // uint8 reset reason, uint8 fast boot
+};
+
+// every page starts with this, records follow right after. Unused space is left as 0xFF
+struct __attribute__((packed)) TelemetryPageHeader
+{
+    uint32_t magic;
+    uint32_t sequence; // increases forever so the decoder can put the pages back in order
+    uint64_t timeUS;   // full timestamp, records only store the bottom 32 bits
+};
+
+// every record starts with this, followed by the payload for its type
+struct __attribute__((packed)) TelemetryRecordHeader
+{
+    uint8_t type;
+    uint32_t timeUS;
+};
+
+void setupTelemetry();
+void telemetryRecord(TelemetryRecordType type, const void *payload, uint8_t length);
+void telemetryValvesChanged();
+void telemetryCompressorChanged();
+void telemetryRoutineStart(uint8_t wheel, uint8_t goal, uint8_t start, bool quick);
+void telemetryRoutineStop(uint8_t wheel, uint8_t end);
+void telemetryFlush(); // pushes out the partially filled page
+uint32_t telemetryGetSize();
+uint16_t telemetryRead(uint32_t offset, uint8_t *buffer, uint16_t length);
+void telemetryLoop();
+uint32_t telemetryClampRate(uint32_t rateMS); // 0 stays off, otherwise no faster than TELEMETRY_MIN_RATE_MS
+
+#endif
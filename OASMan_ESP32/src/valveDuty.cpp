@@ -0,0 +1,131 @@
+#include "valveDuty.h"
+#include "airSuspensionUtil.h"
+#include <esp_timer.h>
+
+struct ValveDuty
+{
+    uint16_t duty; // 0 when this valve isn't being run
+    uint16_t periodMS;
+    unsigned long startMS; // when the current period started
+    bool open;
+};
+
+static ValveDuty valves[SOLENOID_COUNT];
+static esp_timer_handle_t dutyTimer;
+static bool dutyTimerRunning = false;
+// held across the valve open/close too, so a tick that decided to open a valve can't do it after valveDutySet already closed it
+static SemaphoreHandle_t valveDutyMutex;
+
+// has to hold the mutex
+static void setValveOpen(int i, bool open)
+{
+    if (open)
+    {
+        getManifold()->get(i)->open();
+    }
+    else
+    {
+        getManifold()->get(i)->close();
+    }
+    valves[i].open = open;
+}
+
+// how long it's open each period, kept to something the valve can actually do
+static uint32_t openTimeMS(ValveDuty *valve)
+{
+    uint32_t openMS = (uint32_t)valve->duty * valve->periodMS / VALVE_DUTY_MAX;
+    if (openMS < VALVE_DUTY_MIN_OPEN_MS)
+    {
+        openMS = VALVE_DUTY_MIN_OPEN_MS;
+    }
+    if (openMS + VALVE_DUTY_MIN_CLOSED_MS > valve->periodMS)
+    {
+        openMS = valve->periodMS;
+    }
+    return openMS;
+}
+
+// runs on the esp_timer task every VALVE_DUTY_TICK_MS while anything has a duty
+static void dutyTimerCallback(void *arg)
+{
+    xSemaphoreTake(valveDutyMutex, portMAX_DELAY);
+    unsigned long now = millis();
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        ValveDuty *valve = &valves[i];
+        if (valve->duty == 0)
+        {
+            continue;
+        }
+        uint32_t elapsed = now - valve->startMS;
+        if (elapsed >= valve->periodMS)
+        {
+            // next period. Skips ahead instead of drifting if the timer ran late
+            valve->startMS += (elapsed / valve->periodMS) * valve->periodMS;
+            elapsed %= valve->periodMS;
+        }
+        bool open = elapsed < openTimeMS(valve);
+        if (open != valve->open)
+        {
+            setValveOpen(i, open);
+        }
+    }
+    xSemaphoreGive(valveDutyMutex);
+}
+
+void setupValveDuty()
+{
+    valveDutyMutex = xSemaphoreCreateMutex();
+    esp_timer_create_args_t args = {};
+    args.callback = dutyTimerCallback;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "valveDuty";
+    esp_timer_create(&args, &dutyTimer);
+}
+
+void valveDutySet(int valve, uint16_t duty, uint16_t periodMS)
+{
+    if (duty > VALVE_DUTY_MAX)
+    {
+        duty = VALVE_DUTY_MAX;
+    }
+    ValveDuty *v = &valves[valve];
+
+    xSemaphoreTake(valveDutyMutex, portMAX_DELAY);
+    if (duty == 0)
+    {
+        if (v->duty != 0)
+        {
+            setValveOpen(valve, false);
+        }
+    }
+    else if (v->duty == 0)
+    {
+        // starts open so there's no wait for the first period
+        v->startMS = millis();
+        setValveOpen(valve, true);
+    }
+    v->duty = duty;
+    v->periodMS = periodMS;
+
+    bool anyActive = false;
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        anyActive = anyActive || valves[i].duty != 0;
+    }
+    if (anyActive && !dutyTimerRunning)
+    {
+        esp_timer_start_periodic(dutyTimer, VALVE_DUTY_TICK_MS * 1000);
+    }
+    if (!anyActive && dutyTimerRunning)
+    {
+        esp_timer_stop(dutyTimer);
+    }
+    dutyTimerRunning = anyActive;
+    xSemaphoreGive(valveDutyMutex);
+}
+
+bool valveDutyActive(int valve)
+{
+    return valves[valve].duty != 0;
+}
@@ -0,0 +1,19 @@
+#ifndef valveDuty_h
+#define valveDuty_h
+
+#include <Arduino.h>
+
+// Proportional valve control for the joystick. Valves are only ever open or closed, so flow is set by how much of each period
+// a valve spends open. One periodic esp_timer runs them all, and only while at least one valve has a duty set.
+// A valve that gets a duty starts its period right away (open first) so there's no waiting for the next cycle.
+
+#define VALVE_DUTY_MAX 1000         // duty is per mille, this holds the valve open
+#define VALVE_DUTY_TICK_MS 10       // timer resolution
+#define VALVE_DUTY_MIN_OPEN_MS 20   // solenoids don't really open for anything shorter than this
+#define VALVE_DUTY_MIN_CLOSED_MS 20 // or close, so something this close to full just stays open
+
+void setupValveDuty();
+void valveDutySet(int valve, uint16_t duty, uint16_t periodMS); // 0 closes the valve and stops managing it. Index is SOLENOID_INDEX
+bool valveDutyActive(int valve);
+
+#endif
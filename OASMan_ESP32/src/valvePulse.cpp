@@ -0,0 +1,149 @@
+#include "valvePulse.h"
+#include "airSuspensionUtil.h"
+#include <esp_timer.h>
+
+#define VALVE_PULSE_NO_OWNER 0xFFFF
+
+struct ValvePulse
+{
+    esp_timer_handle_t timer;
+    uint16_t owner;      // connection handle that started it, VALVE_PULSE_NO_OWNER when idle
+    uint16_t durationMS; // how long it stays open each time
+    uint16_t intervalMS; // open to open time when repeating
+    uint16_t remaining;  // repeats left after the current one
+    bool open;
+    int64_t dueUS; // when the timer that's armed now goes off
+};
+
+static ValvePulse pulses[SOLENOID_COUNT];
+// held across the valve open/close too, not just the bookkeeping. Otherwise a timer firing on the esp_timer task could
+// close a valve and then have a start that decided to open it before that go ahead and open it with nothing left to close it
+static SemaphoreHandle_t valvePulseMutex;
+
+// has to hold the mutex
+static void armPulse(ValvePulse *pulse, uint32_t ms)
+{
+    pulse->dueUS = esp_timer_get_time() + (int64_t)ms * 1000;
+    esp_timer_start_once(pulse->timer, (uint64_t)ms * 1000);
+}
+
+// has to hold the mutex
+static void stopPulse(int valve)
+{
+    ValvePulse *pulse = &pulses[valve];
+    esp_timer_stop(pulse->timer);
+    if (pulse->open)
+    {
+        getManifold()->get(valve)->close();
+    }
+    pulse->owner = VALVE_PULSE_NO_OWNER;
+    pulse->open = false;
+}
+
+// runs on the esp_timer task. Closes the valve when the open time is up, and opens it again for the next repeat
+static void pulseTimerCallback(void *arg)
+{
+    int valve = (int)(intptr_t)arg;
+    ValvePulse *pulse = &pulses[valve];
+
+    xSemaphoreTake(valvePulseMutex, portMAX_DELAY);
+    // if it got stopped or started over while this was waiting on the mutex, the timer that's armed now is the one that counts
+    if (pulse->owner != VALVE_PULSE_NO_OWNER && esp_timer_get_time() >= pulse->dueUS)
+    {
+        if (pulse->open)
+        {
+            getManifold()->get(valve)->close();
+            pulse->open = false;
+            if (pulse->remaining > 0)
+            {
+                pulse->remaining--;
+                armPulse(pulse, pulse->intervalMS - pulse->durationMS);
+            }
+            else
+            {
+                pulse->owner = VALVE_PULSE_NO_OWNER;
+            }
+        }
+        else
+        {
+            getManifold()->get(valve)->open();
+            pulse->open = true;
+            armPulse(pulse, pulse->durationMS);
+        }
+    }
+    xSemaphoreGive(valvePulseMutex);
+}
+
+void setupValvePulse()
+{
+    valvePulseMutex = xSemaphoreCreateMutex();
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        pulses[i].owner = VALVE_PULSE_NO_OWNER;
+        pulses[i].open = false;
+        esp_timer_create_args_t args = {};
+        args.callback = pulseTimerCallback;
+        args.arg = (void *)(intptr_t)i;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "valvePulse";
+        esp_timer_create(&args, &pulses[i].timer);
+    }
+}
+
+void valvePulseStart(uint16_t owner, ValvePulsePacket *packet)
+{
+    uint16_t intervalMS = packet->getRepeatInterval();
+    uint16_t repeatCount = packet->getRepeatCount();
+    xSemaphoreTake(valvePulseMutex, portMAX_DELAY);
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        ValvePulse *pulse = &pulses[i];
+        uint16_t durationMS = packet->getDuration(i);
+        if (durationMS == 0)
+        {
+            // not in this one, so if this client was pulsing it, that's over now
+            if (pulse->owner == owner)
+            {
+                stopPulse(i);
+            }
+            continue;
+        }
+        if (durationMS > VALVE_PULSE_MAX_MS)
+        {
+            durationMS = VALVE_PULSE_MAX_MS;
+        }
+
+        esp_timer_stop(pulse->timer); // a new pulse replaces whatever was running on this valve. If it's already open it just stays open for the new time
+        pulse->owner = owner;
+        pulse->durationMS = durationMS;
+        // interval has to leave the valve closed for a bit or it isn't really a pulse
+        pulse->intervalMS = intervalMS > durationMS ? intervalMS : 0;
+        pulse->remaining = pulse->intervalMS > 0 ? repeatCount : 0;
+        getManifold()->get(i)->open(); // open before the timer is armed, so even a 1ms pulse can't close it first
+        pulse->open = true;
+        armPulse(pulse, durationMS);
+    }
+    xSemaphoreGive(valvePulseMutex);
+}
+
+void valvePulseCancel(uint16_t owner)
+{
+    xSemaphoreTake(valvePulseMutex, portMAX_DELAY);
+    for (int i = 0; i < SOLENOID_COUNT; i++)
+    {
+        if (pulses[i].owner == owner)
+        {
+            if (pulses[i].open)
+            {
+                log_i("Closing pulsed valve %i", i);
+            }
+            stopPulse(i);
+        }
+    }
+    xSemaphoreGive(valvePulseMutex);
+}
+
+bool valvePulseActive(int valve)
+{
+    return pulses[valve].owner != VALVE_PULSE_NO_OWNER;
+}
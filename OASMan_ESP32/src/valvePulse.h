@@ -0,0 +1,15 @@
+#ifndef valvePulse_h
+#define valvePulse_h
+
+#include <Arduino.h>
+#include <BTOas.h>
+
+// Timed valve pulses (VALVEPULSE packet). Each valve gets its own esp_timer so the open time is exact no matter what the bluetooth connection interval is doing.
+// Pulses remember which connection started them so they can all be closed if that client drops off mid pulse.
+
+void setupValvePulse();
+void valvePulseStart(uint16_t owner, ValvePulsePacket *packet); // replaces what owner was pulsing before
+void valvePulseCancel(uint16_t owner); // closes every valve this connection is pulsing
+bool valvePulseActive(int valve);
+
+#endif
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Rebuilds files exported from the manifold with a bulk transfer (see BulkPacket in ESP32_SHARED_LIBS/src/BTOas.h)
+#
+# The controller has nowhere to keep them so it prints them over usb serial as lines like:
+#   BULK BEGIN <resource> <size>
+#   BULK <resource> <offset> <hex data>
+#   BULK END <resource> <size>
+# Save the serial log (anything that isn't a BULK line gets skipped) and then:
+#   python3 bulk_capture.py serial.log
+# Each finished resource gets written out as its own file in the current directory.
+
+import sys
+
+# same order as BulkResource
+RESOURCE_FILES = [
+    "learn_up_front.bin",
+    "learn_up_rear.bin",
+    "learn_down_front.bin",
+    "learn_down_rear.bin",
+    "telemetry.bin",  # decode with telemetry_decode.py
+    "allowed_controllers.bin",
+    "settings.txt",
+    "gamepad_map.bin",
+]
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: bulk_capture.py <serial log>")
+        sys.exit(1)
+
+    transfers = {}  # resource: bytearray
+    with open(sys.argv[1], "r", errors="replace") as log:
+        for line in log:
+            parts = line.strip().split(" ")
+            if len(parts) < 3 or parts[0] != "BULK":
+                continue
+            if parts[1] == "BEGIN":
+                transfers[int(parts[2])] = bytearray(int(parts[3]))
+            elif parts[1] == "END":
+                resource = int(parts[2])
+                if resource not in transfers:
+                    continue
+                name = RESOURCE_FILES[resource] if resource < len(RESOURCE_FILES) else "resource_%d.bin" % resource
+                with open(name, "wb") as out:
+                    out.write(transfers.pop(resource))
+                print("wrote %s (%d bytes)" % (name, int(parts[3])))
+            elif parts[1] in ("FAIL", "CANCEL"):
+                print("resource %s stopped: %s" % (parts[2], line.strip()))
+                transfers.pop(int(parts[2]), None)
+            elif len(parts) == 4:
+                resource = int(parts[1])
+                if resource not in transfers:
+                    continue
+                offset = int(parts[2])
+                data = bytes.fromhex(parts[3])
+                transfers[resource][offset:offset + len(data)] = data
+
+    for resource in transfers:
+        print("resource %d never finished" % resource)
+
+
+if __name__ == "__main__":
+    main()
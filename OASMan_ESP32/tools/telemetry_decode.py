@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+# Decodes a dump of the manifold telemetry partition (see src/telemetry.h for the format)
+#
+# Get a dump either by exporting it over bluetooth (TELEMETRYPKT export) and saving the bytes in order, or straight off the chip:
+#   esptool.py read_flash 0x3F0000 0x10000 telemetry.bin
+# Then:
+#   python3 telemetry_decode.py telemetry.bin > telemetry.csv
+
+import struct
+import sys
+
+PAGE_SIZE = 1024
+PAGE_MAGIC = 0x5453414F
+PAGE_HEADER = struct.Struct("<IIQ")
+RECORD_HEADER = struct.Struct("<BI")
+
+VALVE_NAMES = ["FP_IN", "FP_OUT", "RP_IN", "RP_OUT", "FD_IN", "FD_OUT", "RD_IN", "RD_OUT"]
+WHEEL_NAMES = ["FP", "RP", "FD", "RD"]
+
+# type: (name, payload size)
+RECORD_TYPES = {
+    1: ("pressures", 10),
+    2: ("valves", 1),
+    3: ("compressor", 1),
+    4: ("routine_start", 4),
+    5: ("routine_stop", 2),
+    6: ("boot", 2),
+}
+
+
+def describe(record_type, payload):
+    if record_type == 1:
+        values = struct.unpack("<5H", payload)
+        return " ".join("%s=%.1f" % (name, v / 10.0) for name, v in zip(WHEEL_NAMES + ["TANK"], values))
+    if record_type == 2:
+        mask = payload[0]
+        opened = [VALVE_NAMES[i] for i in range(8) if mask & (1 << i)]
+        return "mask=0x%02X open=%s" % (mask, "|".join(opened) if opened else "none")
+    if record_type == 3:
+        return "on=%d frozen=%d" % (payload[0] & 1, (payload[0] >> 1) & 1)
+    if record_type == 4:
+        return "wheel=%s goal=%d start=%d quick=%d" % (WHEEL_NAMES[payload[0] & 3], payload[1], payload[2], payload[3])
+    if record_type == 5:
+        return "wheel=%s end=%d" % (WHEEL_NAMES[payload[0] & 3], payload[1])
+    if record_type == 6:
+        return "reset_reason=%d fast_boot=%d" % (payload[0], payload[1])
+    return payload.hex()
+
+
+def read_pages(data):
+    pages = []
+    for offset in range(0, len(data) - PAGE_SIZE + 1, PAGE_SIZE):
+        magic, sequence, time_us = PAGE_HEADER.unpack_from(data, offset)
+        if magic == PAGE_MAGIC:
+            pages.append((sequence, time_us, data[offset + PAGE_HEADER.size:offset + PAGE_SIZE]))
+    pages.sort(key=lambda p: p[0])
+    return pages
+
+
+def decode_page(sequence, page_time_us, body):
+    # records only keep the low 32 bits of the time, rebuild the rest from the page header
+    high = page_time_us & ~0xFFFFFFFF
+    prev_low = page_time_us & 0xFFFFFFFF
+    pos = 0
+    while pos + RECORD_HEADER.size <= len(body):
+        record_type, low = RECORD_HEADER.unpack_from(body, pos)
+        if record_type == 0xFF:
+            break  # rest of the page was never written
+        if record_type not in RECORD_TYPES:
+            print("# page %d: unknown record type %d at %d, skipping rest of page" % (sequence, record_type, pos), file=sys.stderr)
+            break
+        name, size = RECORD_TYPES[record_type]
+        payload = body[pos + RECORD_HEADER.size:pos + RECORD_HEADER.size + size]
+        pos += RECORD_HEADER.size + size
+        if low < prev_low and prev_low - low > 1 << 31:
+            high += 1 << 32  # wrapped. Small steps backwards are just records timestamped right before the page swap
+        prev_low = low
+        yield (high | low), name, describe(record_type, payload)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: %s telemetry.bin" % sys.argv[0], file=sys.stderr)
+        sys.exit(1)
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    print("page,time_s,type,values")
+    for sequence, time_us, body in read_pages(data):
+        for t, name, values in decode_page(sequence, time_us, body):
+            print("%d,%.6f,%s,%s" % (sequence, t / 1e6, name, values))
+
+
+if __name__ == "__main__":
+    main()
@@ -8,17 +8,22 @@
 // Please see this for a good reference at some setup auth and ect: https://github.com/h2zero/NimBLE-Arduino/blob/master/examples/NimBLE_Client/NimBLE_Client.ino
 
 #include "ble.h"
+#include <linkBenchmark.h>
 
 #define SERVICE_UUID "679425c8-d3b4-4491-9eb2-3e3d15b625f0"
 #define STATUS_CHARACTERISTIC_UUID "66fda100-8972-4ec7-971c-3fd30b3072ac"
 #define REST_CHARACTERISTIC_UUID "f573f13f-b38e-415e-b8f0-59a6a19a4e02"
 #define VALVECONTROL_CHARACTERISTIC_UUID "e225a15a-e816-4e9d-99b7-c384f91f273b"
+#define RAWSTREAM_CHARACTERISTIC_UUID "4d8b3e6a-52c1-4f0e-a7d9-1c6b2e8f9a34"
+#define BULK_CHARACTERISTIC_UUID "9c3e5b71-2d4a-4f86-b0e3-7a1f6c2d8e45"
 
 // Define UUIDs:
 BLEUUID serviceUUID(SERVICE_UUID);
 BLEUUID charUUID_Status(STATUS_CHARACTERISTIC_UUID);
 BLEUUID charUUID_Rest(REST_CHARACTERISTIC_UUID);
 BLEUUID charUUID_ValveControl(VALVECONTROL_CHARACTERISTIC_UUID);
+BLEUUID charUUID_RawStream(RAWSTREAM_CHARACTERISTIC_UUID);
+BLEUUID charUUID_Bulk(BULK_CHARACTERISTIC_UUID);
 
 static bool connected = false;
 static bool allowScan = true; // default to true so it initiates a scan on start
@@ -26,6 +31,63 @@ static unsigned long timeoutMS = 0;
 static bool hasReceivedStatus = false;
 NimBLEClient *pClient = nullptr;
 
+#pragma region link profile
+static BLELinkProfile linkProfile = BLE_LINK_FAST; // what we last asked for
+static unsigned long lastLinkActivity = 0;
+static char linkInfo[48] = "Not connected";
+
+// home screen calls this every frame, touches and held valves count too
+void ble_linkActivity()
+{
+    lastLinkActivity = millis();
+}
+
+static void applyLinkProfile(BLELinkProfile profile)
+{
+    const BLELinkParams *params = getBLELinkParams(profile);
+    linkProfile = profile;
+    if (pClient->updateConnParams(params->minInterval, params->maxInterval, params->latency, params->timeout))
+    {
+        log_i("Requested %s link profile", getBLELinkProfileName(profile));
+    }
+}
+
+// called from ble_loop while connected
+static void updateLinkProfile()
+{
+    if (getValveControlValue() != 0)
+    {
+        ble_linkActivity();
+    }
+    BLELinkProfile wanted = millis() - lastLinkActivity < BLE_LINK_IDLE_MS ? BLE_LINK_FAST : BLE_LINK_RELAXED;
+    if (wanted != linkProfile)
+    {
+        applyLinkProfile(wanted);
+    }
+
+    // report what actually got negotiated
+    static uint16_t prevInterval = 0;
+    static uint16_t prevLatency = 0;
+    NimBLEConnInfo info = pClient->getConnInfo();
+    if (info.getConnInterval() != prevInterval || info.getConnLatency() != prevLatency)
+    {
+        prevInterval = info.getConnInterval();
+        prevLatency = info.getConnLatency();
+        snprintf(linkInfo, sizeof(linkInfo), "%.2fms, latency %i", prevInterval * 1.25f, prevLatency);
+        log_i("Link: interval %.2fms, latency %i, timeout %ims", prevInterval * 1.25f, prevLatency, info.getConnTimeout() * 10);
+    }
+}
+
+const char *ble_getLinkInfo()
+{
+    if (pClient == nullptr || !pClient->isConnected())
+    {
+        return "Not connected";
+    }
+    return linkInfo;
+}
+#pragma endregion
+
 const char *ble_getMAC()
 {
     if (pClient == nullptr || !pClient->isConnected())
@@ -51,8 +113,34 @@ bool isConnectedToManifold()
 BLERemoteCharacteristic *pRemoteChar_Status;
 BLERemoteCharacteristic *pRemoteChar_Rest;
 BLERemoteCharacteristic *pRemoteChar_ValveControl;
+BLERemoteCharacteristic *pRemoteChar_RawStream = nullptr; // optional, older manifolds don't have it
+BLERemoteCharacteristic *pRemoteChar_Bulk = nullptr;      // optional too
+static bool rawStreamSubscribed = false;
+static void bulkConnectionLost();
+static void clearInFlightRequests();
 
 AuthResult authenticationResult = AUTHRESULT_WAITING;
+bool manifoldCompact = false; // manifold said it supports BTOAS_CAP_COMPACT in the auth reply
+bool manifoldValvePulse = false; // manifold said it supports BTOAS_CAP_VALVE_PULSE, held valves get sent as renewed pulses instead of the raw mask
+bool manifoldBatch = false; // manifold said it supports BTOAS_CAP_BATCH, rest packets that pile up get sent in one write
+bool manifoldBulk = false;  // manifold said it supports BTOAS_CAP_BULK, files can be pulled off it over the bulk characteristic
+bool manifoldStateSync = false; // manifold said it supports BTOAS_CAP_STATE_SYNC, everything for the ui comes back in one reply on connect
+bool manifoldRequestId = false; // manifold said it supports BTOAS_CAP_REQUEST_ID, replies get matched to what they answer
+bool manifoldJoystickConfig = false; // manifold said it supports BTOAS_CAP_JOYSTICK_CONFIG, gamepad stick settings show up in settings
+
+// what the last full state sync was, kept across reconnects so an unchanged manifold only has to send the status
+static uint32_t syncedBootId = 0;
+static uint32_t syncedStateVersion = 0;
+static unsigned long stateSyncSentTime = 0;
+
+#define VALVE_LEASE_MS 400       // how long the manifold keeps a held valve open if it doesn't hear from us again
+#define VALVE_LEASE_RENEW_MS 150 // how often we renew it while the button is still held
+
+// status deltas get applied on top of this
+BTOasPacket lastStatus;
+bool haveStatusKeyframe = false;
+bool statusKeyframeRequested = false;
+uint8_t lastStatusSequence = 0;
 
 std::stack<const NimBLEAdvertisedDevice *> oasmanClientsFound;
 std::vector<ble_addr_t> authblacklist;
@@ -81,6 +169,13 @@ void disconnect(bool showDialogOnDisconnect)
     // make sure it waits until it received it's first status before checking status timeouts
     hasReceivedStatus = false;
 
+    // characteristic gets deleted along with the client
+    pRemoteChar_RawStream = nullptr;
+    rawStreamSubscribed = false;
+    pRemoteChar_Bulk = nullptr;
+    bulkConnectionLost();
+    clearInFlightRequests(); // none of those are coming back now
+
     NimBLEDevice::getScan()->stop();
 
     if (pClient != nullptr)
@@ -104,6 +199,709 @@ void disconnect(bool showDialogOnDisconnect)
 
 ble_addr_t *authedBleAddr = nullptr;
 
+#pragma region raw stream
+// raw pressure stream is opt in, we only subscribe while the settings screen trace is turned on
+static bool rawStreamWanted = false;
+static RawTraceSample rawTrace[RAW_TRACE_BUFFER_COUNT];
+static uint16_t rawTraceHead = 0;
+static uint16_t rawTraceCount = 0;
+static int16_t rawTracePrev[4];
+static uint8_t rawTraceValves = 0;
+static portMUX_TYPE rawTraceMux = portMUX_INITIALIZER_UNLOCKED;
+
+void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify);
+
+void ble_setRawStream(bool enabled)
+{
+    rawStreamWanted = enabled;
+}
+
+bool ble_getRawStream()
+{
+    return rawStreamWanted;
+}
+
+bool ble_hasRawStream()
+{
+    return pRemoteChar_RawStream != nullptr;
+}
+
+static void pushRawTraceSample(const int16_t values[4])
+{
+    portENTER_CRITICAL(&rawTraceMux);
+    RawTraceSample *sample = &rawTrace[(rawTraceHead + rawTraceCount) % RAW_TRACE_BUFFER_COUNT];
+    memcpy(sample->values, values, sizeof(sample->values));
+    sample->valves = rawTraceValves;
+    if (rawTraceCount < RAW_TRACE_BUFFER_COUNT)
+    {
+        rawTraceCount++;
+    }
+    else
+    {
+        rawTraceHead = (rawTraceHead + 1) % RAW_TRACE_BUFFER_COUNT; // ui fell behind, drop the oldest
+    }
+    portEXIT_CRITICAL(&rawTraceMux);
+}
+
+int ble_readRawTrace(RawTraceSample *copyTo, int max)
+{
+    int count = 0;
+    portENTER_CRITICAL(&rawTraceMux);
+    while (count < max && rawTraceCount > 0)
+    {
+        copyTo[count++] = rawTrace[rawTraceHead];
+        rawTraceHead = (rawTraceHead + 1) % RAW_TRACE_BUFFER_COUNT;
+        rawTraceCount--;
+    }
+    portEXIT_CRITICAL(&rawTraceMux);
+    return count;
+}
+
+// see RawStreamRecordType in BTOas.h for the format. A batch cut short by the mtu is fine, we just stop at the last whole record
+static void decodeRawStreamBatch(const uint8_t *data, size_t length)
+{
+    size_t pos = RAWSTREAM_HEADER_SIZE;
+    bool havePrev = false; // every batch starts with a full sample
+    while (pos + RAWSTREAM_RECORD_HEADER_SIZE <= length)
+    {
+        uint8_t type = data[pos];
+        const uint8_t *payload = &data[pos + RAWSTREAM_RECORD_HEADER_SIZE];
+        size_t size = type == RAWSTREAM_VALVES ? RAWSTREAM_VALVES_PAYLOAD_SIZE : RAWSTREAM_SAMPLE_PAYLOAD_SIZE;
+        if ((type != RAWSTREAM_SAMPLE && type != RAWSTREAM_SAMPLE_DELTA && type != RAWSTREAM_VALVES) || pos + RAWSTREAM_RECORD_HEADER_SIZE + size > length)
+        {
+            return;
+        }
+        pos += RAWSTREAM_RECORD_HEADER_SIZE + size;
+
+        if (type == RAWSTREAM_VALVES)
+        {
+            rawTraceValves = payload[0];
+            continue;
+        }
+        if (type == RAWSTREAM_SAMPLE_DELTA && !havePrev)
+        {
+            return;
+        }
+        int16_t values[4];
+        rawStreamUnpack12(payload, values, type == RAWSTREAM_SAMPLE_DELTA);
+        if (type == RAWSTREAM_SAMPLE_DELTA)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                values[i] += rawTracePrev[i];
+            }
+        }
+        memcpy(rawTracePrev, values, sizeof(rawTracePrev));
+        havePrev = true;
+        pushRawTraceSample(values);
+    }
+}
+
+// called from ble_loop so subscribing happens on our task instead of the ui
+static void updateRawStreamSubscription()
+{
+    if (pRemoteChar_RawStream == nullptr || rawStreamWanted == rawStreamSubscribed)
+    {
+        return;
+    }
+    bool success = rawStreamWanted ? pRemoteChar_RawStream->subscribe(true, notifyCallback, true) : pRemoteChar_RawStream->unsubscribe(true);
+    if (success)
+    {
+        rawStreamSubscribed = rawStreamWanted;
+        log_i("Raw stream %s", rawStreamSubscribed ? "subscribed" : "unsubscribed");
+    }
+}
+#pragma endregion
+
+#pragma region bulk transfer
+// Pulls a file off the manifold over the bulk characteristic (see BulkPacket). There's no filesystem on the controller so the data gets
+// forwarded out over Serial as hex lines, OASMan_ESP32/tools/bulk_capture.py puts them back together into files.
+// If the connection drops partway through it picks back up from where it got to once we're connected again.
+#define BULK_WINDOW 16 // chunks the manifold can have in flight, the receive queue has to hold all of them
+#define BULK_ACK_EVERY (BULK_WINDOW / 2)
+
+struct BulkChunkReceived
+{
+    uint16_t length;
+    uint8_t data[BULK_MAX_NOTIFY_SIZE];
+};
+
+struct BulkReceive
+{
+    bool active;
+    bool openSent;
+    bool opened; // manifold said ok, size is good
+    BulkResource resource;
+    uint16_t transferId;
+    uint32_t size;
+    uint32_t offset; // next byte we want, everything before this already went out over serial
+    uint8_t chunksSinceAck;
+    bool resendSent; // already asked to go back, don't ask again for every chunk still in flight
+};
+
+static PacketQueue<BulkChunkReceived, BULK_WINDOW> bulkChunkQueue; // notify callback -> ble_loop
+static BulkReceive bulkRx;
+static uint16_t bulkNextTransferId = 1;
+static char bulkHexLine[BULK_MAX_CHUNK_SIZE * 2 + 1];
+
+bool ble_startBulkTransfer(BulkResource resource)
+{
+    if (bulkRx.active || !manifoldBulk || pRemoteChar_Bulk == nullptr)
+    {
+        return false;
+    }
+    memset(&bulkRx, 0, sizeof(BulkReceive));
+    bulkRx.resource = resource;
+    bulkRx.active = true; // ble_loop sends the open
+    return true;
+}
+
+void ble_cancelBulkTransfer()
+{
+    if (!bulkRx.active)
+    {
+        return;
+    }
+    bulkRx.active = false;
+    if (bulkRx.openSent)
+    {
+        BulkPacket pkt(BULKCMD_CANCEL, bulkRx.transferId, 0);
+        sendRestPacket(&pkt);
+    }
+    Serial.printf("BULK CANCEL %i\n", bulkRx.resource);
+}
+
+// a transfer that was going gets opened again from where it got to once we're back
+static void bulkConnectionLost()
+{
+    bulkRx.openSent = false;
+}
+
+bool ble_getBulkProgress(uint32_t *received, uint32_t *size)
+{
+    *received = bulkRx.offset;
+    *size = bulkRx.size;
+    return bulkRx.active;
+}
+
+// notify callback, just hand it off. Anything bigger than we can hold can't be one of ours
+static void receiveBulkChunk(const uint8_t *data, size_t length)
+{
+    if (!bulkRx.active || length <= sizeof(BulkChunkHeader) || length > BULK_MAX_NOTIFY_SIZE)
+    {
+        return;
+    }
+    BulkChunkReceived chunk;
+    chunk.length = length;
+    memcpy(chunk.data, data, length);
+    bulkChunkQueue.push(chunk); // if it's full the gap gets caught and resent
+}
+
+// notify callback, reply to our open
+static void receiveBulkReply(BulkPacket *reply)
+{
+    if (reply->getCommand() != BULKCMD_OPEN || !bulkRx.active || reply->getTransferId() != bulkRx.transferId)
+    {
+        return;
+    }
+    if (reply->getStatus() == BULK_STATUS_OK)
+    {
+        bulkRx.size = reply->getSize();
+        bulkRx.opened = true;
+        if (bulkRx.offset == 0)
+        {
+            Serial.printf("BULK BEGIN %i %u\n", bulkRx.resource, bulkRx.size);
+        }
+        else
+        {
+            log_i("Bulk transfer resumed at %u of %u", bulkRx.offset, bulkRx.size);
+        }
+    }
+    else if (reply->getStatus() == BULK_STATUS_BAD_OFFSET)
+    {
+        // file changed while we were disconnected, start it over
+        bulkRx.offset = 0;
+        bulkRx.openSent = false;
+    }
+    else
+    {
+        Serial.printf("BULK FAIL %i %i\n", bulkRx.resource, reply->getStatus());
+        bulkRx.active = false;
+    }
+}
+
+static void forwardBulkData(uint32_t offset, const uint8_t *data, uint16_t length)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    for (int i = 0; i < length; i++)
+    {
+        bulkHexLine[i * 2] = hexDigits[data[i] >> 4];
+        bulkHexLine[i * 2 + 1] = hexDigits[data[i] & 0x0F];
+    }
+    bulkHexLine[length * 2] = 0;
+    Serial.printf("BULK %i %u %s\n", bulkRx.resource, offset, bulkHexLine);
+}
+
+static void sendBulkCommand(BulkCMD cmd)
+{
+    BulkPacket pkt(cmd, bulkRx.transferId, bulkRx.offset);
+    sendRestPacket(&pkt);
+}
+
+// called from ble_loop
+static void updateBulkTransfer()
+{
+    if (!bulkRx.active || authenticationResult != AuthResult::AUTHRESULT_SUCCESS)
+    {
+        return;
+    }
+    if (!bulkRx.openSent)
+    {
+        // new id every time so chunks still in flight from before a reconnect or restart get ignored
+        bulkRx.transferId = bulkNextTransferId++;
+        bulkRx.opened = false;
+        bulkRx.resendSent = false;
+        bulkRx.chunksSinceAck = 0;
+        bulkChunkQueue.clear();
+        BulkPacket open(BULKCMD_OPEN, bulkRx.transferId, bulkRx.offset);
+        open.setResource(bulkRx.resource);
+        open.setWindow(BULK_WINDOW);
+        sendRestPacket(&open);
+        bulkRx.openSent = true;
+        return;
+    }
+    if (!bulkRx.opened)
+    {
+        return;
+    }
+
+    BulkChunkReceived chunk;
+    while (bulkChunkQueue.pop(&chunk))
+    {
+        BulkChunkHeader header;
+        memcpy(&header, chunk.data, sizeof(BulkChunkHeader));
+        if (header.transferId != bulkRx.transferId || header.offset < bulkRx.offset)
+        {
+            continue; // old transfer, or a repeat after the manifold went back
+        }
+        const uint8_t *data = chunk.data + sizeof(BulkChunkHeader);
+        uint16_t length = chunk.length - sizeof(BulkChunkHeader);
+        if (header.offset != bulkRx.offset || bulkCrc32(data, length) != header.crc)
+        {
+            // missed one or it got mangled, everything after it is useless until the manifold goes back
+            if (!bulkRx.resendSent)
+            {
+                log_i("Bulk chunk at %u bad, resending from %u", header.offset, bulkRx.offset);
+                sendBulkCommand(BULKCMD_RESEND);
+                bulkRx.resendSent = true;
+                bulkRx.chunksSinceAck = 0;
+            }
+            continue;
+        }
+        forwardBulkData(header.offset, data, length);
+        bulkRx.offset += length;
+        bulkRx.chunksSinceAck++;
+        bulkRx.resendSent = false;
+    }
+
+    bool done = bulkRx.offset >= bulkRx.size;
+    if (bulkRx.chunksSinceAck >= BULK_ACK_EVERY || done)
+    {
+        // the last ack is what lets the manifold close its end
+        sendBulkCommand(BULKCMD_ACK);
+        bulkRx.chunksSinceAck = 0;
+    }
+    if (done)
+    {
+        Serial.printf("BULK END %i %u\n", bulkRx.resource, bulkRx.size);
+        bulkRx.active = false;
+    }
+}
+#pragma endregion
+
+#pragma region request tracking
+// Packets that get a reply are given a request id and kept here until the reply with that id comes back or they time out, so every
+// command gets its own error. Only REQUEST_INFLIGHT_MAX can be waiting at once and anything else that wants a reply stays queued until
+// one finishes, which also keeps the manifold's reply queue from overflowing. Old manifolds don't echo the id so none of this runs for them
+#define REQUEST_INFLIGHT_MAX 8
+#define REQUEST_TIMEOUT_MS 2000
+
+struct InFlightRequest
+{
+    uint16_t requestId; // 0 when the slot is free
+    uint16_t cmd;
+    unsigned long sentTime;
+};
+
+static InFlightRequest inFlight[REQUEST_INFLIGHT_MAX];
+static uint16_t nextRequestId = 1;
+static portMUX_TYPE inFlightMux = portMUX_INITIALIZER_UNLOCKED; // replies come in on the nimble task
+
+static int freeRequestSlots()
+{
+    int freeSlots = 0;
+    portENTER_CRITICAL(&inFlightMux);
+    for (int i = 0; i < REQUEST_INFLIGHT_MAX; i++)
+    {
+        if (inFlight[i].requestId == 0)
+        {
+            freeSlots++;
+        }
+    }
+    portEXIT_CRITICAL(&inFlightMux);
+    return freeSlots;
+}
+
+// how many in flight slots sending this takes up
+static int requestSlotsFor(BTOasPacket *packet)
+{
+    return manifoldRequestId && packet->expectsReply() ? 1 : 0;
+}
+
+static void trackRequest(uint16_t requestId, uint16_t cmd)
+{
+    portENTER_CRITICAL(&inFlightMux);
+    for (int i = 0; i < REQUEST_INFLIGHT_MAX; i++)
+    {
+        if (inFlight[i].requestId == 0)
+        {
+            inFlight[i].requestId = requestId;
+            inFlight[i].cmd = cmd;
+            inFlight[i].sentTime = millis();
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&inFlightMux);
+}
+
+// false if it wasn't waiting, like a reply that shows up after it already timed out
+static bool completeRequest(uint16_t requestId, InFlightRequest *copyTo)
+{
+    bool found = false;
+    portENTER_CRITICAL(&inFlightMux);
+    for (int i = 0; i < REQUEST_INFLIGHT_MAX; i++)
+    {
+        if (inFlight[i].requestId == requestId)
+        {
+            *copyTo = inFlight[i];
+            inFlight[i].requestId = 0;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&inFlightMux);
+    return found;
+}
+
+static void clearInFlightRequests()
+{
+    portENTER_CRITICAL(&inFlightMux);
+    memset(inFlight, 0, sizeof(inFlight));
+    portEXIT_CRITICAL(&inFlightMux);
+}
+
+// gives the packet its id right before it goes out. A batch takes a block, its own id and then one for each packet in it
+static void assignRequestId(BTOasPacket *packet)
+{
+    if (requestSlotsFor(packet) == 0)
+    {
+        return;
+    }
+    int count = packet->cmd == BATCH ? 1 + ((BatchPacket *)packet)->getCount() : 1;
+    if ((uint32_t)nextRequestId + count > 0xFFFF)
+    {
+        nextRequestId = 1; // never wrap through 0 in the middle of a block
+    }
+    packet->requestId = nextRequestId;
+    nextRequestId += count;
+    trackRequest(packet->requestId, packet->cmd);
+
+    if (packet->cmd == BATCH)
+    {
+        BatchPacket *batch = (BatchPacket *)packet;
+        int offset = BATCH_FIRST_OFFSET;
+        for (int i = 0; i < batch->getCount() && offset >= 0; i++)
+        {
+            BTOasPacket sub;
+            uint16_t length;
+            offset = batch->readPacket(offset, &sub, &length);
+            if (offset >= 0 && sub.expectsReply())
+            {
+                trackRequest(packet->requestId + 1 + i, sub.cmd);
+            }
+        }
+    }
+}
+
+// notify callback, a reply came in
+static void receiveReply(BTOasPacket *reply)
+{
+    InFlightRequest request;
+    if (reply->requestId == 0 || !completeRequest(reply->requestId, &request))
+    {
+        return;
+    }
+    log_i("Request %u (cmd %i) answered in %lums", request.requestId, request.cmd, millis() - request.sentTime);
+
+    if (reply->cmd == BATCH)
+    {
+        // anything in the batch that didn't run is never going to answer
+        BatchPacket *batch = (BatchPacket *)reply;
+        for (int i = 0; i < batch->getCount() && i < BATCH_MAX_PACKETS; i++)
+        {
+            if (batch->getStatus(i) != BATCH_STATUS_OK && completeRequest(reply->requestId + 1 + i, &request))
+            {
+                log_i("Request %u (cmd %i) not run, batch status %i", request.requestId, request.cmd, batch->getStatus(i));
+            }
+        }
+    }
+}
+
+// called from ble_loop
+static void checkRequestTimeouts()
+{
+    unsigned long now = millis();
+    for (int i = 0; i < REQUEST_INFLIGHT_MAX; i++)
+    {
+        InFlightRequest request;
+        portENTER_CRITICAL(&inFlightMux);
+        bool timedOut = inFlight[i].requestId != 0 && now - inFlight[i].sentTime >= REQUEST_TIMEOUT_MS;
+        request = inFlight[i];
+        if (timedOut)
+        {
+            inFlight[i].requestId = 0;
+        }
+        portEXIT_CRITICAL(&inFlightMux);
+
+        if (timedOut)
+        {
+            log_i("Request %u (cmd %i) timed out", request.requestId, request.cmd);
+            char buf[40];
+            snprintf(buf, sizeof(buf), "No reply to command %i!", request.cmd);
+            showDialog(buf, lv_color_hex(0xFF0000), 3000);
+        }
+    }
+}
+#pragma endregion
+
+#pragma region link benchmark
+// Round trips and then throughput to the manifold, from the settings screen or usb serial (see readLinkBenchCommand).
+// Pings are written straight from ble_loop instead of going through the rest queue so time sitting in the queue doesn't count
+#define BENCH_PING_INTERVAL_MS 50
+#define BENCH_ECHO_WAIT_MS 1000 // after the last ping, before moving on
+#define BENCH_DONE_WAIT_MS 3000 // past the end of the throughput test before giving up on the done packet
+
+enum LinkBenchState
+{
+    BENCH_IDLE,
+    BENCH_PINGING,
+    BENCH_THROUGHPUT,
+};
+
+static LinkBenchmark linkBench;
+static volatile LinkBenchState benchState = BENCH_IDLE;
+static bool benchHaveResults = false;
+static uint16_t benchPingsLeft = 0;
+static uint16_t benchPingSequence = 0;
+static uint32_t benchThroughputMS = 0;
+static unsigned long benchNextTime = 0; // next ping, or when to stop waiting
+static volatile bool benchThroughputDone = false;
+static uint32_t benchManifoldSent = 0; // filler packets the manifold says went out
+static uint32_t benchManifoldBytes = 0;
+
+void ble_startLinkBenchmark(uint16_t pings, uint16_t throughputSeconds)
+{
+    linkBench.reset();
+    benchPingsLeft = pings;
+    benchThroughputMS = throughputSeconds * 1000;
+    benchThroughputDone = false;
+    benchManifoldSent = 0;
+    benchManifoldBytes = 0;
+    benchNextTime = millis();
+    benchState = BENCH_PINGING;
+}
+
+bool ble_getLinkBenchmark(char *rtt, size_t rttLen, char *throughput, size_t throughputLen)
+{
+    if (benchState != BENCH_IDLE)
+    {
+        snprintf(rtt, rttLen, "Running...");
+        snprintf(throughput, throughputLen, "Running...");
+        return true;
+    }
+    if (!benchHaveResults)
+    {
+        return false;
+    }
+    linkBench.formatRtt(rtt, rttLen);
+    linkBench.formatThroughput(throughput, throughputLen);
+    return true;
+}
+
+static void benchPrint()
+{
+    char buf[64];
+    linkBench.formatRtt(buf, sizeof(buf));
+    Serial.printf("BENCH RTT %s\n", buf);
+    linkBench.formatThroughput(buf, sizeof(buf));
+    Serial.printf("BENCH THROUGHPUT %s (got %u of %u packets, %u bytes)\n", buf, linkBench.fillerCount, benchManifoldSent, linkBench.fillerBytes);
+}
+
+static void benchWrite(PingPacket *ping)
+{
+    if (!pRemoteChar_Rest->writeValue(ping->tx(), ping->txLength(manifoldCompact), true))
+    {
+        log_i("Link benchmark write failed");
+    }
+}
+
+// notify callback
+static void receiveBenchPacket(PingPacket *ping, size_t length)
+{
+    switch (ping->getCommand())
+    {
+    case PINGCMD_PING:
+    {
+        // the manifold is running one, send it back. This one does go through the queue, we can't write from in here
+        PingPacket echo = *ping;
+        echo.setCommand(PINGCMD_ECHO);
+        echo.setEchoTime(micros());
+        sendRestPacket(&echo);
+        break;
+    }
+    case PINGCMD_ECHO:
+        linkBench.addRtt(micros() - ping->getSenderTime());
+        break;
+    case PINGCMD_FILLER:
+        linkBench.addFiller(ping->getSequence(), length, micros());
+        break;
+    case PINGCMD_THROUGHPUT_DONE:
+        benchManifoldSent = ping->getValue();
+        benchManifoldBytes = ping->getBytes();
+        benchThroughputDone = true;
+        break;
+    default:
+        break;
+    }
+}
+
+static void finishLinkBenchmark()
+{
+    // anything still missing at the end never showed up either
+    if (benchManifoldSent > linkBench.fillerCount + linkBench.fillerLost)
+    {
+        linkBench.fillerLost = benchManifoldSent - linkBench.fillerCount;
+    }
+    benchState = BENCH_IDLE;
+    benchHaveResults = true;
+    benchPrint();
+}
+
+// called from ble_loop
+static void updateLinkBenchmark()
+{
+    uint32_t arg = 0;
+    switch (readLinkBenchCommand(&arg))
+    {
+    case LINK_BENCH_PING:
+        ble_startLinkBenchmark(arg, 0);
+        break;
+    case LINK_BENCH_THROUGHPUT:
+        ble_startLinkBenchmark(0, arg);
+        break;
+    case LINK_BENCH_PRINT:
+        benchPrint();
+        break;
+    default:
+        break;
+    }
+
+    unsigned long now = millis();
+    if (benchState == BENCH_PINGING && (long)(now - benchNextTime) >= 0)
+    {
+        if (benchPingsLeft > 0)
+        {
+            PingPacket ping(PINGCMD_PING, benchPingSequence++);
+            ping.setSenderTime(micros());
+            benchWrite(&ping);
+            linkBench.pingsSent++;
+            benchPingsLeft--;
+            benchNextTime = now + (benchPingsLeft > 0 ? BENCH_PING_INTERVAL_MS : BENCH_ECHO_WAIT_MS);
+        }
+        else if (benchThroughputMS > 0)
+        {
+            PingPacket start(PINGCMD_THROUGHPUT, 0, benchThroughputMS);
+            benchWrite(&start);
+            benchNextTime = now + benchThroughputMS + BENCH_DONE_WAIT_MS;
+            benchState = BENCH_THROUGHPUT;
+        }
+        else
+        {
+            finishLinkBenchmark();
+        }
+    }
+    else if (benchState == BENCH_THROUGHPUT && (benchThroughputDone || (long)(now - benchNextTime) >= 0))
+    {
+        finishLinkBenchmark();
+    }
+}
+#pragma endregion
+
+// copies the last status into the globals the screens read
+static void applyLastStatus()
+{
+    StatusPacket *status = (StatusPacket *)&lastStatus;
+    // Serial.print("WHEEL_FRONT_PASSENGER: ");
+    // Serial.println(status->args16()[WHEEL_FRONT_PASSENGER].i);
+    // Serial.print("WHEEL_REAR_PASSENGER: ");
+    // Serial.println(status->args16()[WHEEL_REAR_PASSENGER].i);
+    // Serial.print("WHEEL_FRONT_DRIVER: ");
+    // Serial.println(status->args16()[WHEEL_FRONT_DRIVER].i);
+    // Serial.print("WHEEL_REAR_DRIVER: ");
+    // Serial.println(status->args16()[WHEEL_REAR_DRIVER].i);
+    // Serial.print("TANK: ");
+    // Serial.println(status->args16()[_TANK_INDEX].i);
+
+    currentPressures[WHEEL_FRONT_PASSENGER] = status->args16()[WHEEL_FRONT_PASSENGER].i;
+    currentPressures[WHEEL_REAR_PASSENGER] = status->args16()[WHEEL_REAR_PASSENGER].i;
+    currentPressures[WHEEL_FRONT_DRIVER] = status->args16()[WHEEL_FRONT_DRIVER].i;
+    currentPressures[WHEEL_REAR_DRIVER] = status->args16()[WHEEL_REAR_DRIVER].i;
+    currentPressures[_TANK_INDEX] = status->args16()[_TANK_INDEX].i;
+    statusBittset = status->args32()[3].i;
+    AIPercentage = status->args8()[10].i;
+    AIReadyBittset = status->args8()[11].i;
+}
+
+// state sync reply. A full one fills in everything the screens show, otherwise what we have from last time is still good
+static void receiveStateSync(StateSyncPacket *sync)
+{
+    if (!haveStatusKeyframe)
+    {
+        // only until the first real status shows up, after that deltas are going on top of lastStatus
+        memcpy(lastStatus.args, sync->status(), STATESYNC_STATUS_SIZE);
+        applyLastStatus();
+    }
+    if (sync->isFull())
+    {
+        memcpy(util_configValues.args, sync->config(), STATESYNC_CONFIG_SIZE);
+        *util_configValues._setValues() = true;
+        for (int i = 0; i < MAX_PROFILE_COUNT; i++)
+        {
+            for (int w = 0; w < 4; w++)
+            {
+                profilePressures[i][w] = sync->getPresetPressure(i, w);
+            }
+        }
+        profileUpdated = true;
+        memset(util_statusRequestPacket.args, 0, sizeof(BTOasPacket::args));
+        util_statusRequestPacket.setStatus(sync->getFirmwareVersion());
+        util_statusRequestPacket._setStatus = true;
+        syncedBootId = sync->getBootId();
+        syncedStateVersion = sync->getStateVersion();
+    }
+    log_i("State sync %s in %lums, version %u", sync->isFull() ? "full" : "unchanged", millis() - stateSyncSentTime, sync->getStateVersion());
+}
+
 // Callback function for Notify function
 void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic,
                     uint8_t *pData,
@@ -119,44 +917,69 @@ void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic,
             timeoutMS = millis() + 5000;
             hasReceivedStatus = true;
 
-            // convert received bytes to integer
-            StatusPacket *status = (StatusPacket *)pData;
-            // Serial.print("WHEEL_FRONT_PASSENGER: ");
-            // Serial.println(status->args16()[WHEEL_FRONT_PASSENGER].i);
-            // Serial.print("WHEEL_REAR_PASSENGER: ");
-            // Serial.println(status->args16()[WHEEL_REAR_PASSENGER].i);
-            // Serial.print("WHEEL_FRONT_DRIVER: ");
-            // Serial.println(status->args16()[WHEEL_FRONT_DRIVER].i);
-            // Serial.print("WHEEL_REAR_DRIVER: ");
-            // Serial.println(status->args16()[WHEEL_REAR_DRIVER].i);
-            // Serial.print("TANK: ");
-            // Serial.println(status->args16()[_TANK_INDEX].i);
-
-            currentPressures[WHEEL_FRONT_PASSENGER] = status->args16()[WHEEL_FRONT_PASSENGER].i;
-            currentPressures[WHEEL_REAR_PASSENGER] = status->args16()[WHEEL_REAR_PASSENGER].i;
-            currentPressures[WHEEL_FRONT_DRIVER] = status->args16()[WHEEL_FRONT_DRIVER].i;
-            currentPressures[WHEEL_REAR_DRIVER] = status->args16()[WHEEL_REAR_DRIVER].i;
-            currentPressures[_TANK_INDEX] = status->args16()[_TANK_INDEX].i;
-            statusBittset = status->args32()[3].i;
-            AIPercentage = status->args8()[10].i;
-            AIReadyBittset = status->args8()[11].i;
+            // convert received bytes to integer. Compact packets are shorter so copy them into a full size packet first
+            BTOasPacket received;
+            received.rx(pData, length);
+            if (received.cmd == STATUSDELTA)
+            {
+                StatusDeltaPacket *delta = (StatusDeltaPacket *)&received;
+                if (!delta->isKeyframe() && (!haveStatusKeyframe || delta->getSequence() != (uint8_t)(lastStatusSequence + 1)))
+                {
+                    // missed one, so deltas are useless until the next keyframe
+                    haveStatusKeyframe = false;
+                    if (!statusKeyframeRequested)
+                    {
+                        statusKeyframeRequested = true;
+                        StatusDeltaPacket keyframeRequest;
+                        sendRestPacket(&keyframeRequest);
+                    }
+                    return;
+                }
+                delta->apply(((StatusPacket *)&lastStatus)->fields());
+                haveStatusKeyframe = true;
+                statusKeyframeRequested = false;
+                lastStatusSequence = delta->getSequence();
+            }
+            else
+            {
+                memcpy(lastStatus.args, received.args, sizeof(BTOasPacket::args));
+            }
+            applyLastStatus();
+        }
+        else if (pRemoteChar_RawStream != nullptr && pBLERemoteCharacteristic->getUUID().toString() == charUUID_RawStream.toString())
+        {
+            decodeRawStreamBatch(pData, length);
+        }
+        else if (pRemoteChar_Bulk != nullptr && pBLERemoteCharacteristic->getUUID().toString() == charUUID_Bulk.toString())
+        {
+            receiveBulkChunk(pData, length);
         }
     }
     if (pBLERemoteCharacteristic->getUUID().toString() == charUUID_Rest.toString())
     {
         timeoutMS = millis() + 5000;
-        BTOasPacket *pkt = (BTOasPacket *)pData;
-        log_i("Rest packet received: %i", pkt->cmd);
+        BTOasPacket received;
+        received.rx(pData, length);
+        BTOasPacket *pkt = &received;
+        log_i("Rest packet received: %i (%i bytes)", pkt->cmd, length);
         if (pkt->cmd == AUTHPACKET)
         {
             log_i("Auth packet received");
             authenticationResult = ((AuthPacket *)pkt)->getBleAuthResult();
+            manifoldCompact = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_COMPACT) != 0; // old manifolds leave this 0
+            manifoldValvePulse = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_VALVE_PULSE) != 0;
+            manifoldBatch = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_BATCH) != 0;
+            manifoldBulk = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_BULK) != 0;
+            manifoldStateSync = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_STATE_SYNC) != 0;
+            manifoldRequestId = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_REQUEST_ID) != 0;
+            manifoldJoystickConfig = (((AuthPacket *)pkt)->getManifoldCapabilities() & BTOAS_CAP_JOYSTICK_CONFIG) != 0;
             log_i("Auth result: %i", authenticationResult);
             authedBleAddr = (ble_addr_t *)pBLERemoteCharacteristic->getClient()->getPeerAddress().getBase();
             log_i("Authed address: %X:%X:%X:%X:%X:%X", authedBleAddr->val[5], authedBleAddr->val[4], authedBleAddr->val[3], authedBleAddr->val[2], authedBleAddr->val[1], authedBleAddr->val[0]);
         }
         if (authenticationResult == AuthResult::AUTHRESULT_SUCCESS)
         {
+            receiveReply(pkt);
             switch (pkt->cmd)
             {
             case PRESETREPORT:
@@ -179,6 +1002,48 @@ void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic,
                 memcpy(util_statusRequestPacket.args, pkt->args, sizeof(BTOasPacket::args));
                 util_statusRequestPacket._setStatus = true;
                 break;
+            case BOOTTIMINGS:
+            {
+                BootTimingsPacket *timings = (BootTimingsPacket *)pkt;
+                Serial.printf("Manifold boot timings%s:\n", timings->getFastBoot() ? " (fast boot)" : "");
+                for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+                {
+                    Serial.printf("  phase %i: %ums\n", i, timings->getPhaseTime((BootPhase)i));
+                }
+                break;
+            }
+            case BATCH:
+            {
+                BatchPacket *reply = (BatchPacket *)pkt;
+                for (int i = 0; i < reply->getCount() && i < BATCH_MAX_PACKETS; i++)
+                {
+                    if (reply->getStatus(i) != BATCH_STATUS_OK)
+                    {
+                        log_i("Batched packet %i not run, status %i", i, reply->getStatus(i));
+                    }
+                }
+                break;
+            }
+            case BULKPKT:
+                receiveBulkReply((BulkPacket *)pkt);
+                break;
+            case STATESYNC:
+                receiveStateSync((StateSyncPacket *)pkt);
+                break;
+            case PINGPKT:
+                receiveBenchPacket((PingPacket *)pkt, length);
+                break;
+            case JOYSTICKCONFIG:
+                memcpy(util_joystickConfig.args, pkt->args, sizeof(BTOasPacket::args));
+                util_joystickConfigReceived = true;
+                break;
+            case PACKETTOOLARGE:
+            {
+                // the mtu never got raised, receiveReply already stopped waiting on it
+                TooLargePacket *tooLarge = (TooLargePacket *)pkt;
+                log_i("Reply %i needed %i bytes but the mtu is only %i", tooLarge->getPacketCmd(), tooLarge->getLength(), tooLarge->getMTU());
+                break;
+            }
             }
         }
     }
@@ -199,6 +1064,17 @@ class MyClientCallback : public NimBLEClientCallbacks
         // pclient->secureConnection(); // okay but this line did cause it to not hang forever on the connect so that's interesting
     }
 
+    // the manifold asks for relaxed parameters when it's idle, but if we still want fast we say no
+    bool onConnParamsUpdateRequest(NimBLEClient *pclient, const ble_gap_upd_params *params) override
+    {
+        if (linkProfile == BLE_LINK_FAST && params->itvl_min > getBLELinkParams(BLE_LINK_FAST)->maxInterval)
+        {
+            log_i("Turned down link update to %.2fms, still active", params->itvl_min * 1.25f);
+            return false;
+        }
+        return true;
+    }
+
     void onDisconnect(BLEClient *pclient, int reason) override
     {
         log_i("onDisconnect", pclient->toString().c_str());
@@ -237,6 +1113,14 @@ bool connectToServer(const BLEAdvertisedDevice *myDevice)
 {
     clearPackets(); // not sure this is actually needed, but leaving in here to just give a clean slate?
     authenticationResult = AuthResult::AUTHRESULT_WAITING;
+    manifoldCompact = false;
+    manifoldValvePulse = false;
+    manifoldBatch = false;
+    manifoldBulk = false;
+    manifoldStateSync = false;
+    manifoldRequestId = false;
+    haveStatusKeyframe = false;
+    statusKeyframeRequested = false;
     log_i("Status: %s", charUUID_Status.toString().c_str());
     log_i("Forming a connection to %s", myDevice->getAddress().toString().c_str());
     deletePClientIfExist();
@@ -257,6 +1141,12 @@ bool connectToServer(const BLEAdvertisedDevice *myDevice)
 
     pClient->setClientCallbacks(&clientCallbacks, false);
 
+    // start out fast, ble_loop drops it to relaxed once things go quiet
+    const BLELinkParams *fast = getBLELinkParams(BLE_LINK_FAST);
+    pClient->setConnectionParams(fast->minInterval, fast->maxInterval, fast->latency, fast->timeout);
+    linkProfile = BLE_LINK_FAST;
+    ble_linkActivity();
+
     log_i("Set callbacks");
 
     // Connect to the remove BLE Server.
@@ -310,6 +1200,11 @@ bool connectToServer(const BLEAdvertisedDevice *myDevice)
     pRemoteChar_Rest = pRemoteService->getCharacteristic(charUUID_Rest);
     log_i("Checking char: valve");
     pRemoteChar_ValveControl = pRemoteService->getCharacteristic(charUUID_ValveControl);
+    log_i("Checking char: raw stream");
+    pRemoteChar_RawStream = pRemoteService->getCharacteristic(charUUID_RawStream); // not passed to connectCharacteristic, we don't want it subscribed yet
+    rawStreamSubscribed = false;
+    log_i("Checking char: bulk");
+    pRemoteChar_Bulk = pRemoteService->getCharacteristic(charUUID_Bulk);
 
     delay(50);
 
@@ -329,6 +1224,13 @@ bool connectToServer(const BLEAdvertisedDevice *myDevice)
     if (connectCharacteristic(pRemoteService, pRemoteChar_ValveControl) == false)
         _connected = false;
 
+    if (pRemoteChar_Bulk != nullptr)
+    {
+        delay(50);
+        log_i("connecting char: bulk");
+        connectCharacteristic(pRemoteService, pRemoteChar_Bulk); // nothing comes over it until we open a transfer, fine to leave subscribed
+    }
+
     if (_connected == false)
     {
         // pClient->disconnect();
@@ -341,7 +1243,8 @@ bool connectToServer(const BLEAdvertisedDevice *myDevice)
     log_i("Checking auth...");
 
     AuthPacket authPacket(getblePasskey(), AuthResult::AUTHRESULT_WAITING);
-    pRemoteChar_Rest->writeValue(authPacket.tx(), BTOAS_PACKET_SIZE, true); // all of the writeValue last arg got changed to true when I switched the server to BTStack. Idk why it's required now but it is
+    authPacket.setCapabilities(BTOAS_CAP_COMPACT | BTOAS_CAP_STATUS_DELTA | BTOAS_CAP_VALVE_PULSE | BTOAS_CAP_BATCH | BTOAS_CAP_BULK | BTOAS_CAP_STATE_SYNC | BTOAS_CAP_REQUEST_ID | BTOAS_CAP_JOYSTICK_CONFIG);
+    pRemoteChar_Rest->writeValue(authPacket.tx(), BTOAS_PACKET_SIZE, true); // always full size, we don't know what the manifold supports yet // all of the writeValue last arg got changed to true when I switched the server to BTStack. Idk why it's required now but it is
 
     // Serial.println("Auth bypass...");
     // authenticationResult = AuthResult::AUTHRESULT_SUCCESS;
@@ -499,6 +1402,12 @@ void ble_setup()
     showDialog("Searching for manifold...", lv_color_hex(0xFFFF00), 30000);
 }
 
+// auth has to be on its own so the manifold can check it, and batches don't go in batches
+static bool isBatchable(BTOasPacket *packet)
+{
+    return packet->cmd != AUTHPACKET && packet->cmd != BATCH;
+}
+
 void ble_loop()
 {
 
@@ -517,23 +1426,67 @@ void ble_loop()
     {
 
         BTOasPacket packet;
-        bool hasPacketToSend = getBTRestPacketToSend(&packet);
+        int requestSlots = manifoldRequestId ? freeRequestSlots() : 0;
+        // anything waiting on a reply stays queued until there's room for it in flight
+        bool hasPacketToSend = peekBTRestPacketToSend(&packet) && requestSlotsFor(&packet) <= requestSlots;
         bool success = true;
         if (hasPacketToSend)
         {
+            getBTRestPacketToSend(&packet);
+            // anything else already waiting goes out in the same write, so a settings change or the connect requests are one round trip
+            BatchPacket batch;
+            if (manifoldBatch && isBatchable(&packet) && batch.add(&packet))
+            {
+                int batchSlots = requestSlots - requestSlotsFor(&packet) - requestSlotsFor(&batch); // the batch gets a reply of its own
+                BTOasPacket next;
+                while (batchSlots >= 0 && peekBTRestPacketToSend(&next) && isBatchable(&next) && requestSlotsFor(&next) <= batchSlots && batch.add(&next))
+                {
+                    getBTRestPacketToSend(&next); // it's in the batch now
+                    batchSlots -= requestSlotsFor(&next);
+                }
+                if (batch.getCount() > 1)
+                {
+                    log_i("Batched %i rest packets", batch.getCount());
+                    packet = batch;
+                }
+            }
+            assignRequestId(&packet);
             packet.dump();
-            success = pRemoteChar_Rest->writeValue(packet.tx(), BTOAS_PACKET_SIZE, true);
+            success = pRemoteChar_Rest->writeValue(packet.tx(), packet.txLength(manifoldCompact), true);
             log_i("Sent rest packet!");
         }
 
         unsigned int valveControlValue = getValveControlValue();
-        if (previousValveInt != valveControlValue)
+        if (manifoldValvePulse)
+        {
+            // the manifold closes these on its own if the renewals stop coming, so a dropped link or a lost release can't leave air flowing
+            static unsigned long lastLeaseTime = 0;
+            if (previousValveInt != valveControlValue || (valveControlValue != 0 && millis() - lastLeaseTime >= VALVE_LEASE_RENEW_MS))
+            {
+                uint16_t durations[8];
+                for (int i = 0; i < 8; i++)
+                {
+                    durations[i] = (valveControlValue >> i) & 1 ? VALVE_LEASE_MS : 0;
+                }
+                ValvePulsePacket pulse(durations);
+                success = success && pRemoteChar_Rest->writeValue(pulse.tx(), pulse.txLength(manifoldCompact), true);
+                previousValveInt = valveControlValue;
+                lastLeaseTime = millis();
+            }
+        }
+        else if (previousValveInt != valveControlValue)
         {
             success = success && pRemoteChar_ValveControl->writeValue((uint8_t *)&valveControlValue, 4, true);
             previousValveInt = valveControlValue;
             log_i("Sent valve packet!");
         }
 
+        updateRawStreamSubscription();
+        updateBulkTransfer();
+        updateLinkBenchmark();
+        checkRequestTimeouts();
+        updateLinkProfile();
+
         if (!success)
         {
             showDialog("Error sending command!", lv_color_hex(0xFF0000), 3000);
@@ -569,7 +1522,13 @@ void ble_loop()
                 NimBLEDevice::getScan()->stop();
                 clearOasmanClientsFound();
                 showDialog("Connected to manifold", lv_color_hex(0x22bb33));
-                onBLEConnectionCompleted();
+                if (manifoldStateSync)
+                {
+                    StateSyncPacket sync(syncedBootId, syncedStateVersion);
+                    sendRestPacket(&sync);
+                    stateSyncSentTime = millis();
+                }
+                onBLEConnectionCompleted(manifoldStateSync);
                 doDisconnect = false;
             }
         }
@@ -15,9 +15,28 @@
 
 #include "utils/util.h"
 
+// decoded raw pressure stream samples for the live trace
+#define RAW_TRACE_BUFFER_COUNT 128
+struct RawTraceSample
+{
+    int16_t values[4]; // raw sensor values, fp rp fd rd
+    uint8_t valves;    // valve mask at the time of the sample
+};
+
 bool connectCharacteristic(BLERemoteService *pRemoteService, BLERemoteCharacteristic *l_BLERemoteChar);
 void ble_setup();
 void ble_loop();
 void disconnect(bool showDialogOnDisconnect = true);
 const char *ble_getMAC();
+void ble_linkActivity();         // keeps the connection on the fast profile for another BLE_LINK_IDLE_MS
+const char *ble_getLinkInfo(); // negotiated connection interval and latency
+void ble_setRawStream(bool enabled);
+bool ble_getRawStream();
+bool ble_hasRawStream();
+int ble_readRawTrace(RawTraceSample *copyTo, int max);
+bool ble_startBulkTransfer(BulkResource resource); // false if the manifold doesn't support it or one is already going. Data comes out over Serial
+void ble_cancelBulkTransfer();
+bool ble_getBulkProgress(uint32_t *received, uint32_t *size); // true while a transfer is going
+void ble_startLinkBenchmark(uint16_t pings, uint16_t throughputSeconds); // pings first, then the manifold streams filler at us. Results go out over Serial too
+bool ble_getLinkBenchmark(char *rtt, size_t rttLen, char *throughput, size_t throughputLen); // false if it never ran
 #endif
\ No newline at end of file
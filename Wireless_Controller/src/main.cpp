@@ -118,6 +118,7 @@ void loop()
             dimmed = false;
         }
         dimScreenTime = now + DIM_SCREEN_TIME;
+        ble_linkActivity();
     }
 
     if (dimScreenTime < now && dimmed == false)
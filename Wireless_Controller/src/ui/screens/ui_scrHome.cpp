@@ -209,4 +209,5 @@ void ScrHome::runTouchInput(SimplePoint pos, bool down)
 void ScrHome::loop()
 {
     Scr::loop();
+    ble_linkActivity(); // someone looking at the home screen is about to press something, keep the link fast
 }
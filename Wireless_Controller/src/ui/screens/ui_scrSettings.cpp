@@ -88,6 +88,36 @@ void ScrSettings::init()
                                             sendRestPacket(&pkt);
                                             showDialog("Controllers disconnected!", lv_color_hex(0xFFFF00)); }, []() -> void {}, false); });
 
+    // proportional runs the valves at a duty cycle that follows the stick instead of full open past a threshold
+    this->ui_joystickProportional = new Option(this->optionsContainer, OptionType::ON_OFF, "Proportional Sticks", defaultCharVal, [](void *data)
+                                               {
+        JoystickConfigPacket *cfg = &util_joystickConfig;
+        util_joystickConfig = JoystickConfigPacket(true, (bool)data ? JOYSTICK_MODE_PROPORTIONAL : JOYSTICK_MODE_ON_OFF, cfg->getDeadzone(), cfg->getCurve(), cfg->getPeriod());
+        sendJoystickConfigPacket(true); });
+
+    this->ui_joystickDeadzone = new Option(this->optionsContainer, OptionType::SLIDER, "Stick Dead Zone %", {.INT = 15}, [](void *data)
+                                           {
+        JoystickConfigPacket *cfg = &util_joystickConfig;
+        util_joystickConfig = JoystickConfigPacket(true, cfg->getMode(), (uint32_t)data, cfg->getCurve(), cfg->getPeriod());
+        sendJoystickConfigPacket(true);
+        alertValueUpdated(); });
+    this->ui_joystickDeadzone->setSliderParams(0, JOYSTICK_DEADZONE_MAX, true, LV_EVENT_RELEASED);
+
+    this->ui_joystickCurve = new Option(this->optionsContainer, OptionType::SLIDER, "Stick Curve (10 = linear)", {.INT = 20}, [](void *data)
+                                        {
+        JoystickConfigPacket *cfg = &util_joystickConfig;
+        util_joystickConfig = JoystickConfigPacket(true, cfg->getMode(), cfg->getDeadzone(), (uint32_t)data, cfg->getPeriod());
+        sendJoystickConfigPacket(true);
+        alertValueUpdated(); });
+    this->ui_joystickCurve->setSliderParams(JOYSTICK_CURVE_MIN, JOYSTICK_CURVE_MAX, true, LV_EVENT_RELEASED);
+
+    this->ui_joystickPeriod = new Option(this->optionsContainer, OptionType::KEYBOARD_INPUT_NUMBER, "Valve Cycle (ms)", {.INT = 250}, [](void *data)
+                                         {
+        JoystickConfigPacket *cfg = &util_joystickConfig;
+        util_joystickConfig = JoystickConfigPacket(true, cfg->getMode(), cfg->getDeadzone(), cfg->getCurve(), (uint32_t)data);
+        sendJoystickConfigPacket(true);
+        alertValueUpdated(); });
+
     new Option(this->optionsContainer, OptionType::SPACE, "");
     new Option(this->optionsContainer, OptionType::HEADER, "ML/AI");
     this->ui_aiPercentage = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Learn Progress:", defaultCharVal);
@@ -231,6 +261,57 @@ void ScrSettings::init()
     alertValueUpdated(); });
     this->ui_config6->setSliderParams(10, 600, true, LV_EVENT_RELEASED);
 
+    new Option(this->optionsContainer, OptionType::SPACE, "", defaultCharVal);
+    new Option(this->optionsContainer, OptionType::HEADER, "Diagnostics");
+
+    // live trace of the raw pressure stream, handy for tuning bag volume percentage or finding a slow corner
+    this->ui_rawTraceEnabled = new Option(this->optionsContainer, OptionType::ON_OFF, "Live Pressure Trace", defaultCharVal, [](void *data)
+                                          { ble_setRawStream((bool)data); });
+    this->ui_rawTraceEnabled->setBooleanValue(false);
+
+    this->ui_rawTrace = lv_chart_create(this->optionsContainer);
+    lv_obj_set_size(this->ui_rawTrace, LCD_WIDTH - 20, 120);
+    lv_obj_set_x(this->ui_rawTrace, 10);
+    lv_chart_set_type(this->ui_rawTrace, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(this->ui_rawTrace, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_point_count(this->ui_rawTrace, RAW_TRACE_POINTS);
+    lv_chart_set_range(this->ui_rawTrace, LV_CHART_AXIS_PRIMARY_Y, 0, 4095);
+    lv_obj_set_style_size(this->ui_rawTrace, 0, 0, LV_PART_INDICATOR); // no dots on the points
+    const uint32_t traceColors[4] = {0xFF4040, 0xFFB040, 0x40A0FF, 0x40FF80}; // fp rp fd rd
+    for (int i = 0; i < 4; i++)
+    {
+        this->ui_rawTraceSeries[i] = lv_chart_add_series(this->ui_rawTrace, lv_color_hex(traceColors[i]), LV_CHART_AXIS_PRIMARY_Y);
+        lv_chart_set_all_value(this->ui_rawTrace, this->ui_rawTraceSeries[i], LV_CHART_POINT_NONE);
+    }
+    lv_obj_add_flag(this->ui_rawTrace, LV_OBJ_FLAG_HIDDEN);
+
+    // pulls files off the manifold and prints them over usb serial, save the log and run OASMan_ESP32/tools/bulk_capture.py on it
+    new Option(this->optionsContainer, OptionType::BUTTON, "Export Settings Backup", defaultCharVal, [](void *data)
+               {
+                   if (!ble_startBulkTransfer(BULK_SETTINGS))
+                   {
+                       showDialog("Export not available", lv_color_hex(0xFF0000));
+                   } });
+    new Option(this->optionsContainer, OptionType::BUTTON, "Export Telemetry", defaultCharVal, [](void *data)
+               {
+                   if (!ble_startBulkTransfer(BULK_TELEMETRY))
+                   {
+                       showDialog("Export not available", lv_color_hex(0xFF0000));
+                   } });
+    this->ui_bulkProgress = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Export:", defaultCharVal);
+
+    // round trip times and then 5 seconds of the manifold streaming at us, also printed over usb serial as BENCH lines
+    new Option(this->optionsContainer, OptionType::BUTTON, "Run Link Test", defaultCharVal, [](void *data)
+               {
+                   if (!isConnectedToManifold())
+                   {
+                       showDialog("Not connected", lv_color_hex(0xFF0000));
+                       return;
+                   }
+                   ble_startLinkBenchmark(100, 5); });
+    this->ui_benchRtt = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Round trip:", defaultCharVal);
+    this->ui_benchThroughput = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Throughput:", defaultCharVal);
+
     new Option(this->optionsContainer, OptionType::SPACE, "", defaultCharVal);
     new Option(this->optionsContainer, OptionType::HEADER, "Wifi / Update");
 
@@ -337,6 +418,10 @@ void ScrSettings::init()
     macValue.STRING = ble_getMAC();
     this->ui_mac = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Manifold:", macValue);
 
+    OptionValue linkValue;
+    linkValue.STRING = ble_getLinkInfo();
+    this->ui_link = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Link:", linkValue);
+
     OptionValue voltsValue;
     voltsValue.STRING = getBatteryVoltageString();
     this->ui_volts = new Option(this->optionsContainer, OptionType::TEXT_WITH_VALUE, "Battery:", voltsValue);
@@ -400,9 +485,56 @@ void ScrSettings::loop()
     this->ui_aiReady->setRightHandText(buf);
 
     this->ui_mac->setRightHandText(ble_getMAC());
+    this->ui_link->setRightHandText(ble_getLinkInfo());
 
     this->ui_volts->setRightHandText(getBatteryVoltageString());
 
+    uint32_t bulkReceived, bulkSize;
+    if (ble_getBulkProgress(&bulkReceived, &bulkSize))
+    {
+        snprintf(buf, sizeof(buf), "%u / %u", bulkReceived, bulkSize);
+        this->ui_bulkProgress->setRightHandText(buf);
+    }
+    else if (bulkSize > 0)
+    {
+        this->ui_bulkProgress->setRightHandText(bulkReceived >= bulkSize ? "Done" : "Stopped");
+    }
+
+    char benchThroughput[64];
+    char benchRtt[64];
+    if (ble_getLinkBenchmark(benchRtt, sizeof(benchRtt), benchThroughput, sizeof(benchThroughput)))
+    {
+        this->ui_benchRtt->setRightHandText(benchRtt);
+        this->ui_benchThroughput->setRightHandText(benchThroughput);
+    }
+
+    if (ble_getRawStream() && ble_hasRawStream())
+    {
+        lv_obj_remove_flag(this->ui_rawTrace, LV_OBJ_FLAG_HIDDEN);
+        static RawTraceSample samples[RAW_TRACE_BUFFER_COUNT];
+        int count = ble_readRawTrace(samples, RAW_TRACE_BUFFER_COUNT);
+        for (int s = 0; s < count; s++)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                lv_chart_set_next_value(this->ui_rawTrace, this->ui_rawTraceSeries[i], samples[s].values[i]);
+            }
+        }
+    }
+    else
+    {
+        lv_obj_add_flag(this->ui_rawTrace, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    if (util_joystickConfigReceived)
+    {
+        util_joystickConfigReceived = false;
+        this->ui_joystickProportional->setBooleanValue(util_joystickConfig.getMode() == JOYSTICK_MODE_PROPORTIONAL);
+        this->ui_joystickDeadzone->setRightHandText(itoa(util_joystickConfig.getDeadzone(), buf, 10));
+        this->ui_joystickCurve->setRightHandText(itoa(util_joystickConfig.getCurve(), buf, 10));
+        this->ui_joystickPeriod->setRightHandText(itoa(util_joystickConfig.getPeriod(), buf, 10));
+    }
+
     if (*util_configValues._setValues())
     {
         *util_configValues._setValues() = false;
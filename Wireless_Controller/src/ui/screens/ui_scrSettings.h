@@ -18,6 +18,8 @@
 
 #include "device_lib_exports.h"
 
+#define RAW_TRACE_POINTS 150 // 3 seconds at 50hz
+
 class ScrSettings : public Scr
 {
     using Scr::Scr;
@@ -52,8 +54,19 @@ public:
     Option *ui_updateBtn;
     Option *ui_manifoldUpdateStatus;
     Option *ui_mac;
+    Option *ui_link;
     Option *ui_volts;
     Option *ui_brightnessSlider;
+    Option *ui_rawTraceEnabled;
+    lv_obj_t *ui_rawTrace;
+    Option *ui_bulkProgress;
+    Option *ui_joystickProportional;
+    Option *ui_joystickDeadzone;
+    Option *ui_joystickCurve;
+    Option *ui_joystickPeriod;
+    Option *ui_benchRtt;
+    Option *ui_benchThroughput;
+    lv_chart_series_t *ui_rawTraceSeries[4];
 
     void init();
     void runTouchInput(SimplePoint pos, bool down);
@@ -71,6 +71,8 @@ void requestPreset()
     sendRestPacket(&pkt);
 }
 
+extern bool manifoldJoystickConfig; // from ble.cpp
+
 ConfigValuesPacket util_configValues(0, 0, 0, 0, 0, 0, 0);
 
 void sendConfigValuesPacket(bool saveToManifold)
@@ -79,6 +81,15 @@ void sendConfigValuesPacket(bool saveToManifold)
     sendRestPacket(&util_configValues);
 }
 
+JoystickConfigPacket util_joystickConfig(false, JOYSTICK_MODE_ON_OFF, 0, 0, 0);
+bool util_joystickConfigReceived = false;
+
+void sendJoystickConfigPacket(bool saveToManifold)
+{
+    util_joystickConfig.setSetValues(saveToManifold);
+    sendRestPacket(&util_joystickConfig);
+}
+
 UpdateStatusRequestPacket util_statusRequestPacket;
 
 void sendUpdateStatusRequestPacket()
@@ -109,71 +120,33 @@ void handleFunctionRunOnNextFrame()
 
 #pragma region bluetooth packets
 
-#define BTOASPACKETCOUNT 10
-struct PacketEntry
-{
-    bool taken;
-    BTOasPacket packet;
-};
-PacketEntry packets[BTOASPACKETCOUNT];
-static SemaphoreHandle_t restMutex;
+#define REST_QUEUE_SIZE 16
+PacketQueue<BTOasPacket, REST_QUEUE_SIZE> restQueue;
 void setupRestSemaphore()
 {
-    restMutex = xSemaphoreCreateMutex();
-    memset(packets, 0, sizeof(packets));
-}
-void waitRestSemaphore()
-{
-    while (xSemaphoreTake(restMutex, 1) != pdTRUE)
-    {
-        delay(1);
-    }
-}
-void giveRestSemaphore()
-{
-    xSemaphoreGive(restMutex);
+    // nothing to set up anymore, the queue is lock free. Kept so main doesn't have to change
+    restQueue.clear();
 }
 
 void clearPackets()
 {
-    waitRestSemaphore();
-    for (int i = 0; i < BTOASPACKETCOUNT; i++)
-    {
-        packets[i].taken = false;
-    }
-    giveRestSemaphore();
+    restQueue.clear();
 }
 
 bool getBTRestPacketToSend(BTOasPacket *copyTo)
 {
-    bool ret = false;
-    waitRestSemaphore();
-    for (int i = 0; i < BTOASPACKETCOUNT; i++)
-    {
-        if (packets[i].taken)
-        {
-            packets[i].taken = false;
-            memcpy(copyTo, &packets[i].packet, BTOAS_PACKET_SIZE);
-            ret = true;
-            break;
-        }
-    }
-    giveRestSemaphore();
-    return ret;
+    return restQueue.pop(copyTo);
+}
+bool peekBTRestPacketToSend(BTOasPacket *copyTo)
+{
+    return restQueue.peek(copyTo);
 }
 void sendRestPacket(BTOasPacket *packet)
 {
-    waitRestSemaphore();
-    for (int i = 0; i < BTOASPACKETCOUNT; i++)
+    if (!restQueue.push(*packet))
     {
-        if (!packets[i].taken)
-        {
-            packets[i].taken = true;
-            memcpy(&packets[i].packet, packet, BTOAS_PACKET_SIZE);
-            break;
-        }
+        log_i("Rest queue full, dropped packet %i (%u dropped total)", packet->cmd, restQueue.getOverflowCount());
     }
-    giveRestSemaphore();
 }
 
 #pragma endregion
@@ -422,9 +395,21 @@ bool isKeyboardHidden()
     return kb == NULL; // lv_obj_has_flag(kb, LV_OBJ_FLAG_HIDDEN);
 }
 
-void onBLEConnectionCompleted()
+void onBLEConnectionCompleted(bool stateSynced)
 {
-    sendConfigValuesPacket(false);   // sends a request of the manifold to send out the manifolds save data
-    requestPreset();                 // sends a request of the manifold to send out the current presets values
-    sendUpdateStatusRequestPacket(); // sends a request of the manifold to send out the current update status
+    if (!stateSynced)
+    {
+        // older manifolds, ask for each piece on its own
+        sendConfigValuesPacket(false);   // sends a request of the manifold to send out the manifolds save data
+        requestPreset();                 // sends a request of the manifold to send out the current presets values
+        sendUpdateStatusRequestPacket(); // sends a request of the manifold to send out the current update status
+    }
+    if (manifoldJoystickConfig)
+    {
+        sendJoystickConfigPacket(false); // not in the state sync, older manifolds don't have it
+    }
+    BootTimingsPacket bootTimings;
+    sendRestPacket(&bootTimings); // manifold boot timings, just logged to serial
+    StatusRatePacket statusRate(20, 1, 1000); // status as soon as anything moves (up to 20/s), once a second when parked. Well under the 5 second timeout
+    sendRestPacket(&statusRate);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define util_h
 
 #include <BTOas.h>
+#include <packetQueue.h>
 #include <preferencable.h>
 #include "ui/components/Scr.h"
 #include "lvgl.h"
@@ -91,11 +92,15 @@ void requestPreset();
 extern ConfigValuesPacket util_configValues;
 extern UpdateStatusRequestPacket util_statusRequestPacket;
 void sendConfigValuesPacket(bool saveToManifold);
-void onBLEConnectionCompleted();
+extern JoystickConfigPacket util_joystickConfig; // last one the manifold sent
+extern bool util_joystickConfigReceived;       // set when a new one comes in, the settings screen clears it
+void sendJoystickConfigPacket(bool saveToManifold);
+void onBLEConnectionCompleted(bool stateSynced); // stateSynced if a StateSyncPacket already went out for the config, presets and update status
 
 // returns 0 if none to send
 void clearPackets();
 bool getBTRestPacketToSend(BTOasPacket *copyTo);
+bool peekBTRestPacketToSend(BTOasPacket *copyTo);
 void sendRestPacket(BTOasPacket *packet);
 void setupRestSemaphore();
 